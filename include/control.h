@@ -1,7 +1,9 @@
 #pragma once
 
+#include <array>
 #include <string>
 #include <filesystem>
+#include <vector>
 
 #include "define.h"
 #include "global.h"
@@ -55,6 +57,10 @@ namespace mcpe_viz {
         bool quietFlag;
         char helpFlags;
         bool tryDbRepair;
+        // read the worlds without opening the leveldb (no LOCK, nothing is written)
+        bool readOnlyDb;
+        // leveldb data blocks to read ahead on a helper thread while scanning a world, 0 = off
+        int32_t prefetchBlocks;
         int32_t movieX, movieY, movieW, movieH;
         int minX, maxX, minZ, maxZ, minY, maxY;
         int32_t blockListOutDim;
@@ -62,6 +68,34 @@ namespace mcpe_viz {
         std::string emptyDbName;
         uint32_t blockListMax;
         uint32_t blockListRare;
+        // threads for dbParse and the block list, 0 means use all cores
+        int32_t threadCount;
+        // write/update a subchunk index next to both worlds for the block list diff
+        bool buildIndex;
+        // write the block list as a binary diff (.bdiff) instead of a point cloud (.xyz)
+        bool blockListBinary;
+        std::string fnBlockDiffToXyz;
+        // compare full block states (both layers) instead of block id's
+        bool blockListStates;
+        // compare entities and block entities as well
+        bool entityDiff;
+        // group the changed blocks into connected clusters
+        bool changeClusters;
+        // stream the block list as newline-delimited json to this file ("-" for stdout)
+        std::string fnNdjson;
+        // change heatmap for the block list diff
+        int32_t heatmapMode;
+        int32_t heatmapScale;
+        // world directories (oldest first) for the timeline diff
+        std::vector<std::string> timelineWorlds;
+        // write the changes from --empty-db to --db into a patch file / apply a patch file to --db
+        std::string fnMakePatch;
+        std::string fnApplyPatch;
+        // restore the chunks inside the min/max box of this dimension from a backup world
+        std::string rollbackWorld;
+        int32_t rollbackDimId;
+        // delete the chunks outside of these areas (dimId, x1, z1, x2, z2 in blocks)
+        std::vector<std::array<int32_t, 5>> pruneKeepAreas;
 
         int32_t heightMode;
 
@@ -104,6 +138,8 @@ namespace mcpe_viz {
             quietFlag = false;
             helpFlags = HelpFlags::Basic;
             tryDbRepair = false;
+            readOnlyDb = false;
+            prefetchBlocks = 64;
             movieX = movieY = movieW = movieH = 0;
             minX = maxX = minZ = maxZ = minY = maxY = 0x8FFFFFFF;
             blockListOutDim = kDimIdOverworld;
@@ -111,6 +147,21 @@ namespace mcpe_viz {
             emptyDbName = "<none>";
             blockListMax = 100;
             blockListRare = 3;
+            threadCount = 0;
+            buildIndex = false;
+            blockListBinary = false;
+            fnBlockDiffToXyz = "";
+            blockListStates = false;
+            entityDiff = false;
+            changeClusters = false;
+            fnNdjson = "";
+            fnMakePatch = "";
+            fnApplyPatch = "";
+            rollbackWorld = "";
+            rollbackDimId = kDimIdOverworld;
+            pruneKeepAreas.clear();
+            heatmapMode = kHeatmapModeNone;
+            heatmapScale = 1;
 
             leveldbFilter = 10;
             leveldbBlockSize = 4096;
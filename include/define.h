@@ -36,6 +36,13 @@ namespace mcpe_viz {
         kImageModeSlimeChunksMCPE = 10
     };
 
+    // change heatmap coloring
+    enum HeatmapMode : int32_t {
+        kHeatmapModeNone = 0,
+        kHeatmapModeCount = 1,
+        kHeatmapModeMaxY = 2
+    };
+
     // dimensions
     enum DimensionType : int32_t {
         kDimIdOverworld = 0,
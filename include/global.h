@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <string>
 
@@ -13,7 +14,13 @@ namespace mcpe_viz {
 
     //todozooz - MAX_BLOCK_ID MAX_ITEM_ID etc
     // todo ugly globals
-    extern std::vector<std::string> listGeoJSON;
+    struct GeoJsonItem {
+        int32_t dimId;
+        std::string json;
+    };
+    // one list per thread: each dbParse thread collects its own items, which are then appended to the list
+    // of the main thread in key order
+    extern thread_local std::vector<GeoJsonItem> listGeoJSON;
 
     extern int32_t globalIconImageId;
 
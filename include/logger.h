@@ -27,5 +27,7 @@ namespace mcpe_viz {
     void setup_logger_stage_1();
 
     // setup both console logger and file logger
-    void setup_logger_stage_2(const std::filesystem::path& outdir, Level consoleLevel, Level fileLevel);
+    // the console logger writes to stderr instead of stdout if consoleToStderr is set
+    void setup_logger_stage_2(const std::filesystem::path& outdir, Level consoleLevel, Level fileLevel,
+                              bool consoleToStderr = false);
 }
@@ -28,7 +28,6 @@ namespace mcpe_viz {
 
         Block(IdType id, const std::string& name)
             : BaseObject{id, name}
-            , color_set_need_count{0}
             , solid{true}
             , opaque{false}
             , liquid{false}
@@ -48,8 +47,6 @@ namespace mcpe_viz {
             this->variants_.clear();
         }
 
-        mutable int color_set_need_count;
-
         bool solid;
         bool opaque;
         bool liquid;
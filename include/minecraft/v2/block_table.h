@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mcpe_viz {
+
+    // the block registry flattened for the per-block loops (renderers, spawn checks, block list)
+    // a block state is a block id plus 4 bits of block data, state = (id << 4) | data; each property is an
+    // array indexed by state, so a lookup is one load instead of Block::get and a walk of the variant map
+    // build() again after blocks or variants are added
+    class BlockTable {
+    public:
+        static constexpr int32_t kDataBits = 4;
+        static constexpr uint32_t kDataMask = (1u << kDataBits) - 1;
+
+        enum : uint8_t {
+            // no block with this id
+            kFlagUnknown = 0x01,
+            // the block has variants, so the state depends on the block data
+            kFlagVariants = 0x02,
+            // the block has variants, but none for this block data
+            kFlagNoVariant = 0x04,
+            // the block has no variants and no color in the xml
+            kFlagNoColor = 0x08,
+            kFlagSolid = 0x10,
+            kFlagOpaque = 0x20,
+            kFlagLiquid = 0x40,
+            // of the variant for this block data, if there is one
+            kFlagSpawnable = 0x80,
+        };
+
+        // states a renderer has to report (see record_unknown_block_id et al)
+        static constexpr uint8_t kFlagsReport = kFlagUnknown | kFlagNoVariant | kFlagNoColor;
+
+        static void build();
+
+        // -1 if the block id or the block data does not fit in the table
+        static int32_t state(int32_t blockId, int32_t blockData) {
+            if (uint32_t(blockId) >= uint32_t(blockLimit) || uint32_t(blockData) > kDataMask) {
+                return -1;
+            }
+            return (blockId << kDataBits) | blockData;
+        }
+
+        // the map color (big endian rgb, like Colored::color)
+        static int32_t rgb(int32_t state) { return rgbs[state]; }
+        // (kFlagUnknown for -1, so the result of state() can be used as is)
+        static uint8_t flags(int32_t state) { return (state < 0) ? uint8_t(kFlagUnknown) : flagList[state]; }
+        // index of the block name in names(); 0 (an empty name) for unknown ids
+        static uint16_t nameIndex(int32_t state) { return nameIndices[state]; }
+        static const std::string& name(uint16_t nameIndex) { return names[nameIndex]; }
+        // the name index of a block name, -1 if no block has it
+        static int32_t findName(const std::string& name);
+
+    private:
+        static inline int32_t blockLimit = 0;
+        static inline std::vector<int32_t> rgbs;
+        static inline std::vector<uint8_t> flagList;
+        static inline std::vector<uint16_t> nameIndices;
+        static inline std::vector<std::string> names;
+    };
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace mcpe_viz {
+
+    // 64-bit non-cryptographic hash (MurmurHash64A)
+    uint64_t hash64(const void* data, size_t len, uint64_t seed = 0);
+
+    // mix one more value into a running hash
+    inline uint64_t hashCombine(uint64_t h, uint64_t v) {
+        return hash64(&v, sizeof(v), h);
+    }
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <fstream>
+
+namespace mcpe_viz {
+
+    // binary block list diff (.bdiff)
+    //
+    // layout (little endian, every record starts on an 8 byte boundary so the file can be mapped and used in place):
+    //   BlockDiffHeader
+    //   BlockDiffEntry records, one per changed subchunk; the subchunks of one chunk column are next to each other
+    //   BlockDiffChunk index, sorted by (chunkX, chunkZ)
+    //
+    // each entry has a 4096 bit mask of the changed blocks (bit = x*256 + z*16 + y, as in the subchunk records),
+    // a small palette of block id's and an (old, new) pair of palette indices for each set bit, in bit order
+
+    struct BlockDiffHeader {
+        char magic[4];
+        uint32_t version;
+        int32_t dimId;
+        uint32_t chunkCount;
+        uint64_t entryCount;
+        uint64_t dataOffset;
+        uint64_t indexOffset;
+        uint64_t reserved;
+    };
+    static_assert(sizeof(BlockDiffHeader) == 48, "BlockDiffHeader is part of the file format");
+
+    struct BlockDiffChunk {
+        int32_t chunkX;
+        int32_t chunkZ;
+        uint32_t entryCount;
+        uint32_t reserved;
+        // file offset of the first entry
+        uint64_t offset;
+    };
+    static_assert(sizeof(BlockDiffChunk) == 24, "BlockDiffChunk is part of the file format");
+
+    struct BlockDiffEntry {
+        int32_t chunkX;
+        int32_t chunkZ;
+        int32_t subChunk;
+        uint16_t paletteCount;
+        uint16_t changeCount;
+        uint64_t mask[64];
+        // followed by: uint16_t palette[paletteCount]
+        //              uint16_t changes[changeCount][2] (old, new palette index)
+        //              padding to 8 bytes
+
+        const uint16_t* palette() const { return reinterpret_cast<const uint16_t*>(this + 1); }
+        const uint16_t* changes() const { return palette() + paletteCount; }
+        bool changed(int32_t blockPos) const { return (mask[blockPos >> 6] >> (blockPos & 63)) & 1; }
+        uint16_t oldBlockId(int32_t change) const { return palette()[changes()[change * 2]]; }
+        uint16_t newBlockId(int32_t change) const { return palette()[changes()[change * 2 + 1]]; }
+
+        static size_t byteSize(uint16_t paletteCount, uint16_t changeCount) {
+            return (sizeof(BlockDiffEntry) + (paletteCount + changeCount * 2) * sizeof(uint16_t) + 7) & ~size_t(7);
+        }
+        size_t byteSize() const { return byteSize(paletteCount, changeCount); }
+    };
+    static_assert(sizeof(BlockDiffEntry) == 528, "BlockDiffEntry is part of the file format");
+
+    // collects the changes of one subchunk
+    class BlockDiffEntryBuilder {
+    public:
+        BlockDiffEntryBuilder();
+
+        void reset(int32_t chunkX, int32_t chunkZ, int32_t subChunk);
+        // changes have to be added in block position order
+        void add(int32_t blockPos, uint16_t oldBlockId, uint16_t newBlockId);
+        bool empty() const { return changes.empty(); }
+
+        // returns the number of bytes written
+        size_t write(std::ostream& out) const;
+
+    private:
+        BlockDiffEntry entry;
+        std::vector<uint16_t> palette;
+        std::vector<uint16_t> changes;
+        int16_t paletteIndex[1024];
+    };
+
+    // writes a .bdiff file from entries that were written (in key order) to separate part files
+    class BlockDiffWriter {
+    public:
+        int32_t open(const std::string& fn, int32_t dimId);
+        // append the entries of one part file; chunks are the chunk columns in the part with offsets
+        // relative to the start of the part
+        int32_t appendPart(const std::string& fnPart, const std::vector<BlockDiffChunk>& chunks);
+        int32_t close();
+
+    private:
+        std::string fn;
+        std::ofstream out;
+        BlockDiffHeader header;
+        std::vector<BlockDiffChunk> index;
+    };
+
+    // read-only view of a .bdiff file (memory mapped)
+    class BlockDiffFile {
+    public:
+        BlockDiffFile() = default;
+        ~BlockDiffFile() { close(); }
+
+        BlockDiffFile(const BlockDiffFile&) = delete;
+        BlockDiffFile& operator=(const BlockDiffFile&) = delete;
+
+        int32_t open(const std::string& fn);
+        void close();
+
+        const BlockDiffHeader& header() const { return *reinterpret_cast<const BlockDiffHeader*>(data); }
+
+        size_t chunkCount() const { return header().chunkCount; }
+        const BlockDiffChunk& chunk(size_t i) const { return chunks()[i]; }
+        // nullptr if the chunk column has no changes
+        const BlockDiffChunk* findChunk(int32_t chunkX, int32_t chunkZ) const;
+
+        const BlockDiffEntry* firstEntry(const BlockDiffChunk& chunk) const {
+            return reinterpret_cast<const BlockDiffEntry*>(data + chunk.offset);
+        }
+        // all entries of the file, in the order they were written
+        const BlockDiffEntry* firstEntry() const {
+            return reinterpret_cast<const BlockDiffEntry*>(data + header().dataOffset);
+        }
+        static const BlockDiffEntry* nextEntry(const BlockDiffEntry* entry) {
+            return reinterpret_cast<const BlockDiffEntry*>(reinterpret_cast<const char*>(entry) + entry->byteSize());
+        }
+
+    private:
+        const char* data = nullptr;
+        size_t size = 0;
+#ifdef _WIN32
+        void* fileHandle = nullptr;
+        void* mapHandle = nullptr;
+#endif
+
+        const BlockDiffChunk* chunks() const {
+            return reinterpret_cast<const BlockDiffChunk*>(data + header().indexOffset);
+        }
+    };
+
+    // write the blocks of a .bdiff file as a .xyz point cloud (same as the block list output)
+    int32_t convertBlockDiffToXyz(const std::string& fnBdiff, const std::string& fnXyz);
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
+#include <utility>
+
+#include <leveldb/db.h>
+
+#include "block_diff_file.h"
+#include "change_clusters.h"
+#include "chunk_key.h"
+#include "db_merge.h"
+#include "entity_diff.h"
+#include "palette.h"
+
+namespace mcpe_viz {
+
+    // block list limits in world coordinates (inclusive)
+    struct BlockListLimits {
+        int32_t minX, maxX;
+        int32_t minY, maxY;
+        int32_t minZ, maxZ;
+        // blocks that go to the outputs: all of them, or the ones with the BlockTable name index filterName
+        bool allBlocks;
+        int32_t filterName;
+
+        bool contains(int32_t x, int32_t y, int32_t z) const {
+            return (x >= minX) && (x <= maxX) && (z >= minZ) && (z <= maxZ) && (y >= minY) && (y <= maxY);
+        }
+
+        // true if the chunk column at the given block coordinates is completely outside of the limits
+        bool excludesChunk(int32_t baseX, int32_t baseZ) const {
+            return (baseX + 15 < minX) || (baseX > maxX) || (baseZ + 15 < minZ) || (baseZ > maxZ);
+        }
+
+        // true if the 16x16x16 subchunk at the given block coordinates is completely outside of the limits
+        bool excludesSubChunk(int32_t baseX, int32_t baseY, int32_t baseZ) const {
+            return (baseX + 15 < minX) || (baseX > maxX) || (baseZ + 15 < minZ) || (baseZ > maxZ) ||
+                (baseY + 15 < minY) || (baseY > maxY);
+        }
+    };
+
+    struct BlockListCoords {
+        int32_t x, y, z;
+    };
+
+    // the order of a full spatial scan of the world: subchunk layer, chunk row, chunk column,
+    // then x, z and y within the subchunk; the capped block lists keep the first blocks in this order
+    bool blockListLess(const BlockListCoords& a, const BlockListCoords& b);
+
+    // one line of the _blocks.txt file
+    struct BlockListLine {
+        BlockListCoords pos;
+        uint16_t blockId;
+
+        bool operator<(const BlockListLine& other) const { return blockListLess(pos, other.pos); }
+    };
+
+    struct BlockListStats {
+        uint32_t worldChunksFound = 0;
+        uint32_t emptyMatchChunks = 0;
+        uint32_t addedChunks = 0;
+        uint32_t removedChunks = 0;
+        uint32_t sizeDiffChunks = 0;
+        uint32_t sameBytesChunks = 0;
+        uint32_t sameBlocksChunks = 0;
+        uint32_t paletteChunks = 0;
+
+        void add(const BlockListStats& other);
+    };
+
+    struct ChangeColumn {
+        uint32_t count = 0;
+        int32_t maxY = -1;
+    };
+
+    // changed blocks per block column, for the change heatmap
+    class ChangeHeatmap {
+    public:
+        // (chunkZ, chunkX) -> columns (x * 16 + z); sorted so that the image can be written row by row
+        std::map<std::pair<int32_t, int32_t>, std::array<ChangeColumn, 256>> chunks;
+
+        void add(int32_t x, int32_t y, int32_t z);
+        void merge(const ChangeHeatmap& other);
+    };
+
+    // newline-delimited json output of the block list, written while the world is being scanned
+    // parts are scanned on several threads but written in key order: a part that gets ahead of the
+    // others waits once it has buffered kMaxBuffer bytes, so memory use does not depend on the size of the diff
+    class NdjsonStream {
+    public:
+        static const size_t kMaxBuffer = 256 * 1024;
+
+        const std::string dimName;
+
+        NdjsonStream(std::ostream& out, const std::string& dimName, size_t partCount);
+
+        // write (or keep) the buffered records of a part and clear the buffer
+        void write(size_t part, std::string& buffer, bool partDone);
+        // write a record that is not part of any part (once all parts are done)
+        void writeRecord(const std::string& record);
+
+    private:
+        std::ostream& out;
+        std::mutex mutex;
+        std::condition_variable headChanged;
+        // the first part that is not done yet
+        size_t head;
+        std::vector<bool> done;
+        // records of parts that were done before it was their turn
+        std::vector<std::string> pending;
+    };
+
+    // one line of the .xyz point cloud output
+    void writeBlockXyz(std::ostream& out, int32_t x, int32_t y, int32_t z, uint16_t blockid);
+
+    // block list results for one key range of the world
+    // ranges are scanned independently (possibly on different threads) and then merged in key order,
+    // so each part only keeps what the merged output can still use
+    class BlockListPart {
+    public:
+        static const int32_t kMaxBlockId = 1024;
+
+        std::string startKey;
+        // empty means "to the end of the db"
+        std::string endKey;
+        // if set, scan() only visits these chunk columns (8 byte key prefixes, in key order)
+        std::vector<std::string> chunkPrefixes;
+        // subchunk keys for scanKeys()
+        std::vector<std::string> keys;
+
+        uint64_t blockCnt[kMaxBlockId];
+        // first (blockListRare) coordinates of each block id
+        std::vector<BlockListCoords> blockLists[kMaxBlockId];
+        // first (blockListMax) lines for the _blocks.txt file in blockListLess order;
+        // kept as a heap while scanning, as the keys are not visited in that order
+        std::vector<BlockListLine> listLines;
+        // point cloud output for this range
+        std::ofstream xyz;
+        // binary diff output for this range (used instead of xyz when open)
+        std::ofstream bdiff;
+        // chunk columns in bdiff, offsets are relative to the start of this range
+        std::vector<BlockDiffChunk> bdiffChunks;
+        uint64_t bdiffSize;
+
+        BlockListStats stats;
+        // only collected when a heatmap was asked for
+        std::unique_ptr<ChangeHeatmap> heatmap;
+        // only collected with --clusters
+        std::unique_ptr<SubChunkClusterBuilder> clusterBuilder;
+        std::vector<SubChunkClusters> clusters;
+        // only collected with --entity-diff
+        std::unique_ptr<EntityDiff> entities;
+        // json output (used instead of xyz when set), this part is number ndjsonPart in the stream
+        NdjsonStream* ndjson;
+        size_t ndjsonPart;
+
+        BlockListPart() : blockCnt{}, bdiffSize(0), ndjson(nullptr), ndjsonPart(0), run{}, runOpen(false) {}
+
+        int32_t scan(leveldb::DB* db, leveldb::DB* emptyDb, int32_t dimId, const BlockListLimits& limits);
+
+        // compare only the subchunks in keys (which must exist in both db's)
+        int32_t scanKeys(leveldb::DB* db, leveldb::DB* emptyDb, const BlockListLimits& limits);
+
+        // hand the rest of the json output to the stream
+        void finishNdjson();
+
+    private:
+        std::vector<int16_t> worldChunkBuf;
+        std::vector<int16_t> emptyChunkBuf;
+        std::vector<BlockIdDiff> blockDiffs;
+        // for --block-states
+        BlockStateIndex stateIndex;
+        std::unique_ptr<SubChunkStates> statesA, statesB;
+        BlockDiffEntryBuilder diffEntry;
+
+        // changed blocks on top of each other with the same old and new block id are written as one json record
+        struct BlockRun {
+            int32_t x, z, minY, maxY;
+            uint16_t blockId, oldBlockId;
+        };
+        BlockRun run;
+        bool runOpen;
+        std::string ndjsonBuf;
+
+        void addToRun(int32_t x, int32_t y, int32_t z, uint16_t blockid, uint16_t oldBlockId);
+        void flushRun();
+
+        void scanRecord(const DbMergeIterator& iter, bool compare, int32_t dimId, const BlockListLimits& limits);
+        void compareSubChunk(const ChunkRecordKey& ck, const leveldb::Slice& valueA, const leveldb::Slice* valueB,
+            const BlockListLimits& limits);
+        void writeSubChunk(const ChunkRecordKey& ck, const leveldb::Slice& valueA, const leveldb::Slice* valueB,
+            const BlockListLimits& limits);
+        void compareBlocks(const ChunkRecordKey& ck, const leveldb::Slice& valueA, const leveldb::Slice* valueB,
+            const BlockListLimits& limits);
+        void reportBlock(const BlockListLimits& limits, int32_t x, int32_t y, int32_t z, uint16_t blockid,
+            uint16_t oldBlockId);
+    };
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <bitset>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace mcpe_viz {
+
+    // a group of changed blocks that touch each other (diagonals included)
+    struct ChangeCluster {
+        int32_t minX, minY, minZ;
+        int32_t maxX, maxY, maxZ;
+        uint64_t blockCount = 0;
+        // block id -> count, after and before the change
+        std::map<uint16_t, uint64_t> newBlocks;
+        std::map<uint16_t, uint64_t> oldBlocks;
+
+        void merge(const ChangeCluster& other);
+    };
+
+    // the changed blocks of one subchunk, grouped into clusters that are connected inside the subchunk
+    struct SubChunkClusters {
+        int32_t chunkX, subChunk, chunkZ;
+        std::vector<ChangeCluster> clusters;
+        // changed blocks on the outside of the subchunk (block position, cluster), sorted by block position;
+        // this is all that is needed to join clusters across subchunks
+        std::vector<std::pair<uint16_t, uint32_t>> boundary;
+    };
+
+    // collects the changed blocks of one subchunk at a time
+    class SubChunkClusterBuilder {
+    public:
+        void begin(int32_t chunkX, int32_t subChunk, int32_t chunkZ);
+        void add(int32_t x, int32_t y, int32_t z, uint16_t blockId, uint16_t oldBlockId);
+        // returns false if nothing changed in the subchunk
+        bool end(SubChunkClusters& out);
+
+    private:
+        int32_t chunkX, subChunk, chunkZ;
+        std::bitset<4096> changed;
+        std::vector<uint16_t> positions;
+        uint16_t newIds[4096];
+        uint16_t oldIds[4096];
+        uint16_t parent[4096];
+
+        uint16_t find(uint16_t pos);
+    };
+
+    // joins the subchunk clusters of a dimension into clusters
+    // subchunks can be added in any order; each one is linked to the neighbours that are already there
+    class ChangeClusters {
+    public:
+        void add(SubChunkClusters& subChunk);
+
+        // all clusters, largest first
+        std::vector<ChangeCluster> result();
+
+    private:
+        struct Linked {
+            std::vector<std::pair<uint16_t, uint32_t>> boundary;
+            uint32_t firstCluster;
+        };
+        std::map<std::tuple<int32_t, int32_t, int32_t>, Linked> subChunks;
+        std::vector<ChangeCluster> clusters;
+        std::vector<uint32_t> parent;
+
+        uint32_t find(uint32_t i);
+        void unite(uint32_t a, uint32_t b);
+    };
+}
@@ -9,6 +9,12 @@
 #include "check_spawn.h"
 
 namespace mcpe_viz {
+    // a paletted subchunk record, kept until all subchunks of its chunk have been read (see _do_chunk_v7_top)
+    struct SubChunkRecord {
+        int32_t chunkY;
+        std::string value;
+    };
+
     // todobig - perhaps this is silly (storing all this info per-chunk)
     class ChunkData_LevelDB {
     public:
@@ -40,7 +46,7 @@ namespace mcpe_viz {
             chunkFormatVersion = -1;
         }
 
-        int32_t _do_chunk_v2(int32_t tchunkX, int32_t tchunkZ, const char* cdata,
+        int32_t _do_chunk_v2(int32_t tchunkX, int32_t tchunkZ, const char* cdata, size_t cdata_size,
             int32_t dimensionId, const std::string& dimName,
             const bool* fastBlockHideList, const bool* fastBlockForceTopList,
             const bool* fastBlockToGeoJSON,
@@ -61,6 +67,15 @@ namespace mcpe_viz {
             const CheckSpawnList& listCheckSpawn);
 
 
+        // the top blocks of a chunk from all of its paletted subchunks: the subchunks are visited from the highest
+        // down and the columns that already have their top block are skipped, so it stops as soon as all 256
+        // columns are resolved; the result is the same as _do_chunk_v7 on every subchunk, as long as nothing
+        // needs more than the top blocks (no force-top or geojson blocks). a top block the chunk already has
+        // (from its legacy subchunks) is only replaced by one at the same height or higher. reorders subchunks
+        int32_t _do_chunk_v7_top(int32_t tchunkX, int32_t tchunkZ, SubChunkRecord* subchunks, size_t count,
+            const bool* fastBlockHideList);
+
+
         int32_t _do_chunk_biome_v3(int32_t tchunkX, int32_t tchunkZ, const char* cdata, int32_t cdatalen);
 
         int32_t checkSpawnable(leveldb::DB* db, int32_t dimId, const CheckSpawnList& listCheckSpawn);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace mcpe_viz {
+
+    // chunk record keys are: chunkX, chunkZ, [dimId], recordType, [subChunk]
+    // (dimId is absent for the overworld; subChunk is only present on some record types)
+    struct ChunkRecordKey {
+        int32_t chunkX;
+        int32_t chunkZ;
+        int32_t dimId;
+        int32_t type;
+        // -1 if the key does not have a subchunk byte
+        int32_t subChunk;
+    };
+
+    // returns true if the key is a chunk record for one of the known dimensions
+    bool parseChunkRecordKey(const char* key, size_t keySize, ChunkRecordKey& out);
+
+    // build the leveldb key for a chunk record; subChunk < 0 means no subchunk byte
+    std::string makeChunkRecordKey(int32_t dimId, int32_t chunkX, int32_t chunkZ, uint8_t type, int32_t subChunk = -1);
+}
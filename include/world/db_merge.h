@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <leveldb/db.h>
+#include <leveldb/iterator.h>
+
+namespace mcpe_viz {
+
+    // walks two leveldb's side by side in key order (like a merge join)
+    // each step yields one key and tells which of the two db's have it
+    // dbB may be nullptr; then every key is reported as only being in dbA
+    class DbMergeIterator {
+    private:
+        leveldb::Iterator* iterA;
+        leveldb::Iterator* iterB;
+        bool curA;
+        bool curB;
+
+        void settle();
+
+    public:
+        // prefetch: read ahead (see newScanIterator), for long runs of next()'s
+        DbMergeIterator(leveldb::DB* dbA, leveldb::DB* dbB, const leveldb::ReadOptions& options, bool prefetch = false);
+        ~DbMergeIterator();
+
+        DbMergeIterator(const DbMergeIterator&) = delete;
+        DbMergeIterator& operator=(const DbMergeIterator&) = delete;
+
+        void seekToFirst();
+        void seek(const leveldb::Slice& target);
+        void next();
+
+        bool valid() const { return curA || curB; }
+
+        bool inA() const { return curA; }
+        bool inB() const { return curB; }
+
+        leveldb::Slice key() const { return curA ? iterA->key() : iterB->key(); }
+        leveldb::Slice valueA() const { return iterA->value(); }
+        leveldb::Slice valueB() const { return iterB->value(); }
+
+        leveldb::Status status() const;
+    };
+
+    // walks any number of leveldb's side by side in key order (a k-way merge)
+    // each db is read front to back once; each step yields one key and tells which db's have it
+    class DbMultiMergeIterator {
+    private:
+        std::vector<leveldb::Iterator*> iters;
+        std::vector<bool> cur;
+        int32_t first;
+
+        void settle();
+
+    public:
+        DbMultiMergeIterator(const std::vector<leveldb::DB*>& dbs, const leveldb::ReadOptions& options);
+        ~DbMultiMergeIterator();
+
+        DbMultiMergeIterator(const DbMultiMergeIterator&) = delete;
+        DbMultiMergeIterator& operator=(const DbMultiMergeIterator&) = delete;
+
+        void seekToFirst();
+        void next();
+
+        bool valid() const { return first >= 0; }
+
+        size_t count() const { return iters.size(); }
+        bool in(size_t i) const { return cur[i]; }
+
+        leveldb::Slice key() const { return iters[first]->key(); }
+        leveldb::Slice value(size_t i) const { return iters[i]->value(); }
+
+        leveldb::Status status() const;
+    };
+
+    // pick up to (parts - 1) keys that split the db into ranges of roughly equal size on disk
+    // split keys are 8 bytes (chunkX, chunkZ) so all records of one chunk column stay in the same range
+    std::vector<std::string> splitKeyRange(leveldb::DB* db, int32_t parts);
+}
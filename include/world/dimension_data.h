@@ -7,6 +7,7 @@
 #include <memory>
 
 #include "chunk_data.h"
+#include "subchunk_index.h"
 #include "../minecraft/schematic.h"
 #include "../define.h"
 
@@ -15,13 +16,20 @@
 #define PIXEL_COPY_MEMCPY
 
 namespace mcpe_viz {
+    class ChangeHeatmap;
+    struct ChangeCluster;
+    class EntityDiff;
+    class NdjsonStream;
+
     class DimensionData_LevelDB {
+    public:
+        typedef std::pair<uint32_t, uint32_t> ChunkKey;
+        typedef std::map<ChunkKey, std::unique_ptr<ChunkData_LevelDB> > ChunkData_LevelDB_Map;
+
     private:
         std::string name;
         int32_t dimId;
 
-        typedef std::pair<uint32_t, uint32_t> ChunkKey;
-        typedef std::map<ChunkKey, std::unique_ptr<ChunkData_LevelDB> > ChunkData_LevelDB_Map;
         ChunkData_LevelDB_Map chunks;
 
         int32_t minChunkX, maxChunkX;
@@ -106,6 +114,13 @@ namespace mcpe_viz {
                 dimId, minChunkX * 16, maxChunkX * 16, minChunkZ * 16, maxChunkZ * 16, imageW, imageH);
         }
 
+        void setChunkBounds(int32_t tminChunkX, int32_t tmaxChunkX, int32_t tminChunkZ, int32_t tmaxChunkZ) {
+            minChunkX = tminChunkX;
+            maxChunkX = tmaxChunkX;
+            minChunkZ = tminChunkZ;
+            maxChunkZ = tmaxChunkZ;
+        }
+
         void addToChunkBounds(int32_t chunkX, int32_t chunkZ) {
             minChunkX = std::min(minChunkX, chunkX);
             maxChunkX = std::max(maxChunkX, chunkX);
@@ -121,14 +136,15 @@ namespace mcpe_viz {
 
         int32_t getMaxChunkZ() { return maxChunkZ; }
 
-        int32_t addChunk(int32_t tchunkFormatVersion, int32_t chunkX, int32_t chunkY, int32_t chunkZ, const char* cdata,
-            size_t cdata_size) {
+        // chunks are parsed into a map of the calling thread (see dbParse) and merged with mergeChunks()
+        int32_t addChunk(ChunkData_LevelDB_Map& chunks, int32_t tchunkFormatVersion, int32_t chunkX, int32_t chunkY,
+            int32_t chunkZ, const char* cdata, size_t cdata_size) {
             ChunkKey chunkKey(chunkX, chunkZ);
             switch (tchunkFormatVersion) {
             case 2:
                 // pre-0.17
                 chunks[chunkKey] = std::unique_ptr<ChunkData_LevelDB>(new ChunkData_LevelDB());
-                return chunks[chunkKey]->_do_chunk_v2(chunkX, chunkZ, cdata, dimId, name,
+                return chunks[chunkKey]->_do_chunk_v2(chunkX, chunkZ, cdata, cdata_size, dimId, name,
                     fastBlockHideList, fastBlockForceTopList,
                     fastBlockToGeoJSONList,
                     listCheckSpawn);
@@ -162,8 +178,23 @@ namespace mcpe_viz {
             return -1;
         }
 
-        int32_t addChunkColumnData(int32_t tchunkFormatVersion, int32_t chunkX, int32_t chunkZ, const char* cdata,
-            int32_t cdatalen) {
+        // when nothing needs more than the top block of each column, the paletted subchunks of a chunk can be
+        // collected and given to addChunkTop_v7 instead of addChunk
+        bool topBlocksOnly() const {
+            return blockForceTopList.empty() && blockToGeoJSONList.empty();
+        }
+
+        int32_t addChunkTop_v7(ChunkData_LevelDB_Map& chunks, int32_t chunkX, int32_t chunkZ,
+            SubChunkRecord* subchunks, size_t count) {
+            ChunkKey chunkKey(chunkX, chunkZ);
+            if (!chunks_has_key(chunks, chunkKey)) {
+                chunks[chunkKey] = std::unique_ptr<ChunkData_LevelDB>(new ChunkData_LevelDB());
+            }
+            return chunks[chunkKey]->_do_chunk_v7_top(chunkX, chunkZ, subchunks, count, fastBlockHideList);
+        }
+
+        int32_t addChunkColumnData(ChunkData_LevelDB_Map& chunks, int32_t tchunkFormatVersion, int32_t chunkX,
+            int32_t chunkZ, const char* cdata, int32_t cdatalen) {
             switch (tchunkFormatVersion) {
             case 2:
                 // pre-0.17
@@ -184,6 +215,13 @@ namespace mcpe_viz {
             return -1;
         }
 
+        void mergeChunks(ChunkData_LevelDB_Map& part) {
+            for (auto& it : part) {
+                chunks[it.first] = std::move(it.second);
+            }
+            part.clear();
+        }
+
         int32_t checkSpawnable(leveldb::DB* db) {
             for (const auto& it : chunks) {
                 it.second->checkSpawnable(db, dimId, listCheckSpawn);
@@ -354,6 +392,14 @@ namespace mcpe_viz {
 
         int32_t generateImage(const std::string& fname, const ImageModeType imageMode);
 
+        // image of where the block list diff found changes (same coordinates as the other images)
+        int32_t generateChangeHeatmap(const std::string& fname, const ChangeHeatmap& heatmap);
+
+        int32_t generateChangeClusters(const std::string& dimName, const std::vector<ChangeCluster>& clusters,
+            NdjsonStream* ndjson);
+
+        int32_t generateEntityDiff(const std::string& dimName, const EntityDiff& entities, NdjsonStream* ndjson);
+
 
         // adapted from: https://gist.github.com/protolambda/00b85bf34a75fd8176342b1ad28bfccc
         bool isSlimeChunk_MCPE(int32_t cX, int32_t cZ);
@@ -732,15 +778,16 @@ namespace mcpe_viz {
         // 372.432u 13.435s 6:50.66 93.9%  0+0k 419456+1842944io 210pf+0w
 
         int32_t generateSlices(leveldb::DB* db, const std::string& fnBase);
-        int32_t generateBlockList(leveldb::DB* db, const std::string& fnBase, leveldb::DB* emptyDb=nullptr);
-        const int16_t* findChunk(leveldb::DB* db, DimensionType dimId, int32_t x, uint8_t y, int32_t z);
+        // indexDiff (if given) lists the shared subchunks that differ, so only those are compared
+        int32_t generateBlockList(leveldb::DB* db, const std::string& fnBase, leveldb::DB* emptyDb=nullptr,
+            const SubChunkIndexDiff* indexDiff=nullptr);
 
         int32_t doOutput_GeoJSON();
             
 
         int32_t doOutput_Schematic(leveldb::DB* db);
 
-        int32_t doOutput(leveldb::DB* db, leveldb::DB* emptyWorld=nullptr);
+        int32_t doOutput(leveldb::DB* db, leveldb::DB* emptyWorld=nullptr, const SubChunkIndexDiff* indexDiff=nullptr);
     };
 
 }
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <leveldb/slice.h>
+
+namespace mcpe_viz {
+
+    // an entity (0x32 record) or block entity (0x31 record), reduced to what the diff needs
+    struct EntityInfo {
+        bool blockEntity = false;
+        // entities only
+        int64_t uniqueId = 0;
+        float pos[3] = { 0.0f, 0.0f, 0.0f };
+        // block entities only
+        int32_t x = 0, y = 0, z = 0;
+        // "identifier" of entities, "id" of block entities
+        std::string id;
+        // hash of the nbt without position, rotation and motion
+        uint64_t hash = 0;
+
+        bool samePosition(const EntityInfo& other) const;
+        std::string positionString() const;
+    };
+
+    enum EntityChangeType {
+        kEntityAdded,
+        kEntityRemoved,
+        kEntityMoved,
+        kEntityModified
+    };
+
+    // info is the entity in the world, other is the entity in the comparison world
+    struct EntityChange {
+        EntityChangeType type;
+        EntityInfo info;
+        EntityInfo other;
+    };
+
+    // parse all nbt compounds of a 0x31 or 0x32 record; returns -1 if the record is damaged
+    int32_t parseEntityRecord(const char* data, size_t size, bool blockEntities, std::vector<EntityInfo>& out);
+
+    // compares the entity and block entity records of two worlds, one chunk record at a time
+    // block entities are matched by position, entities by UniqueID; entities that are not in the same chunk
+    // of both worlds may have moved to another chunk, so they are kept until finish()
+    class EntityDiff {
+    public:
+        std::vector<EntityChange> changes;
+        // unmatched entities of the world and of the comparison world
+        std::map<int64_t, EntityInfo> onlyA;
+        std::map<int64_t, EntityInfo> onlyB;
+
+        // either value may be nullptr if the record only exists in one world
+        void compareRecords(const leveldb::Slice* valueA, const leveldb::Slice* valueB, bool blockEntities);
+
+        // append the changes of a later part of the world
+        void merge(EntityDiff& other);
+
+        // match entities that changed chunks; everything else left over was added or removed
+        void finish();
+
+    private:
+        std::vector<EntityInfo> entitiesA, entitiesB;
+
+        void compareEntity(const EntityInfo& a, const EntityInfo& b);
+    };
+
+    const char* entityChangeName(EntityChangeType type);
+}
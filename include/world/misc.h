@@ -26,6 +26,30 @@ namespace mcpe_viz {
     int32_t _calcOffsetBlock_LevelDB_v3_fullchunk(int32_t x, int32_t z, int32_t y);
     uint8_t getData_LevelDB_v3_fullchunk(const char* p, int32_t x, int32_t z, int32_t y);
 
+    // expand count bytes of packed nibbles (low nibble first) to count * 2 bytes
+    void expandNibbles(const char* packed, size_t count, uint8_t* out);
+
+    // a whole pre-1.2 terrain record as planar arrays, one byte per block, in record order
+    // v2 (LegacyTerrain) records are 128 blocks high, v3 subchunks 16
+    struct LegacyTerrain {
+        static constexpr int32_t kMaxBlocks = 16 * 16 * 128;
+
+        int32_t height;
+        int32_t blockCount;
+        uint8_t blockId[kMaxBlocks];
+        // block data, sky light and block light back to back (as in the record), then one zero
+        uint8_t nibbles[3 * kMaxBlocks + 1];
+
+        int32_t offset(int32_t x, int32_t z, int32_t y) const { return (((x * 16) + z) * height) + y; }
+        const uint8_t* blockData() const { return nibbles; }
+        const uint8_t* skyLight() const { return nibbles + blockCount; }
+        const uint8_t* blockLight() const { return nibbles + 2 * blockCount; }
+    };
+
+    // decode a record in one go; whatever a short record does not have reads as 0
+    void decodeLegacyTerrain_LevelDB_v2(const char* cdata, size_t cdata_size, LegacyTerrain& out);
+    void decodeLegacyTerrain_LevelDB_v3(const char* cdata, size_t cdata_size, LegacyTerrain& out);
+
     inline uint8_t _getBitFromByte(const char* cdata, int32_t bitnum) {
             int byteStart = bitnum / 8;
             int byteOffset = bitnum % 8;
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mcpe_viz {
+
+    // one entry of a subchunk block palette; points into the record it was parsed from
+    struct PaletteEntry {
+        const char* nbt;
+        size_t nbtSize;
+        const char* name;
+        size_t nameSize;
+        // the "version" tag (type, name and payload), nullptr if there is none
+        const char* version;
+        size_t versionSize;
+        // the "val" short (block data of older worlds), 0 if there is none
+        int32_t val;
+    };
+
+    // one block storage of a paletted (1.2.x and later) subchunk record
+    // note: this is a view - it is only valid while the record it was parsed from is alive
+    struct PaletteStorage {
+        const char* words;
+        int32_t bitsPerBlock;
+        int32_t blocksPerWord;
+        int32_t wordCount;
+        std::vector<PaletteEntry> palette;
+
+        int32_t getIndex(int32_t blockPos) const {
+            const int32_t wordIdx = blockPos / blocksPerWord;
+            uint32_t word;
+            memcpy(&word, &words[wordIdx * 4], sizeof(uint32_t));
+            return int32_t((word >> ((blockPos % blocksPerWord) * bitsPerBlock)) & ((1u << bitsPerBlock) - 1));
+        }
+    };
+
+    // walk past one NBT payload of the given tag type; returns nullptr if the data is truncated or bad
+    const char* skipNbtPayload(int32_t tagType, const char* p, const char* end, int32_t depth = 0);
+
+    // parse the first block storage of a subchunk record (versions 1 and 8)
+    // returns -1 for other versions so callers can fall back to convertChunkV7toV3
+    int32_t parsePaletteStorage(const char* cdata, size_t cdata_size, PaletteStorage& out);
+
+    // parse all block storages of a subchunk record (version 8 records can have a second one,
+    // e.g. for the water in waterlogged blocks)
+    int32_t parsePaletteStorages(const char* cdata, size_t cdata_size, std::vector<PaletteStorage>& out);
+
+    // gives every distinct block state (a palette entry: name plus states or val) a small index,
+    // so that the same state gets the same index in every subchunk it is looked up from
+    // the "version" tag is not part of the state, so worlds saved by different game versions compare equal
+    class BlockStateIndex {
+    public:
+        // air and positions without a block in the second layer
+        static constexpr uint32_t kNoState = 0;
+
+        BlockStateIndex();
+
+        uint32_t lookup(const PaletteEntry& entry);
+        int32_t blockId(uint32_t state) const { return blockIds[state]; }
+        size_t size() const { return blockIds.size(); }
+
+    private:
+        std::unordered_map<std::string, uint32_t> states;
+        std::vector<int32_t> blockIds;
+        std::string key;
+    };
+
+    // block id and block data of one palette entry, as the v3 emulation buffer holds them
+    struct PaletteBlock {
+        int32_t blockId;
+        int32_t blockData;
+        // the BlockTable state (data 0 when the block data does not fit in the table), -1 for an unknown id
+        int32_t state;
+    };
+
+    // resolves subchunk palettes to block id's and data; the same palette shows up in many subchunks, so each
+    // distinct palette (by its raw bytes) is only resolved once - later lookups skip over its entries to find
+    // its end, hash the bytes and compare them with the cached ones
+    // not thread safe, use one per thread
+    class PaletteBlockCache {
+    public:
+        // p points at the palette size (int32) that follows the packed words of a block storage, end is the end
+        // of the record; returns nullptr if the palette is truncated or bad
+        const std::vector<PaletteBlock>* resolve(const char* p, const char* end);
+        size_t size() const { return palettes.size(); }
+
+    private:
+        struct CachedPalette {
+            std::string bytes;
+            std::vector<PaletteBlock> blocks;
+        };
+
+        // by the hash of the palette bytes
+        std::unordered_multimap<uint64_t, CachedPalette> palettes;
+        size_t keyBytes = 0;
+        std::vector<PaletteEntry> entries;
+    };
+
+    // block states of the first two layers of a subchunk, in v3 block order
+    struct SubChunkStates {
+        static constexpr int32_t kMaxLayers = 2;
+
+        int32_t layerCount;
+        uint32_t states[kMaxLayers][4096];
+    };
+
+    // decode a paletted subchunk record to block states in one pass; returns -1 if it is not paletted
+    int32_t decodeSubChunkStates(const char* cdata, size_t cdata_size, BlockStateIndex& index, SubChunkStates& out);
+
+    // a block position (in v3 order) where two subchunks have different block id's
+    struct BlockIdDiff {
+        int32_t blockPos;
+        int32_t blockId;
+        int32_t otherBlockId;
+    };
+
+    // compare two paletted subchunk records by block id without unpacking them to the v3 emulation buffer
+    // the palettes are mapped onto block id's once; when both sides use the same bits per block and
+    // agree on the meaning of every shared palette index, the packed words are compared directly and
+    // only differing words are unpacked. returns -1 if either record is not paletted
+    int32_t comparePalettedSubChunks(const char* cdataA, size_t cdataA_size, const char* cdataB, size_t cdataB_size,
+        std::vector<BlockIdDiff>& diffs);
+
+    // compare two paletted subchunk records by full block state in both layers, so changes that keep the
+    // block id (rotation, redstone power, waterlogging) are found too; the diffs carry the block id's of
+    // the first layer. statesA and statesB are scratch space. returns -1 if either record is not paletted
+    int32_t compareSubChunkStates(const char* cdataA, size_t cdataA_size, const char* cdataB, size_t cdataB_size,
+        BlockStateIndex& index, SubChunkStates& statesA, SubChunkStates& statesB, std::vector<BlockIdDiff>& diffs);
+}
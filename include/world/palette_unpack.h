@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+namespace mcpe_viz {
+
+    // expand the 4096 palette indices of a paletted block storage in one call
+    // words are the packed 32-bit words of the storage ((4096 + blocksPerWord - 1) / blocksPerWord of them),
+    // out is in storage order: ((x * 16) + z) * 16 + y
+    // uses AVX2 when the cpu has it; returns -1 if bitsPerBlock is not 1, 2, 3, 4, 5, 6, 8 or 16
+    int32_t unpackPaletteIndices(const char* words, int32_t bitsPerBlock, uint16_t* out);
+
+    // the same with the portable kernels only (one per bits per block)
+    int32_t unpackPaletteIndicesScalar(const char* words, int32_t bitsPerBlock, uint16_t* out);
+}
@@ -7,4 +7,7 @@ namespace mcpe_viz {
     void worldPointToImagePoint(int32_t dimId, double wx, double wz, double& ix, double& iy, bool geoJsonFlag);
     
     void worldPointToGeoJSONPoint(int32_t dimId, double wx, double wz, double& ix, double& iy);
+
+    // false while the world is parsed and the chunk bounds of the dimension are not known yet
+    bool imagePointsKnown(int32_t dimId);
 }
\ No newline at end of file
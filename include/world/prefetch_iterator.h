@@ -0,0 +1,76 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <leveldb/db.h>
+#include <leveldb/iterator.h>
+
+namespace mcpe_viz {
+
+    // reads ahead of a leveldb iterator on a helper thread: the helper moves the iterator (which reads and
+    // inflates the data blocks) and copies the records into batches, while the caller works on the records
+    // of the current batch
+    // only forward iteration (SeekToFirst, Seek, Next); a scan that stops early has read up to aheadBytes for nothing
+    class PrefetchIterator : public leveldb::Iterator {
+    private:
+        struct Batch {
+            // keys and values, back to back
+            std::string data;
+            // (key offset, key size, value size) of each record; the value follows its key
+            std::vector<std::pair<size_t, std::pair<size_t, size_t>>> records;
+            leveldb::Status status;
+            // no records after this batch
+            bool end = false;
+        };
+
+        leveldb::Iterator* iter;
+        const size_t aheadBytes;
+        const size_t batchBytes;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::thread helper;
+        bool stop;
+        // a seek starts a new generation; batches of older generations are dropped
+        uint64_t generation;
+        bool seekFirst;
+        std::string seekTarget;
+        std::deque<std::unique_ptr<Batch>> queue;
+        size_t queuedBytes;
+
+        std::unique_ptr<Batch> current;
+        size_t index;
+
+        void run();
+        void startSeek(bool first, const leveldb::Slice& target);
+        void nextBatch();
+
+    public:
+        // takes ownership of iter
+        PrefetchIterator(leveldb::Iterator* iter, size_t aheadBytes);
+        ~PrefetchIterator() override;
+
+        PrefetchIterator(const PrefetchIterator&) = delete;
+        PrefetchIterator& operator=(const PrefetchIterator&) = delete;
+
+        bool Valid() const override;
+        void SeekToFirst() override;
+        void SeekToLast() override;
+        void Seek(const leveldb::Slice& target) override;
+        void Next() override;
+        void Prev() override;
+        leveldb::Slice key() const override;
+        leveldb::Slice value() const override;
+        leveldb::Status status() const override;
+    };
+
+    // a new iterator of db for a scan of many records; it reads ahead when --prefetch is not 0
+    leveldb::Iterator* newScanIterator(leveldb::DB* db, const leveldb::ReadOptions& options);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <leveldb/db.h>
+
+namespace mcpe_viz {
+
+    // a box of chunk columns that a prune keeps
+    struct KeepArea {
+        int32_t dimId;
+        int32_t minChunkX, maxChunkX;
+        int32_t minChunkZ, maxChunkZ;
+
+        bool containsChunk(int32_t chunkX, int32_t chunkZ) const {
+            return (chunkX >= minChunkX) && (chunkX <= maxChunkX) && (chunkZ >= minChunkZ) && (chunkZ <= maxChunkZ);
+        }
+    };
+
+    struct PruneStats {
+        uint64_t deletedChunks = 0;
+        // chunk records, digp records and the actors they list that were in the db
+        uint64_t deletedRecords = 0;
+        // key + value bytes of the deleted records
+        uint64_t deletedBytes = 0;
+        // chunk records in dimensions with a keep area that were kept
+        uint64_t keptRecords = 0;
+    };
+
+    // delete every chunk record (and the actors stored for that chunk) of a dimension that is outside
+    // all keep areas of that dimension; dimensions without a keep area are not touched
+    // the db is streamed once in key order and deleted in batches, so memory use does not depend on the
+    // size of the world; the deleted key range is compacted afterwards
+    int32_t pruneWorld(leveldb::DB* db, const std::vector<KeepArea>& keepAreas, PruneStats& stats);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+#include <leveldb/db.h>
+
+namespace mcpe_viz {
+
+    // open the leveldb of a world without taking its LOCK file and without writing anything, so a world that a
+    // running server has open can be read without copying it first
+    // the tables of the current MANIFEST are opened right away and the .log files are read into memory, so the
+    // db is a snapshot of the moment it was opened; what the server writes later is not seen
+    // every table file stays open until the db is closed (one file handle per table, opening fails with an IOError
+    // when there are more tables than the open file limit allows), so tables the server deletes can still be read;
+    // on Windows the files are opened with read, write and delete sharing
+    // Put, Delete and Write return NotSupported, and iterators only go forward (Prev and SeekToLast are not supported)
+    leveldb::Status openReadOnlyDb(const leveldb::Options& options, const std::string& dirDb, leveldb::DB** dbptr);
+}
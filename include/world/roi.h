@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <leveldb/db.h>
+#include <leveldb/iterator.h>
+
+namespace mcpe_viz {
+
+    // region of interest from --min-x/--max-x/--min-z/--max-z/--min-y/--max-y
+    // in chunk and subchunk coordinates (inclusive)
+    struct ChunkRoi {
+        // roi's with at most this many chunk columns are visited with one seek per column
+        static const uint64_t kMaxSeekChunks = 65536;
+
+        int32_t minChunkX, maxChunkX;
+        int32_t minChunkZ, maxChunkZ;
+        int32_t minSubChunk, maxSubChunk;
+
+        static ChunkRoi fromControl();
+
+        bool active() const;
+        bool containsChunk(int32_t chunkX, int32_t chunkZ) const {
+            return (chunkX >= minChunkX) && (chunkX <= maxChunkX) && (chunkZ >= minChunkZ) && (chunkZ <= maxChunkZ);
+        }
+        bool containsSubChunk(int32_t subChunk) const {
+            return (subChunk >= minSubChunk) && (subChunk <= maxSubChunk);
+        }
+
+        // true if the record is a chunk record outside of the roi (other records are never excluded)
+        bool excludesKey(const char* key, size_t keySize) const;
+
+        // true if the roi is small enough to seek to each chunk column instead of scanning the db
+        bool useSeek() const;
+        // the 8 byte (chunkX, chunkZ) key prefix of every chunk column in the roi, in key order
+        std::vector<std::string> chunkPrefixes() const;
+    };
+
+    // iterates over the records of a db that are not excluded by the roi
+    // a small roi is visited with one seek per chunk column (plus one per known non-chunk record name),
+    // so the rest of the world is never read
+    class RoiIterator {
+    private:
+        leveldb::Iterator* iter;
+        ChunkRoi roi;
+        std::vector<std::string> prefixes;
+        size_t prefixIndex;
+
+        bool inPrefix() const;
+        void seekPrefix();
+        void skipExcluded();
+
+    public:
+        RoiIterator(leveldb::DB* db, const leveldb::ReadOptions& options, const ChunkRoi& roi);
+        ~RoiIterator();
+
+        RoiIterator(const RoiIterator&) = delete;
+        RoiIterator& operator=(const RoiIterator&) = delete;
+
+        void seekToFirst();
+        // move to the first record at or after target
+        void seek(const leveldb::Slice& target);
+        void next();
+
+        bool valid() const;
+        leveldb::Slice key() const { return iter->key(); }
+        leveldb::Slice value() const { return iter->value(); }
+        leveldb::Status status() const { return iter->status(); }
+    };
+}
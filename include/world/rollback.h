@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+#include <leveldb/db.h>
+
+#include "world/roi.h"
+
+namespace mcpe_viz {
+
+    // what a rollback did to the target world
+    struct RollbackStats {
+        uint64_t restoredRecords = 0;
+        uint64_t deletedRecords = 0;
+        uint64_t unchangedRecords = 0;
+        uint64_t chunks = 0;
+    };
+
+    // replace the chunk records of one dimension inside the roi with the ones from a backup of the world
+    // in a column that is in both worlds, subchunks (0x2f), column data (0x2b, 0x2d), block entities (0x31),
+    // entities (0x32) and the version, finalized state and checksum records (0x2c, 0x76, 0x36, 0x3b) are
+    // restored; records of these types that are not in the backup are deleted
+    // the y range of the roi only limits the subchunks - the other records belong to the whole column
+    // a column that is only in one of the worlds is deleted or copied with all of its records
+    // the chunk columns are visited with sorted seeks on both db's and written in one batch, then the
+    // written key range is compacted
+    int32_t rollbackRegion(leveldb::DB* db, leveldb::DB* backupDb, int32_t dimId, const ChunkRoi& roi,
+        RollbackStats& stats);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+#include <leveldb/db.h>
+
+#include "../define.h"
+
+namespace mcpe_viz {
+
+    // sidecar index of subchunk content hashes for a world, rolled up into a merkle tree:
+    //   dimension -> region (32x32 chunks) -> chunk column -> subchunk
+    // two indexed worlds can be compared top-down, only descending into subtrees whose hashes differ
+    //
+    // the index remembers which leveldb table files it has seen; when it is updated only the key
+    // ranges of tables that were added or removed since then are read again
+    class SubChunkIndex {
+    public:
+        static const int32_t kRegionShift = 5;
+
+        typedef std::pair<int32_t, int32_t> XZ;
+
+        struct TableInfo {
+            uint64_t number;
+            uint64_t size;
+            std::string smallest;
+            std::string largest;
+        };
+
+        // leveldb key -> content hash (subchunk records only)
+        typedef std::map<std::string, uint64_t> LeafMap;
+        typedef LeafMap::value_type Leaf;
+
+        struct ChunkNode {
+            uint64_t hash = 0;
+            // subchunk index -> leaf (leveldb key and content hash); the keys are only stored in the leaves
+            std::map<int32_t, const Leaf*> subChunks;
+        };
+
+        struct RegionNode {
+            uint64_t hash = 0;
+            uint64_t subChunkCount = 0;
+            std::map<XZ, ChunkNode> chunks;
+        };
+
+        struct DimNode {
+            uint64_t hash = 0;
+            uint64_t subChunkCount = 0;
+            std::map<XZ, RegionNode> regions;
+        };
+
+        DimNode dims[kDimIdCount];
+
+        SubChunkIndex() : changedFlag(false) {}
+        // the tree points into the leaves
+        SubChunkIndex(const SubChunkIndex&) = delete;
+        SubChunkIndex& operator=(const SubChunkIndex&) = delete;
+
+        // name of the index file for a world directory
+        static std::string fileName(const std::string& dirWorld);
+
+        // load the index of a world (or build it if there is none), bring it up to date and save it
+        int32_t open(leveldb::DB* db, const leveldb::Options& options, const std::string& dirWorld);
+
+        int32_t load(const std::string& fn);
+        int32_t save(const std::string& fn) const;
+
+        // hash every subchunk in the db
+        int32_t build(leveldb::DB* db, const leveldb::Options& options, const std::string& dirDb);
+
+        // re-read only the key ranges of tables that were added or removed since the index was written
+        int32_t update(leveldb::DB* db, const leveldb::Options& options, const std::string& dirDb);
+
+        bool changed() const { return changedFlag; }
+
+    private:
+        LeafMap leaves;
+        std::vector<TableInfo> tables;
+        bool changedFlag;
+
+        int32_t readTables(leveldb::DB* db, const leveldb::Options& options, const std::string& dirDb,
+            std::vector<TableInfo>& current);
+        int32_t rescan(leveldb::DB* db, const std::string& smallest, const std::string& largest);
+        // the tree is dropped before the leaves change and built again by rollUp()
+        void clearTree();
+        void rollUp();
+    };
+
+    struct SubChunkIndexDiff {
+        // leveldb keys of subchunks that are in both worlds and have different content (in key order)
+        std::vector<std::string> changedKeys;
+        uint32_t addedChunks = 0;
+        uint32_t removedChunks = 0;
+        uint32_t sharedChunks = 0;
+        uint32_t sameChunks = 0;
+    };
+
+    // compare two indexes top-down for one dimension
+    void diffSubChunkIndex(const SubChunkIndex& indexA, const SubChunkIndex& indexB, int32_t dimId,
+        SubChunkIndexDiff& diff);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <leveldb/db.h>
+
+namespace mcpe_viz {
+
+    // changes in one dimension between a snapshot and the one before it
+    struct TimelineStats {
+        uint64_t changedSubChunks = 0;
+        uint64_t addedSubChunks = 0;
+        uint64_t removedSubChunks = 0;
+        uint64_t changedChunks = 0;
+    };
+
+    // compare a list of snapshots of one world (oldest first) in a single pass over all of them
+    // for every chunk column that changed we write which consecutive snapshots differ, followed by
+    // the number of changes per snapshot
+    int32_t generateTimeline(const std::vector<leveldb::DB*>& dbs, const std::vector<std::string>& names,
+        const std::string& fnOut);
+}
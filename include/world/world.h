@@ -1,17 +1,45 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <string>
 #include <memory>
+#include <vector>
 
 
 #include <leveldb/db.h>
 
 #include "dimension_data.h"
 #include "common.h"
+#include "prune.h"
+#include "roi.h"
+#include "global.h"
 
 namespace mcpe_viz {
 
+    // chunk bounds of the block data records of one dimension, empty until a chunk is added
+    struct ChunkBounds {
+        int32_t minChunkX = INT32_MAX, maxChunkX = INT32_MIN;
+        int32_t minChunkZ = INT32_MAX, maxChunkZ = INT32_MIN;
+
+        bool empty() const { return minChunkX > maxChunkX; }
+
+        void add(int32_t chunkX, int32_t chunkZ) {
+            minChunkX = std::min(minChunkX, chunkX);
+            maxChunkX = std::max(maxChunkX, chunkX);
+            minChunkZ = std::min(minChunkZ, chunkZ);
+            maxChunkZ = std::max(maxChunkZ, chunkZ);
+        }
+
+        void merge(const ChunkBounds& other) {
+            if (!other.empty()) {
+                add(other.minChunkX, other.minChunkZ);
+                add(other.maxChunkX, other.maxChunkZ);
+            }
+        }
+    };
+
     // base class for a minecraft world
     class MinecraftWorld {
     private:
@@ -57,6 +85,26 @@ namespace mcpe_viz {
         leveldb::DB* db;
         std::unique_ptr<leveldb::Options> dbOptions;
         int32_t totalRecordCt;
+        std::atomic<int32_t> parsedRecordCt;
+
+        // what one dbParse thread collected from a key range [startKey, endKey) ("" = open end)
+        struct ParsePart {
+            std::string startKey;
+            std::string endKey;
+            DimensionData_LevelDB::ChunkData_LevelDB_Map chunks[kDimIdCount];
+            std::vector<GeoJsonItem> geoJSON;
+            int32_t recordCt = 0;
+            ChunkBounds bounds[kDimIdCount];
+        };
+
+        int32_t dbParseRange(const ChunkRoi& roi, ParsePart& part);
+
+        // set (and report) the chunk bounds of every dimension: a dimension without chunks is the chunk (0, 0),
+        // and with a region of interest the bounds are clamped to it, so the images are sized to the roi
+        void setChunkBounds(const ChunkBounds bounds[kDimIdCount], const ChunkRoi& roi);
+
+        // open the leveldb of a world directory (read-only with control.readOnlyDb)
+        leveldb::Status openDb(const std::string& dirWorld, leveldb::DB** dbptr);
 
     public:
         // todobig - move to private?
@@ -134,6 +182,18 @@ namespace mcpe_viz {
 
         int32_t doOutput();
 
+        // compare snapshots of the world (oldest first) and write which chunks changed in each one
+        int32_t doOutput_Timeline(const std::vector<std::string>& dirs);
+
+        // write the records that changed from control.emptyDbName to this world into a patch file
+        int32_t makePatch(const std::string& fn);
+        // apply a patch file to this world
+        int32_t applyPatch(const std::string& fn);
+        // restore the chunks inside the control box from a backup of this world
+        int32_t rollback(const std::string& dirBackup);
+        // delete the chunks outside of the keep areas
+        int32_t prune(const std::vector<KeepArea>& keepAreas);
+
         void worldPointToImagePoint(int32_t dimId, double wx, double wz, double& ix, double& iy, bool geoJsonFlag) {
             // hack to avoid using wrong dim on pre-0.12 worlds
             if (dimId < 0) { dimId = 0; }
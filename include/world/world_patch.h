@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <leveldb/db.h>
+
+namespace mcpe_viz {
+
+    // a world patch holds the leveldb records that differ between a base world and a newer copy of it:
+    //   header:  "BVPT", uint32 version
+    //   records: uint8 op, uint32 key size, key, then
+    //            put:    uint64 hash of the value, uint32 value size, uint32 data size, zlib(value)
+    //            delta:  uint64 hash of the base value, uint64 hash of the value, uint32 value size,
+    //                    uint32 data size, zlib(value xor base value) - the base value is cut off or padded with zeros
+    //            delete: nothing
+    //   footer:  uint8 kPatchEnd, uint64 record count
+    // level.dat is not part of the leveldb and not in the patch
+    const uint32_t kWorldPatchVersion = 1;
+
+    enum WorldPatchOp {
+        kPatchPut = 1,
+        kPatchDelta = 2,
+        kPatchDelete = 3,
+        kPatchEnd = 0xff
+    };
+
+    // write the records of db that differ from baseDb in one pass over both db's (in key order)
+    int32_t writeWorldPatch(leveldb::DB* db, leveldb::DB* baseDb, const std::string& fn);
+
+    // apply a patch to db, which must be a copy of the base world of the patch
+    // the whole patch is checked against db before anything is written: every record is decoded and the
+    // values it would write are compared with their hashes
+    int32_t applyWorldPatch(leveldb::DB* db, const std::string& fn);
+}
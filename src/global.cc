@@ -3,7 +3,7 @@
 
 namespace mcpe_viz {
     // list of geojson items
-    std::vector<std::string> listGeoJSON;
+    thread_local std::vector<GeoJsonItem> listGeoJSON;
 
     int32_t globalIconImageId = 1;
 
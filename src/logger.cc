@@ -5,9 +5,10 @@
 
 namespace mcpe_viz {
 
+    template<typename Sink = spdlog::sinks::stdout_color_sink_mt>
     auto create_console_sink()
     {
-        auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+        auto console_sink = std::make_shared<Sink>();
         console_sink->set_pattern("[%^%7l%$] %v");
 #ifdef _WIN32
         console_sink->set_color(spdlog::level::info, console_sink->WHITE);
@@ -22,14 +23,20 @@ namespace mcpe_viz {
         spdlog::set_default_logger(std::make_shared<spdlog::logger>("stage_1", create_console_sink()));
     }
 
-    void setup_logger_stage_2(const std::filesystem::path& outpath, Level consoleLevel, Level fileLevel)
+    void setup_logger_stage_2(const std::filesystem::path& outpath, Level consoleLevel, Level fileLevel, bool consoleToStderr)
     {
         auto file_sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(outpath.generic_string());
         // file_sink always record all log
         file_sink->set_level(spdlog::level::level_enum(fileLevel));
         file_sink->set_pattern("[%Y-%m-%d %T.%e][%L] %v");
-        auto console_sink = create_console_sink();
-        
+        spdlog::sink_ptr console_sink;
+        if (consoleToStderr) {
+            console_sink = create_console_sink<spdlog::sinks::stderr_color_sink_mt>();
+        }
+        else {
+            console_sink = create_console_sink();
+        }
+
         console_sink->set_level(spdlog::level::level_enum(consoleLevel));
 
         spdlog::sinks_init_list sink_list = { file_sink, console_sink };
@@ -38,8 +38,6 @@
   -- see: http://minecraft.gamepedia.com/Schematic_file_format  (NBT file format for schematics)
   -- https://irath96.github.io/webNBT/ = web nbt viewer/editor
 
-  * /u/JustinUser -- reset world file outside given area (e.g. X blocks from spawn; given rectangles; etc)
-
   * see data dump here; http://pastebin.com/tuMyCDyc -- any data we need? (updated: http://pastebin.com/be3dwGFA)
   also: https://www.reddit.com/r/MCPE/comments/4nip1u/updated_the_blocksitems_list_for_0150/
 
@@ -217,6 +215,7 @@
 #include "control.h"
 #include "utils/unknown_recorder.h"
 #include "world/world.h"
+#include "world/block_diff_file.h"
 #include "utils/fs.h"
 #include "global.h"
 #include "xml/loader.h"
@@ -459,6 +458,24 @@ namespace mcpe_viz {
       ("list-max", value<int>(), "Maximum number of blocks in output list")
       ("list-rare", value<int>(), "Maximum number of 'rare' blocks in output list")
       ("empty-db", value<std::string>(), "World database for comparison")
+      ("threads", value<int>(), "Number of threads used to parse the world and for the block list (default: all cores)")
+      ("bdiff", "Write the block list as a binary diff (.bdiff) instead of a point cloud (.xyz)")
+      ("ndjson", value<std::string>(), "Stream the block list as newline-delimited json (one record per changed run of blocks along y) to a file or '-' for stdout, instead of a point cloud (.xyz)")
+      ("block-states", "With --empty-db: compare full block states in both block layers, so changes that keep the block id (rotation, redstone power, waterlogging) show up too")
+      ("entity-diff", "With --empty-db: also write the entities and block entities that were added, removed, moved or modified")
+      ("clusters", "With --empty-db: group the changed blocks into connected clusters and write their bounding boxes")
+      ("bdiff-to-xyz", value<std::string>(), "Convert a binary diff (.bdiff) to a point cloud (.xyz) and exit")
+      ("heatmap", value<std::string>(), "With --empty-db: write an image of the changes colored by 'count' or 'maxy'")
+      ("heatmap-scale", value<int>(), "Blocks per heatmap pixel: 1 (default), 2, 4, 8 or 16 (one pixel per chunk)")
+      ("timeline", value<std::vector<std::string>>()->multitoken(), "Compare two or more snapshots of a world (oldest first) and write which chunks changed in each one")
+      ("make-patch", value<std::string>(), "Write the records that changed from --empty-db to --db into a binary patch file and exit")
+      ("apply-patch", value<std::string>(), "Apply a patch file made with --make-patch to --db (a copy of the old world) and exit")
+      ("rollback", value<std::string>(), "Restore the chunks inside --min-x/--max-x/--min-z/--max-z (and --min-y/--max-y for subchunks) in --db from this backup world and exit")
+      ("rollback-dim", value<int>(), "Dimension for --rollback: 0 (overworld, default), 1 (nether) or 2 (the end)")
+      ("prune", value<std::vector<std::string>>()->multitoken(), "Delete all chunks of --db outside the given areas (dimId,x1,z1,x2,z2 in blocks; one or more) and exit; dimensions without an area are not touched")
+      ("prefetch", value<int>(), "Number of leveldb data blocks to read and decompress ahead on a helper thread while scanning a world (default: 64, 0: off)")
+      ("read-only", "Read the worlds directly from their files without opening the leveldb, so a world in use by a running server can be read without copying it (nothing is written)")
+      ("build-index", "Build a subchunk index next to both worlds to speed up later comparisons (used automatically once it exists)")
 
 			("no-tile", "Generates single images instead of tiling output into smaller images. May cause loading problems if image size is > 4096px by 4096px")
 			("tile-size", value<std::string>(), "Changes tile sizes to specified dimensions (Default: 2048px by 2048px)")
@@ -530,6 +547,108 @@ namespace mcpe_viz {
       if (vm.count("empty-db")) {
         control.emptyDbName = vm["empty-db"].as<std::string>();
       }
+      if (vm.count("threads")) {
+        control.threadCount = vm["threads"].as<int>();
+      }
+      if (vm.count("build-index")) {
+        control.buildIndex = true;
+      }
+      if (vm.count("heatmap")) {
+        std::string mode = vm["heatmap"].as<std::string>();
+        if (mode == "count") {
+          control.heatmapMode = kHeatmapModeCount;
+        }
+        else if (mode == "maxy") {
+          control.heatmapMode = kHeatmapModeMaxY;
+        }
+        else {
+          log::error("Unknown heatmap mode '{}' (use 'count' or 'maxy')", mode);
+          errct++;
+        }
+      }
+      if (vm.count("heatmap-scale")) {
+        control.heatmapScale = vm["heatmap-scale"].as<int>();
+        if (control.heatmapScale < 1 || control.heatmapScale > 16 || (16 % control.heatmapScale) != 0) {
+          log::error("Heatmap scale must be 1, 2, 4, 8 or 16");
+          errct++;
+        }
+      }
+      if (vm.count("bdiff")) {
+        control.blockListBinary = true;
+      }
+      if (vm.count("block-states")) {
+        control.blockListStates = true;
+      }
+      if (vm.count("entity-diff")) {
+        control.entityDiff = true;
+      }
+      if (vm.count("clusters")) {
+        control.changeClusters = true;
+      }
+      if (vm.count("ndjson")) {
+        control.fnNdjson = vm["ndjson"].as<std::string>();
+        if (control.blockListBinary) {
+          log::error("Use either --bdiff or --ndjson");
+          errct++;
+        }
+      }
+      if (vm.count("bdiff-to-xyz")) {
+        control.fnBlockDiffToXyz = vm["bdiff-to-xyz"].as<std::string>();
+      }
+      if (vm.count("make-patch")) {
+        control.fnMakePatch = vm["make-patch"].as<std::string>();
+        if (control.emptyDbName == "<none>") {
+          log::error("--make-patch needs --empty-db");
+          errct++;
+        }
+      }
+      if (vm.count("apply-patch")) {
+        control.fnApplyPatch = vm["apply-patch"].as<std::string>();
+        if (!control.fnMakePatch.empty()) {
+          log::error("Use either --make-patch or --apply-patch");
+          errct++;
+        }
+      }
+      if (vm.count("rollback")) {
+        control.rollbackWorld = vm["rollback"].as<std::string>();
+      }
+      if (vm.count("read-only")) {
+        control.readOnlyDb = true;
+      }
+      if (vm.count("prefetch")) {
+        control.prefetchBlocks = std::max(0, vm["prefetch"].as<int>());
+      }
+      if (vm.count("rollback-dim")) {
+        control.rollbackDimId = vm["rollback-dim"].as<int>();
+        if (control.rollbackDimId < 0 || control.rollbackDimId >= kDimIdCount) {
+          log::error("Rollback dimension must be 0, 1 or 2");
+          errct++;
+        }
+      }
+      // --prune did,x1,z1,x2,z2 ...
+      if (vm.count("prune")) {
+        for (const auto& optarg : vm["prune"].as<std::vector<std::string>>()) {
+          int32_t dimId = 0, x1 = 0, z1 = 0, x2 = 0, z2 = 0;
+          if (sscanf(optarg.c_str(), "%d,%d,%d,%d,%d", &dimId, &x1, &z1, &x2, &z2) != 5 ||
+              dimId < kDimIdOverworld || dimId >= kDimIdCount) {
+            log::error("Failed to parse --prune {}", optarg);
+            errct++;
+            continue;
+          }
+          control.pruneKeepAreas.push_back({ dimId, x1, z1, x2, z2 });
+        }
+      }
+      if (control.readOnlyDb && (!control.fnApplyPatch.empty() || !control.rollbackWorld.empty() || !control.pruneKeepAreas.empty())) {
+        log::error("--apply-patch, --rollback and --prune change --db, which --read-only does not allow");
+        errct++;
+      }
+      if (vm.count("timeline")) {
+        control.timelineWorlds = vm["timeline"].as<std::vector<std::string>>();
+        if (control.timelineWorlds.size() < 2) {
+          log::error("Timeline needs at least two worlds");
+          errct++;
+        }
+      }
 
 			// --xml fn
 			if (vm.count("xml")) {
@@ -855,7 +974,7 @@ namespace mcpe_viz {
         // todobig - be more clever about dirLeveldb -- allow it to be the dir or the level.dat file
 
         // verify/test args
-	    if (control.dirLeveldb.length() <= 0) {
+	    if (control.dirLeveldb.length() <= 0 && control.fnBlockDiffToXyz.empty() && control.timelineWorlds.empty()) {
             errct++;
             log::error("Must specify --db");
         }
@@ -898,7 +1017,8 @@ int main(int argc, char** argv)
     auto console_log_level = control.quietFlag ? Level::Warn : (control.verboseFlag ? Level::Debug : Level::Info);
     auto file_log_level = control.verboseFlag ? Level::Trace : Level::Debug;
 
-    setup_logger_stage_2(control.logFile(), console_log_level, file_log_level);
+    // keep stdout clean for the json stream
+    setup_logger_stage_2(control.logFile(), console_log_level, file_log_level, control.fnNdjson == "-");
 
     {
         int ret = 0;
@@ -915,9 +1035,39 @@ int main(int argc, char** argv)
     }
     
     loadConfigFile();
+
+    if (!control.fnBlockDiffToXyz.empty()) {
+        std::filesystem::path fnXyz(control.fnBlockDiffToXyz);
+        fnXyz.replace_extension(".xyz");
+        return convertBlockDiffToXyz(control.fnBlockDiffToXyz, fnXyz.generic_string());
+    }
+
+    if (!control.timelineWorlds.empty()) {
+        return world->doOutput_Timeline(control.timelineWorlds);
+    }
     
     world->init();
     world->dbOpen(std::string(mcpe_viz::control.dirLeveldb));
+    if (!control.pruneKeepAreas.empty()) {
+        std::vector<KeepArea> keepAreas;
+        for (const auto& area : control.pruneKeepAreas) {
+            keepAreas.push_back({ area[0], std::min(area[1], area[3]) >> 4, std::max(area[1], area[3]) >> 4,
+                std::min(area[2], area[4]) >> 4, std::max(area[2], area[4]) >> 4 });
+        }
+        int32_t ret = world->prune(keepAreas);
+        world->dbClose();
+        return ret;
+    }
+    if (!control.rollbackWorld.empty()) {
+        int32_t ret = world->rollback(control.rollbackWorld);
+        world->dbClose();
+        return ret;
+    }
+    if (!control.fnMakePatch.empty() || !control.fnApplyPatch.empty()) {
+        int32_t ret = control.fnMakePatch.empty() ? world->applyPatch(control.fnApplyPatch) : world->makePatch(control.fnMakePatch);
+        world->dbClose();
+        return ret;
+    }
     // todobig - we must do this, for now - we could get clever about this later
     // todobig - we could call this deepParseDb() and only do it if the user wanted it
     if (true || mcpe_viz::control.doDetailParseFlag) {
@@ -0,0 +1,80 @@
+#include "minecraft/v2/block_table.h"
+#include "minecraft/v2/block.h"
+#include "config.h"
+#include "define.h"
+
+#include <unordered_map>
+
+namespace mcpe_viz
+{
+    void BlockTable::build()
+    {
+        const size_t stateCount = size_t(kMaxBlockCount) << kDataBits;
+        rgbs.assign(stateCount, kColorDefault);
+        flagList.assign(stateCount, kFlagUnknown);
+        nameIndices.assign(stateCount, 0);
+        names.assign(1, std::string());
+
+        std::unordered_map<std::string, uint16_t> nameMap;
+        for (auto block : Block::list()) {
+            if (block->id < 0 || block->id >= kMaxBlockCount) {
+                continue;
+            }
+            auto it = nameMap.find(block->name);
+            if (it == nameMap.end()) {
+                it = nameMap.emplace(block->name, uint16_t(names.size())).first;
+                names.push_back(block->name);
+            }
+
+            uint8_t blockFlags = 0;
+            if (block->solid) {
+                blockFlags |= kFlagSolid;
+            }
+            if (block->opaque) {
+                blockFlags |= kFlagOpaque;
+            }
+            if (block->liquid) {
+                blockFlags |= kFlagLiquid;
+            }
+            if (block->hasVariants()) {
+                blockFlags |= kFlagVariants;
+            }
+            else if (!block->is_color_set()) {
+                blockFlags |= kFlagNoColor;
+            }
+
+            for (int32_t data = 0; data <= int32_t(kDataMask); data++) {
+                const size_t state = (size_t(block->id) << kDataBits) | size_t(data);
+                auto variant = block->getVariantByBlockData(Block::Variant::DataType(data));
+                uint8_t flags = blockFlags;
+                bool spawnable = block->spawnable;
+                if (variant != nullptr) {
+                    spawnable = variant->spawnable;
+                    rgbs[state] = variant->color();
+                }
+                else {
+                    if (block->hasVariants()) {
+                        flags |= kFlagNoVariant;
+                    }
+                    rgbs[state] = block->color();
+                }
+                if (spawnable) {
+                    flags |= kFlagSpawnable;
+                }
+                flagList[state] = flags;
+                nameIndices[state] = it->second;
+            }
+        }
+        blockLimit = kMaxBlockCount;
+    }
+
+    int32_t BlockTable::findName(const std::string& name)
+    {
+        for (size_t i = 1; i < names.size(); i++) {
+            if (names[i] == name) {
+                return int32_t(i);
+            }
+        }
+        return -1;
+    }
+}
@@ -11,6 +11,9 @@
 #include <fstream>
 #include <algorithm>
 #include <cmath>
+#include <filesystem>
+#include <mutex>
+#include <vector>
 
 #include "util.h"
 #include "world/point_conversion.h"
@@ -94,8 +97,33 @@ namespace mcpe_viz
     }
 
     // nbt parsing helpers
-    int32_t globalNbtListNumber = 0;
-    int32_t globalNbtCompoundNumber = 0;
+    // (dbParse parses with several threads)
+    thread_local int32_t globalNbtListNumber = 0;
+    thread_local int32_t globalNbtCompoundNumber = 0;
+
+    // icon images are numbered in the sorted order of the icon files, so the id's do not depend on
+    // which thread finds an image first
+    int32_t iconImageId(const std::string& fImage)
+    {
+        static std::once_flag once;
+        std::call_once(once, []() {
+            std::vector<std::string> files;
+            std::error_code ec;
+            for (const auto& entry : std::filesystem::directory_iterator(static_path("images"), ec)) {
+                const std::string fn = entry.path().filename().generic_string();
+                if (fn.rfind("bedrock_viz.block.", 0) == 0 || fn.rfind("bedrock_viz.item.", 0) == 0) {
+                    files.push_back("images/" + fn);
+                }
+            }
+            std::sort(files.begin(), files.end());
+            for (const auto& fn : files) {
+                imageFileMap.insert(std::make_pair(fn, globalIconImageId++));
+            }
+        });
+        // read only from here on
+        auto it = imageFileMap.find(fImage);
+        return (it != imageFileMap.end()) ? it->second : -1;
+    }
 
     int32_t parseNbtTag(const char* hdr, int& indent, const MyNbtTag& t)
     {
@@ -446,6 +474,9 @@ namespace mcpe_viz
         }
         std::string toStringWithImageCoords(int32_t dimId)
         {
+            if (!imagePointsKnown(dimId)) {
+                return std::string("(" + toString() + ")");
+            }
             return std::string("(" + toString() + " @ image " + toStringImageCoords(dimId) + ")");
         }
     };
@@ -741,17 +772,11 @@ namespace mcpe_viz
             }
 
             if (file_exists(static_path(urlImage).generic_string())) {
-                std::string fImage(urlImage);
-                int32_t imgId = -1;
-                if (has_key(imageFileMap, fImage)) {
-                    imgId = imageFileMap[fImage];
-                }
-                else {
-                    imgId = globalIconImageId++;
-                    imageFileMap.insert(std::make_pair(fImage, imgId));
+                const int32_t imgId = iconImageId(std::string(urlImage));
+                if (imgId >= 0) {
+                    sprintf(tmpstring, "\"imgid\":%d", imgId);
+                    list.push_back(tmpstring);
                 }
-                sprintf(tmpstring, "\"imgid\":%d", imgId);
-                list.push_back(tmpstring);
             }
 
 
@@ -1983,7 +2008,7 @@ namespace mcpe_viz
 
             std::string geojson = entity->toGeoJSON(actualDimensionId);
             if (geojson.length() > 0) {
-                listGeoJSON.push_back(geojson);
+                listGeoJSON.push_back({ actualDimensionId, geojson });
             }
 
             entityList.push_back(std::move(entity));
@@ -2215,7 +2240,7 @@ namespace mcpe_viz
 
                 std::string json = tileEntity->toGeoJSON(dimensionId);
                 if (json.size() > 0) {
-                    listGeoJSON.push_back(json);
+                    listGeoJSON.push_back({ dimensionId, json });
                 }
 
                 tileEntityList.push_back(std::move(tileEntity));
@@ -2363,7 +2388,7 @@ namespace mcpe_viz
 
                             std::string json = portal->toGeoJSON();
                             if (json.size() > 0) {
-                                listGeoJSON.push_back(json);
+                                listGeoJSON.push_back({ portal->dimId, json });
                             }
 
                             portalList.push_back(std::move(portal));
@@ -2789,7 +2814,7 @@ namespace mcpe_viz
 
                             std::string json = village->toGeoJSON();
                             if (json.size() > 0) {
-                                listGeoJSON.push_back(json);
+                                listGeoJSON.push_back({ kDimIdOverworld, json });
                             }
 
                             villageList.push_back(std::move(village));
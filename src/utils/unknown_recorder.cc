@@ -4,6 +4,7 @@
 #include <utility>
 #include <map>
 #include <set>
+#include <mutex>
 
 namespace
 {
@@ -19,12 +20,16 @@ namespace
     std::set<int32_t> sUnknownBiomeId;
     std::set<int32_t> sUnknownItemId;
     std::set<int32_t> sUnknownEntityId;
+
+    // the block list scans with several threads
+    std::mutex sUnknownMutex;
 }
 
 namespace mcpe_viz {
 
     void record_unknown_block_variant(int32_t blockId, const std::string& blockName, int32_t blockData)
     {
+        std::lock_guard<std::mutex> lock(sUnknownMutex);
         using std::make_pair;
 
         if (sUnknownBlockVariants.find(make_pair(blockId, blockData)) == sUnknownBlockVariants.end()) {
@@ -34,31 +39,37 @@ namespace mcpe_viz {
 
     void record_unknow_uname(const std::string& uname)
     {
+        std::lock_guard<std::mutex> lock(sUnknownMutex);
         unknown_uname.insert(uname);
     }
 
     void record_unknown_block_id(int32_t id)
     {
+        std::lock_guard<std::mutex> lock(sUnknownMutex);
         sUnknownBlockId.insert(id);
     }
 
     void record_unknown_biome_id(int32_t id)
     {
+        std::lock_guard<std::mutex> lock(sUnknownMutex);
         sUnknownBiomeId.insert(id);
     }
 
     void record_unknown_item_id(int32_t itemId)
     {
+        std::lock_guard<std::mutex> lock(sUnknownMutex);
         sUnknownItemId.insert(itemId);
     }
 
     void record_unknown_entity_id(int32_t entityId)
     {
+        std::lock_guard<std::mutex> lock(sUnknownMutex);
         sUnknownEntityId.insert(entityId);
     }
 
     void record_unknown_item_variant(int32_t itemId, const std::string& itemName, int32_t blockData)
     {
+        std::lock_guard<std::mutex> lock(sUnknownMutex);
         using std::make_pair;
 
         if (sUnknownItemVariants.find(make_pair(itemId, blockData)) == sUnknownItemVariants.end()) {
@@ -68,6 +79,7 @@ namespace mcpe_viz {
 
     void record_unknown_entity_variant(int32_t entityId, const std::string& entityName, int32_t extraData)
     {
+        std::lock_guard<std::mutex> lock(sUnknownMutex);
         using std::make_pair;
         if (sUnknownEntityVariants.find(make_pair(entityId, extraData)) == sUnknownEntityVariants.end()) {
             sUnknownEntityVariants.insert(make_pair(make_pair(entityId, extraData), entityName));
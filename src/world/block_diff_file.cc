@@ -0,0 +1,279 @@
+#include "world/block_diff_file.h"
+#include "world/block_list.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char kBlockDiffMagic[4] = { 'B', 'V', 'D', 'F' };
+    const uint32_t kBlockDiffVersion = 1;
+
+    bool chunkLess(const mcpe_viz::BlockDiffChunk& a, const mcpe_viz::BlockDiffChunk& b)
+    {
+        return (a.chunkX < b.chunkX) || (a.chunkX == b.chunkX && a.chunkZ < b.chunkZ);
+    }
+}
+
+namespace mcpe_viz {
+
+    BlockDiffEntryBuilder::BlockDiffEntryBuilder()
+    {
+        memset(&entry, 0, sizeof(entry));
+        memset(paletteIndex, 0xff, sizeof(paletteIndex));
+    }
+
+    void BlockDiffEntryBuilder::reset(int32_t chunkX, int32_t chunkZ, int32_t subChunk)
+    {
+        for (auto id : palette) {
+            paletteIndex[id] = -1;
+        }
+        palette.clear();
+        changes.clear();
+        memset(entry.mask, 0, sizeof(entry.mask));
+        entry.chunkX = chunkX;
+        entry.chunkZ = chunkZ;
+        entry.subChunk = subChunk;
+    }
+
+    void BlockDiffEntryBuilder::add(int32_t blockPos, uint16_t oldBlockId, uint16_t newBlockId)
+    {
+        for (uint16_t id : { oldBlockId, newBlockId }) {
+            if (paletteIndex[id] < 0) {
+                paletteIndex[id] = int16_t(palette.size());
+                palette.push_back(id);
+            }
+            changes.push_back(uint16_t(paletteIndex[id]));
+        }
+        entry.mask[blockPos >> 6] |= uint64_t(1) << (blockPos & 63);
+    }
+
+    size_t BlockDiffEntryBuilder::write(std::ostream& out) const
+    {
+        BlockDiffEntry e = entry;
+        e.paletteCount = uint16_t(palette.size());
+        e.changeCount = uint16_t(changes.size() / 2);
+        out.write(reinterpret_cast<const char*>(&e), sizeof(e));
+        out.write(reinterpret_cast<const char*>(palette.data()), palette.size() * sizeof(uint16_t));
+        out.write(reinterpret_cast<const char*>(changes.data()), changes.size() * sizeof(uint16_t));
+
+        const size_t size = e.byteSize();
+        const size_t used = sizeof(e) + (palette.size() + changes.size()) * sizeof(uint16_t);
+        static const char padding[8] = {};
+        out.write(padding, size - used);
+        return size;
+    }
+
+    int32_t BlockDiffWriter::open(const std::string& fnOut, int32_t dimId)
+    {
+        fn = fnOut;
+        out.open(fn, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            log::error("Failed to open output file (fn={})", fn);
+            return -1;
+        }
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kBlockDiffMagic, 4);
+        header.version = kBlockDiffVersion;
+        header.dimId = dimId;
+        header.dataOffset = sizeof(header);
+        // the header is written again once we know where the index goes
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        index.clear();
+        return 0;
+    }
+
+    int32_t BlockDiffWriter::appendPart(const std::string& fnPart, const std::vector<BlockDiffChunk>& chunks)
+    {
+        const uint64_t base = uint64_t(out.tellp());
+        std::ifstream in(fnPart, std::ios::binary);
+        if (in.peek() != std::ifstream::traits_type::eof()) {
+            out << in.rdbuf();
+        }
+
+        for (auto chunk : chunks) {
+            chunk.offset += base;
+            header.entryCount += chunk.entryCount;
+            // a chunk column can be split over two parts
+            if (!index.empty() && index.back().chunkX == chunk.chunkX && index.back().chunkZ == chunk.chunkZ) {
+                index.back().entryCount += chunk.entryCount;
+            }
+            else {
+                index.push_back(chunk);
+            }
+        }
+        return 0;
+    }
+
+    int32_t BlockDiffWriter::close()
+    {
+        std::sort(index.begin(), index.end(), chunkLess);
+        header.chunkCount = uint32_t(index.size());
+        header.indexOffset = uint64_t(out.tellp());
+        out.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(BlockDiffChunk));
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        if (!out) {
+            log::error("Failed to write output file (fn={})", fn);
+            return -1;
+        }
+        return 0;
+    }
+
+    int32_t BlockDiffFile::open(const std::string& fn)
+    {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(fn.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            log::error("Failed to open input file (fn={})", fn);
+            return -1;
+        }
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (map == nullptr) {
+            CloseHandle(file);
+            log::error("Failed to map input file (fn={})", fn);
+            return -1;
+        }
+        fileHandle = file;
+        mapHandle = map;
+        size = size_t(fileSize.QuadPart);
+        data = static_cast<const char*>(MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0));
+#else
+        int fd = ::open(fn.c_str(), O_RDONLY);
+        if (fd < 0) {
+            log::error("Failed to open input file (fn={} error={} ({}))", fn, strerror(errno), errno);
+            return -1;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) {
+                data = static_cast<const char*>(p);
+                size = size_t(st.st_size);
+            }
+        }
+        ::close(fd);
+#endif
+        if (data == nullptr) {
+            log::error("Failed to map input file (fn={})", fn);
+            close();
+            return -1;
+        }
+
+        if (size < sizeof(BlockDiffHeader) || memcmp(header().magic, kBlockDiffMagic, 4) != 0 || header().version != kBlockDiffVersion) {
+            log::error("Not a block diff file (fn={})", fn);
+            close();
+            return -1;
+        }
+        const auto& h = header();
+        if (h.dataOffset > h.indexOffset || h.indexOffset > size ||
+            (size - h.indexOffset) / sizeof(BlockDiffChunk) < h.chunkCount) {
+            log::error("Block diff file is truncated (fn={})", fn);
+            close();
+            return -1;
+        }
+        for (size_t i = 0; i < chunkCount(); i++) {
+            if (chunk(i).offset < h.dataOffset || chunk(i).offset >= h.indexOffset) {
+                log::error("Block diff file has a bad chunk index (fn={})", fn);
+                close();
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    void BlockDiffFile::close()
+    {
+#ifdef _WIN32
+        if (data != nullptr) {
+            UnmapViewOfFile(data);
+        }
+        if (mapHandle != nullptr) {
+            CloseHandle(mapHandle);
+        }
+        if (fileHandle != nullptr) {
+            CloseHandle(fileHandle);
+        }
+        fileHandle = mapHandle = nullptr;
+#else
+        if (data != nullptr) {
+            munmap(const_cast<char*>(data), size);
+        }
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const BlockDiffChunk* BlockDiffFile::findChunk(int32_t chunkX, int32_t chunkZ) const
+    {
+        const BlockDiffChunk* begin = chunks();
+        const BlockDiffChunk* end = begin + chunkCount();
+        BlockDiffChunk target{ chunkX, chunkZ, 0, 0, 0 };
+        const BlockDiffChunk* it = std::lower_bound(begin, end, target, chunkLess);
+        if (it != end && it->chunkX == chunkX && it->chunkZ == chunkZ) {
+            return it;
+        }
+        return nullptr;
+    }
+
+    int32_t convertBlockDiffToXyz(const std::string& fnBdiff, const std::string& fnXyz)
+    {
+        BlockDiffFile diff;
+        if (diff.open(fnBdiff) != 0) {
+            return -1;
+        }
+        std::ofstream xyz(fnXyz);
+        if (!xyz) {
+            log::error("Failed to open output file (fn={})", fnXyz);
+            return -1;
+        }
+
+        const char* end = reinterpret_cast<const char*>(&diff.header()) + diff.header().indexOffset;
+        const BlockDiffEntry* entry = diff.firstEntry();
+        for (uint64_t i = 0; i < diff.header().entryCount; i++, entry = BlockDiffFile::nextEntry(entry)) {
+            if (reinterpret_cast<const char*>(entry) + sizeof(BlockDiffEntry) > end ||
+                reinterpret_cast<const char*>(entry) + entry->byteSize() > end) {
+                log::error("Block diff file is truncated (fn={})", fnBdiff);
+                return -1;
+            }
+
+            int32_t change = 0;
+            for (int32_t word = 0; word < 64; word++) {
+                for (uint64_t bits = entry->mask[word]; bits != 0; bits &= bits - 1) {
+                    int32_t bit = 0;
+                    while (((bits >> bit) & 1) == 0) {
+                        bit++;
+                    }
+                    const int32_t blockPos = word * 64 + bit;
+                    if (change >= entry->changeCount || entry->changes()[change * 2 + 1] >= entry->paletteCount) {
+                        log::error("Block diff file has a bad entry (fn={})", fnBdiff);
+                        return -1;
+                    }
+                    const uint16_t blockid = entry->newBlockId(change++);
+                    // like the block list, removed blocks (air) are not part of the point cloud
+                    if (blockid != 0) {
+                        writeBlockXyz(xyz, entry->chunkX * 16 + (blockPos >> 8), entry->subChunk * 16 + (blockPos & 0x0f),
+                            entry->chunkZ * 16 + ((blockPos >> 4) & 0x0f), blockid);
+                    }
+                }
+            }
+        }
+
+        log::info("Converted {} changed subchunks in {} chunks to '{}'", diff.header().entryCount, diff.chunkCount(), fnXyz);
+        return 0;
+    }
+}
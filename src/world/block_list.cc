@@ -0,0 +1,511 @@
+#include "world/block_list.h"
+#include "world/chunk_key.h"
+#include "world/common.h"
+#include "world/db_merge.h"
+#include "world/misc.h"
+#include "world/palette.h"
+#include "control.h"
+#include "define.h"
+#include "logger.h"
+#include "util.h"
+#include "minecraft/v2/block.h"
+#include "minecraft/v2/block_table.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace
+{
+    // unpack a subchunk record into a v3-style buffer of block id's
+    int32_t decodeSubChunk(const leveldb::Slice& value, int16_t* emuchunk)
+    {
+        if (value.size() > 0 && value.data()[0] == 0x00) {
+            // 0.17 style subchunk - block id's are stored directly
+            if (value.size() < 4097) {
+                return -1;
+            }
+            memset(emuchunk, 0, mcpe_viz::NUM_BYTES_CHUNK_V3 * sizeof(int16_t));
+            for (int32_t i = 0; i < 4097; i++) {
+                emuchunk[i] = uint8_t(value.data()[i]);
+            }
+            // block data nibbles follow the id's
+            const int32_t dataSize = std::min(int32_t(value.size()) - 4097, 2048);
+            for (int32_t i = 0; i < dataSize; i++) {
+                emuchunk[4097 + i] = uint8_t(value.data()[4097 + i]);
+            }
+            return 0;
+        }
+        return mcpe_viz::convertChunkV7toV3(value.data(), value.size(), emuchunk);
+    }
+
+    // compare the data nibble of one block of two v3-style buffers
+    bool sameBlockData(const int16_t* a, const int16_t* b, int32_t cx, int32_t cz, int32_t cy)
+    {
+        const int32_t bdoff = (cx << 8) | (cz << 4) | cy;
+        const int32_t shift = (bdoff & 1) ? 4 : 0;
+        return ((a[4097 + bdoff / 2] >> shift) & 0x0f) == ((b[4097 + bdoff / 2] >> shift) & 0x0f);
+    }
+}
+
+namespace mcpe_viz {
+
+    bool blockListLess(const BlockListCoords& a, const BlockListCoords& b)
+    {
+        return std::make_tuple(a.y >> 4, a.z >> 4, a.x >> 4, a.x & 0x0f, a.z & 0x0f, a.y & 0x0f) <
+            std::make_tuple(b.y >> 4, b.z >> 4, b.x >> 4, b.x & 0x0f, b.z & 0x0f, b.y & 0x0f);
+    }
+
+    void BlockListStats::add(const BlockListStats& other)
+    {
+        worldChunksFound += other.worldChunksFound;
+        emptyMatchChunks += other.emptyMatchChunks;
+        addedChunks += other.addedChunks;
+        removedChunks += other.removedChunks;
+        sizeDiffChunks += other.sizeDiffChunks;
+        sameBytesChunks += other.sameBytesChunks;
+        sameBlocksChunks += other.sameBlocksChunks;
+        paletteChunks += other.paletteChunks;
+    }
+
+    void ChangeHeatmap::add(int32_t x, int32_t y, int32_t z)
+    {
+        auto& column = chunks[{ z >> 4, x >> 4 }][((x & 0x0f) << 4) | (z & 0x0f)];
+        column.count++;
+        column.maxY = std::max(column.maxY, y);
+    }
+
+    void ChangeHeatmap::merge(const ChangeHeatmap& other)
+    {
+        for (const auto& chunk : other.chunks) {
+            auto& columns = chunks[chunk.first];
+            for (int32_t i = 0; i < 256; i++) {
+                columns[i].count += chunk.second[i].count;
+                columns[i].maxY = std::max(columns[i].maxY, chunk.second[i].maxY);
+            }
+        }
+    }
+
+    NdjsonStream::NdjsonStream(std::ostream& out, const std::string& dimName, size_t partCount)
+        : dimName(dimName)
+        , out(out)
+        , head(0)
+        , done(partCount, false)
+        , pending(partCount)
+    {
+    }
+
+    void NdjsonStream::write(size_t part, std::string& buffer, bool partDone)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!partDone) {
+            // the buffer is full - wait until the parts before this one are written
+            headChanged.wait(lock, [&]() { return head == part; });
+            out.write(buffer.data(), buffer.size());
+            out.flush();
+            buffer.clear();
+            return;
+        }
+
+        done[part] = true;
+        if (part != head) {
+            pending[part].swap(buffer);
+            buffer.clear();
+            return;
+        }
+        out.write(buffer.data(), buffer.size());
+        buffer.clear();
+        for (head++; head < done.size() && done[head]; head++) {
+            out.write(pending[head].data(), pending[head].size());
+            std::string().swap(pending[head]);
+        }
+        out.flush();
+        headChanged.notify_all();
+    }
+
+    void NdjsonStream::writeRecord(const std::string& record)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        out.write(record.data(), record.size());
+        out.flush();
+    }
+
+    void writeBlockXyz(std::ostream& out, int32_t x, int32_t y, int32_t z, uint16_t blockid)
+    {
+        auto block = Block::get(blockid);
+        if (block == nullptr) {
+            return;
+        }
+        uint32_t color = block->color();
+        uint8_t r = (color >> 8) & 0xFF;
+        uint8_t g = (color >> 16) & 0xFF;
+        uint8_t b = (color >> 24) & 0xFF;
+        out << x << ", " << y << ", " << z << ", ";
+        out << (int16_t)r << ", " << (int16_t)g << ", " << (int16_t)b << '\n';
+    }
+
+    // record one block that differs from the comparison world (or any block, if there is none)
+    void BlockListPart::reportBlock(const BlockListLimits& limits, int32_t x, int32_t y, int32_t z, uint16_t blockid,
+        uint16_t oldBlockId)
+    {
+        if (!limits.contains(x, y, z) || blockid >= kMaxBlockId) {
+            return;
+        }
+
+        const int32_t state = BlockTable::state(blockid, 0);
+        if (BlockTable::flags(state) & BlockTable::kFlagUnknown) {
+            return;
+        }
+
+        if (heatmap)
+        {
+            heatmap->add(x, y, z);
+        }
+
+        if (limits.allBlocks || BlockTable::nameIndex(state) == limits.filterName)
+        {
+            if (clusterBuilder)
+            {
+                clusterBuilder->add(x, y, z, blockid, oldBlockId);
+            }
+            if (ndjson != nullptr)
+            {
+                // like the binary diff, json keeps removed blocks
+                addToRun(x, y, z, blockid, oldBlockId);
+            }
+            else if (bdiff.is_open())
+            {
+                // the binary diff also keeps removed blocks
+                diffEntry.add(((x & 0x0f) << 8) | ((z & 0x0f) << 4) | (y & 0x0f), oldBlockId < kMaxBlockId ? oldBlockId : 0, blockid);
+            }
+            // Ignore air blocks in output point cloud
+            else if (blockid != 0)
+            {
+                writeBlockXyz(xyz, x, y, z, blockid);
+            }
+            const BlockListLine line{ { x, y, z }, blockid };
+            if (listLines.size() < control.blockListMax)
+            {
+                listLines.push_back(line);
+                std::push_heap(listLines.begin(), listLines.end());
+            }
+            else if (!listLines.empty() && line < listLines.front())
+            {
+                // replace the last line so far
+                std::pop_heap(listLines.begin(), listLines.end());
+                listLines.back() = line;
+                std::push_heap(listLines.begin(), listLines.end());
+            }
+        }
+
+        blockCnt[blockid] += 1;
+
+        if (blockCnt[blockid] <= control.blockListRare)
+        {
+            blockLists[blockid].push_back({ x, y, z });
+        }
+    }
+
+    void BlockListPart::addToRun(int32_t x, int32_t y, int32_t z, uint16_t blockid, uint16_t oldBlockId)
+    {
+        // blocks are reported in (x, z, y) order within a subchunk
+        if (runOpen && run.x == x && run.z == z && run.maxY + 1 == y && run.blockId == blockid && run.oldBlockId == oldBlockId) {
+            run.maxY = y;
+            return;
+        }
+        flushRun();
+        run = { x, z, y, y, blockid, oldBlockId };
+        runOpen = true;
+    }
+
+    void BlockListPart::flushRun()
+    {
+        if (!runOpen) {
+            return;
+        }
+        runOpen = false;
+
+        auto block = Block::get(run.blockId);
+        auto oldBlock = Block::get(run.oldBlockId);
+        ndjsonBuf += "{\"type\":\"block\",\"dim\":\"" + ndjson->dimName + "\",\"x\":" + std::to_string(run.x) +
+            ",\"y\":" + std::to_string(run.minY) + ",\"z\":" + std::to_string(run.z) +
+            ",\"height\":" + std::to_string(run.maxY - run.minY + 1) +
+            ",\"id\":" + std::to_string(run.blockId) +
+            ",\"name\":\"" + (block ? escapeString(block->name, "\"\\") : std::string()) +
+            "\",\"old_id\":" + std::to_string(run.oldBlockId) +
+            ",\"old_name\":\"" + (oldBlock ? escapeString(oldBlock->name, "\"\\") : std::string()) + "\"}\n";
+    }
+
+    void BlockListPart::finishNdjson()
+    {
+        if (ndjson == nullptr) {
+            return;
+        }
+        flushRun();
+        ndjson->write(ndjsonPart, ndjsonBuf, true);
+    }
+
+    void BlockListPart::compareSubChunk(const ChunkRecordKey& ck, const leveldb::Slice& valueA, const leveldb::Slice* valueB,
+        const BlockListLimits& limits)
+    {
+        if (!clusterBuilder) {
+            writeSubChunk(ck, valueA, valueB, limits);
+            return;
+        }
+
+        // the clusters inside a subchunk are known once it has been compared
+        clusterBuilder->begin(ck.chunkX, ck.subChunk, ck.chunkZ);
+        writeSubChunk(ck, valueA, valueB, limits);
+        SubChunkClusters subChunkClusters;
+        if (clusterBuilder->end(subChunkClusters)) {
+            clusters.push_back(std::move(subChunkClusters));
+        }
+    }
+
+    // compare one subchunk and write the changes to the output of this part
+    void BlockListPart::writeSubChunk(const ChunkRecordKey& ck, const leveldb::Slice& valueA, const leveldb::Slice* valueB,
+        const BlockListLimits& limits)
+    {
+        if (ndjson != nullptr) {
+            // runs end at the subchunk border
+            compareBlocks(ck, valueA, valueB, limits);
+            flushRun();
+            if (ndjsonBuf.size() >= NdjsonStream::kMaxBuffer) {
+                ndjson->write(ndjsonPart, ndjsonBuf, false);
+            }
+            return;
+        }
+        if (!bdiff.is_open()) {
+            compareBlocks(ck, valueA, valueB, limits);
+            return;
+        }
+
+        diffEntry.reset(ck.chunkX, ck.chunkZ, ck.subChunk);
+        compareBlocks(ck, valueA, valueB, limits);
+        if (diffEntry.empty()) {
+            return;
+        }
+
+        // subchunks of one chunk column are next to each other in key order
+        if (bdiffChunks.empty() || bdiffChunks.back().chunkX != ck.chunkX || bdiffChunks.back().chunkZ != ck.chunkZ) {
+            bdiffChunks.push_back({ ck.chunkX, ck.chunkZ, 0, 0, bdiffSize });
+        }
+        bdiffChunks.back().entryCount++;
+        bdiffSize += diffEntry.write(bdiff);
+    }
+
+    // compare one subchunk of the world with the same subchunk of the comparison world (if there is one)
+    void BlockListPart::compareBlocks(const ChunkRecordKey& ck, const leveldb::Slice& valueA, const leveldb::Slice* valueB,
+        const BlockListLimits& limits)
+    {
+        const int32_t baseX = ck.chunkX * 16;
+        const int32_t baseZ = ck.chunkZ * 16;
+        const int32_t baseY = ck.subChunk * 16;
+
+        // don't bother decoding subchunks that are completely outside of the limits
+        if (limits.excludesSubChunk(baseX, baseY, baseZ)) {
+            return;
+        }
+
+        if (valueB != nullptr)
+        {
+            // most subchunks are untouched between two copies of a world - in that case the records are
+            // byte-for-byte identical and there is nothing to report (a size mismatch rules this out cheaply)
+            if (valueA.size() != valueB->size())
+            {
+                stats.sizeDiffChunks++;
+            }
+            else if (memcmp(valueA.data(), valueB->data(), valueA.size()) == 0)
+            {
+                stats.sameBytesChunks++;
+                return;
+            }
+
+            // compare the block palettes and packed block indices directly
+            int32_t ret;
+            if (control.blockListStates)
+            {
+                if (!statesA) {
+                    statesA = std::make_unique<SubChunkStates>();
+                    statesB = std::make_unique<SubChunkStates>();
+                }
+                ret = compareSubChunkStates(valueA.data(), valueA.size(), valueB->data(), valueB->size(), stateIndex,
+                    *statesA, *statesB, blockDiffs);
+            }
+            else
+            {
+                ret = comparePalettedSubChunks(valueA.data(), valueA.size(), valueB->data(), valueB->size(), blockDiffs);
+            }
+            if (ret == 0)
+            {
+                stats.paletteChunks++;
+                if (blockDiffs.empty())
+                {
+                    stats.sameBlocksChunks++;
+                }
+                for (const auto& diff : blockDiffs)
+                {
+                    reportBlock(limits, baseX + (diff.blockPos >> 8), baseY + (diff.blockPos & 0x0f),
+                        baseZ + ((diff.blockPos >> 4) & 0x0f), diff.blockId, diff.otherBlockId);
+                }
+                return;
+            }
+        }
+
+        int16_t* worldChunk = &worldChunkBuf[0];
+        int16_t* emptyChunk = &emptyChunkBuf[0];
+        if (decodeSubChunk(valueA, worldChunk) != 0)
+        {
+            return;
+        }
+        if (valueB != nullptr)
+        {
+            if (decodeSubChunk(*valueB, emptyChunk) != 0)
+            {
+                return;
+            }
+
+            // records can differ (e.g. palette order or light) while the block id's (and data) are the same
+            const size_t compareSize = control.blockListStates ? (4097 + 2048) : 4097;
+            if (memcmp(worldChunk, emptyChunk, compareSize * sizeof(int16_t)) == 0)
+            {
+                stats.sameBlocksChunks++;
+                return;
+            }
+        }
+
+        // the first byte is not interesting to us (it is version #?)
+        const int16_t* chunkPtr = &worldChunk[1];
+        const int16_t* emptyPtr = nullptr;
+        if (valueB != nullptr)
+        {
+            emptyPtr = &emptyChunk[1];
+        }
+
+        // we step through the chunk in the natural order to speed things up
+        for (int32_t cx = 0; cx < 16; cx++) {
+            for (int32_t cz = 0; cz < 16; cz++) {
+                for (int32_t cy = 0; cy < 16; cy++) {
+                    uint16_t blockid = *(chunkPtr++);
+                    if (emptyPtr != nullptr)
+                    {
+                        uint16_t emptyId = *(emptyPtr++);
+                        if (emptyId == blockid && (!control.blockListStates || sameBlockData(worldChunk, emptyChunk, cx, cz, cy)))
+                        {
+                            // When doing a comparison, ignore identical bocks!
+                            continue;
+                        }
+                        reportBlock(limits, baseX + cx, baseY + cy, baseZ + cz, blockid, emptyId);
+                    }
+                    else
+                    {
+                        reportBlock(limits, baseX + cx, baseY + cy, baseZ + cz, blockid, 0);
+                    }
+                }
+            }
+        }
+    }
+
+    void BlockListPart::scanRecord(const DbMergeIterator& iter, bool compare, int32_t dimId, const BlockListLimits& limits)
+    {
+        ChunkRecordKey ck;
+        const leveldb::Slice skey = iter.key();
+        if (!parseChunkRecordKey(skey.data(), skey.size(), ck)) {
+            return;
+        }
+        if (ck.dimId != dimId) {
+            return;
+        }
+        if (entities && (ck.type == 0x31 || ck.type == 0x32) && !limits.excludesChunk(ck.chunkX * 16, ck.chunkZ * 16)) {
+            const leveldb::Slice valueA = iter.inA() ? iter.valueA() : leveldb::Slice();
+            const leveldb::Slice valueB = iter.inB() ? iter.valueB() : leveldb::Slice();
+            entities->compareRecords(iter.inA() ? &valueA : nullptr, iter.inB() ? &valueB : nullptr, ck.type == 0x31);
+            return;
+        }
+        if (ck.type != 0x2f || ck.subChunk < 0) {
+            return;
+        }
+
+        if (!iter.inA()) {
+            // subchunk only exists in the comparison world
+            stats.removedChunks++;
+            return;
+        }
+
+        stats.worldChunksFound++;
+        if (compare)
+        {
+            if (!iter.inB())
+            {
+                // When doing a diff, skip unless the chunk exists in both worlds
+                stats.addedChunks++;
+                return;
+            }
+            stats.emptyMatchChunks++;
+            const leveldb::Slice valueB = iter.valueB();
+            compareSubChunk(ck, iter.valueA(), &valueB, limits);
+        }
+        else
+        {
+            compareSubChunk(ck, iter.valueA(), nullptr, limits);
+        }
+    }
+
+    int32_t BlockListPart::scan(leveldb::DB* db, leveldb::DB* emptyDb, int32_t dimId, const BlockListLimits& limits)
+    {
+        // we walk both db's side by side in key order and only look at subchunk records that exist
+        worldChunkBuf.resize(NUM_BYTES_CHUNK_V3);
+        emptyChunkBuf.resize(NUM_BYTES_CHUNK_V3);
+
+        DbMergeIterator iter(db, emptyDb, levelDbReadOptions, chunkPrefixes.empty());
+        if (!chunkPrefixes.empty()) {
+            // small region of interest: only visit its chunk columns
+            for (const auto& prefix : chunkPrefixes) {
+                for (iter.seek(prefix); iter.valid() && iter.key().starts_with(prefix); iter.next()) {
+                    scanRecord(iter, emptyDb != nullptr, dimId, limits);
+                }
+            }
+        }
+        else {
+            for (iter.seek(startKey); iter.valid(); iter.next()) {
+                if (!endKey.empty() && iter.key().compare(endKey) >= 0) {
+                    break;
+                }
+                scanRecord(iter, emptyDb != nullptr, dimId, limits);
+            }
+        }
+
+        if (!iter.status().ok()) {
+            log::warn("LevelDB operation returned status={}", iter.status().ToString());
+            return -1;
+        }
+        return 0;
+    }
+
+    int32_t BlockListPart::scanKeys(leveldb::DB* db, leveldb::DB* emptyDb, const BlockListLimits& limits)
+    {
+        // the subchunk index already told us which shared subchunks differ, look them up directly
+        worldChunkBuf.resize(NUM_BYTES_CHUNK_V3);
+        emptyChunkBuf.resize(NUM_BYTES_CHUNK_V3);
+        ChunkRecordKey ck;
+        std::string valueA, valueB;
+
+        for (const auto& key : keys) {
+            if (!parseChunkRecordKey(key.data(), key.size(), ck) ||
+                limits.excludesSubChunk(ck.chunkX * 16, ck.subChunk * 16, ck.chunkZ * 16)) {
+                continue;
+            }
+            leveldb::Status status = db->Get(levelDbReadOptions, key, &valueA);
+            if (status.ok()) {
+                status = emptyDb->Get(levelDbReadOptions, key, &valueB);
+            }
+            if (!status.ok()) {
+                // the index is out of date - this should not happen, as it is updated before we get here
+                log::warn("LevelDB operation returned status={}", status.ToString());
+                return -1;
+            }
+            const leveldb::Slice sliceB(valueB);
+            compareSubChunk(ck, valueA, &sliceB, limits);
+        }
+        return 0;
+    }
+}
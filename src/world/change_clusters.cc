@@ -0,0 +1,222 @@
+#include "world/change_clusters.h"
+
+#include <algorithm>
+
+namespace
+{
+    // block position inside a subchunk (v3 order)
+    inline uint16_t blockPos(int32_t lx, int32_t ly, int32_t lz)
+    {
+        return uint16_t((lx << 8) | (lz << 4) | ly);
+    }
+
+    inline bool onBoundary(int32_t lx, int32_t ly, int32_t lz)
+    {
+        return lx == 0 || lx == 15 || ly == 0 || ly == 15 || lz == 0 || lz == 15;
+    }
+
+    // floor division by 16
+    inline int32_t subChunkOf(int32_t v)
+    {
+        return v >> 4;
+    }
+}
+
+namespace mcpe_viz {
+
+    void ChangeCluster::merge(const ChangeCluster& other)
+    {
+        minX = std::min(minX, other.minX);
+        minY = std::min(minY, other.minY);
+        minZ = std::min(minZ, other.minZ);
+        maxX = std::max(maxX, other.maxX);
+        maxY = std::max(maxY, other.maxY);
+        maxZ = std::max(maxZ, other.maxZ);
+        blockCount += other.blockCount;
+        for (const auto& b : other.newBlocks) {
+            newBlocks[b.first] += b.second;
+        }
+        for (const auto& b : other.oldBlocks) {
+            oldBlocks[b.first] += b.second;
+        }
+    }
+
+    void SubChunkClusterBuilder::begin(int32_t chunkX, int32_t subChunk, int32_t chunkZ)
+    {
+        this->chunkX = chunkX;
+        this->subChunk = subChunk;
+        this->chunkZ = chunkZ;
+        changed.reset();
+        positions.clear();
+    }
+
+    void SubChunkClusterBuilder::add(int32_t x, int32_t y, int32_t z, uint16_t blockId, uint16_t oldBlockId)
+    {
+        const uint16_t pos = blockPos(x & 0x0f, y & 0x0f, z & 0x0f);
+        if (changed[pos]) {
+            return;
+        }
+        changed[pos] = true;
+        positions.push_back(pos);
+        newIds[pos] = blockId;
+        oldIds[pos] = oldBlockId;
+        parent[pos] = pos;
+    }
+
+    uint16_t SubChunkClusterBuilder::find(uint16_t pos)
+    {
+        while (parent[pos] != pos) {
+            parent[pos] = parent[parent[pos]];
+            pos = parent[pos];
+        }
+        return pos;
+    }
+
+    bool SubChunkClusterBuilder::end(SubChunkClusters& out)
+    {
+        if (positions.empty()) {
+            return false;
+        }
+        std::sort(positions.begin(), positions.end());
+
+        // union-find over the 26 neighbours inside the subchunk
+        for (uint16_t pos : positions) {
+            const int32_t lx = pos >> 8, lz = (pos >> 4) & 0x0f, ly = pos & 0x0f;
+            for (int32_t dx = -1; dx <= 1; dx++) {
+                for (int32_t dz = -1; dz <= 1; dz++) {
+                    for (int32_t dy = -1; dy <= 1; dy++) {
+                        const int32_t nx = lx + dx, nz = lz + dz, ny = ly + dy;
+                        if ((nx | ny | nz) & ~0x0f) {
+                            continue;
+                        }
+                        const uint16_t npos = blockPos(nx, ny, nz);
+                        if (npos < pos && changed[npos]) {
+                            const uint16_t a = find(pos), b = find(npos);
+                            if (a != b) {
+                                parent[std::max(a, b)] = std::min(a, b);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        out.chunkX = chunkX;
+        out.subChunk = subChunk;
+        out.chunkZ = chunkZ;
+        out.clusters.clear();
+        out.boundary.clear();
+        const int32_t baseX = chunkX * 16, baseY = subChunk * 16, baseZ = chunkZ * 16;
+        std::map<uint16_t, uint32_t> clusterOfRoot;
+        for (uint16_t pos : positions) {
+            const int32_t lx = pos >> 8, lz = (pos >> 4) & 0x0f, ly = pos & 0x0f;
+            const int32_t x = baseX + lx, y = baseY + ly, z = baseZ + lz;
+            auto it = clusterOfRoot.emplace(find(pos), uint32_t(out.clusters.size())).first;
+            if (it->second == out.clusters.size()) {
+                out.clusters.emplace_back();
+                auto& c = out.clusters.back();
+                c.minX = c.maxX = x;
+                c.minY = c.maxY = y;
+                c.minZ = c.maxZ = z;
+            }
+            auto& c = out.clusters[it->second];
+            c.minX = std::min(c.minX, x);
+            c.minY = std::min(c.minY, y);
+            c.minZ = std::min(c.minZ, z);
+            c.maxX = std::max(c.maxX, x);
+            c.maxY = std::max(c.maxY, y);
+            c.maxZ = std::max(c.maxZ, z);
+            c.blockCount++;
+            c.newBlocks[newIds[pos]]++;
+            c.oldBlocks[oldIds[pos]]++;
+            if (onBoundary(lx, ly, lz)) {
+                out.boundary.push_back({ pos, it->second });
+            }
+        }
+        return true;
+    }
+
+    uint32_t ChangeClusters::find(uint32_t i)
+    {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+
+    void ChangeClusters::unite(uint32_t a, uint32_t b)
+    {
+        a = find(a);
+        b = find(b);
+        if (a != b) {
+            parent[std::max(a, b)] = std::min(a, b);
+        }
+    }
+
+    void ChangeClusters::add(SubChunkClusters& subChunk)
+    {
+        const uint32_t firstCluster = uint32_t(clusters.size());
+        for (auto& c : subChunk.clusters) {
+            parent.push_back(uint32_t(clusters.size()));
+            clusters.push_back(std::move(c));
+        }
+
+        // link boundary blocks to touching boundary blocks of the neighbouring subchunks
+        const Linked* neighbours[27];
+        for (int32_t i = 0; i < 27; i++) {
+            const auto it = subChunks.find(std::make_tuple(subChunk.chunkX + (i / 9) - 1, subChunk.subChunk + (i % 3) - 1,
+                subChunk.chunkZ + ((i / 3) % 3) - 1));
+            neighbours[i] = (i != 13 && it != subChunks.end()) ? &it->second : nullptr;
+        }
+        for (const auto& b : subChunk.boundary) {
+            const int32_t lx = b.first >> 8, lz = (b.first >> 4) & 0x0f, ly = b.first & 0x0f;
+            for (int32_t dx = -1; dx <= 1; dx++) {
+                for (int32_t dz = -1; dz <= 1; dz++) {
+                    for (int32_t dy = -1; dy <= 1; dy++) {
+                        const int32_t nx = lx + dx, nz = lz + dz, ny = ly + dy;
+                        if (((nx | ny | nz) & ~0x0f) == 0) {
+                            continue;
+                        }
+                        const int32_t sx = subChunkOf(nx), sy = subChunkOf(ny), sz = subChunkOf(nz);
+                        const Linked* n = neighbours[(sx + 1) * 9 + (sz + 1) * 3 + (sy + 1)];
+                        if (n == nullptr) {
+                            continue;
+                        }
+                        const uint16_t npos = blockPos(nx & 0x0f, ny & 0x0f, nz & 0x0f);
+                        auto it = std::lower_bound(n->boundary.begin(), n->boundary.end(), std::make_pair(npos, uint32_t(0)));
+                        if (it != n->boundary.end() && it->first == npos) {
+                            unite(firstCluster + b.second, n->firstCluster + it->second);
+                        }
+                    }
+                }
+            }
+        }
+
+        auto& linked = subChunks[std::make_tuple(subChunk.chunkX, subChunk.subChunk, subChunk.chunkZ)];
+        linked.boundary.swap(subChunk.boundary);
+        linked.firstCluster = firstCluster;
+        subChunk.clusters.clear();
+    }
+
+    std::vector<ChangeCluster> ChangeClusters::result()
+    {
+        std::vector<ChangeCluster> out;
+        std::map<uint32_t, size_t> indexOfRoot;
+        for (uint32_t i = 0; i < clusters.size(); i++) {
+            const uint32_t root = find(i);
+            auto it = indexOfRoot.find(root);
+            if (it == indexOfRoot.end()) {
+                indexOfRoot.emplace(root, out.size());
+                out.push_back(std::move(clusters[i]));
+            }
+            else {
+                out[it->second].merge(clusters[i]);
+            }
+        }
+        std::stable_sort(out.begin(), out.end(), [](const ChangeCluster& a, const ChangeCluster& b) {
+            return a.blockCount > b.blockCount;
+        });
+        return out;
+    }
+}
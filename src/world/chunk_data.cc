@@ -3,13 +3,58 @@
 #include "global.h"
 #include "nbt.h"
 #include "world/misc.h"
+#include "world/palette.h"
+#include "world/palette_unpack.h"
 #include "world/point_conversion.h"
 #include "world/common.h"
 #include "utils/unknown_recorder.h"
 #include "minecraft/v2/block.h"
+#include "minecraft/v2/block_table.h"
+
+#include <algorithm>
+#include <bitset>
+
+namespace
+{
+    // the palette of a paletted subchunk record (resolved to block id's) and its unpacked palette indices
+    // returns nullptr if the record is bad
+    const std::vector<mcpe_viz::PaletteBlock>* decodeSubChunk_v7(const char* cdata, size_t cdata_size,
+        uint16_t* paletteIndices)
+    {
+        // determine location of chunk palette
+        int32_t blocksPerWord = -1;
+        int32_t bitsPerBlock = -1;
+        bool paddingFlag = false;
+        int32_t offsetBlockInfoList = -1;
+        int32_t extraOffset = -1;
+
+        //logger.msg(kLogWarning,"hey -- cdata %02x %02x %02x\n", cdata[0], cdata[1], cdata[2]);
+
+        if (mcpe_viz::setupBlockVars_v7(cdata, blocksPerWord, bitsPerBlock, paddingFlag, offsetBlockInfoList,
+            extraOffset) != 0) {
+            return nullptr;
+        }
+
+        // read chunk palette and associate old-school block id's
+        static thread_local mcpe_viz::PaletteBlockCache paletteCache;
+        const int32_t paletteOffset = offsetBlockInfoList + 2 + extraOffset;
+        const std::vector<mcpe_viz::PaletteBlock>* palette = nullptr;
+        if (int64_t(cdata_size) > paletteOffset) {
+            palette = paletteCache.resolve(&cdata[paletteOffset], cdata + cdata_size);
+        }
+        if (palette == nullptr) {
+            mcpe_viz::log::warn("Bad chunk palette in _do_chunk_v7");
+            return nullptr;
+        }
+
+        // expand all palette indices at once
+        mcpe_viz::unpackPaletteIndices(&cdata[2 + extraOffset], bitsPerBlock, paletteIndices);
+        return palette;
+    }
+}
 
 namespace mcpe_viz {
-    int32_t ChunkData_LevelDB::_do_chunk_v2(int32_t tchunkX, int32_t tchunkZ, const char* cdata,
+    int32_t ChunkData_LevelDB::_do_chunk_v2(int32_t tchunkX, int32_t tchunkZ, const char* cdata, size_t cdata_size,
         int32_t dimensionId, const std::string& dimName,
         const bool* fastBlockHideList, const bool* fastBlockForceTopList,
         const bool* fastBlockToGeoJSON,
@@ -41,12 +86,20 @@ namespace mcpe_viz {
             }
         }
 
+        // decode the whole record once
+        static thread_local LegacyTerrain terrain;
+        decodeLegacyTerrain_LevelDB_v2(cdata, cdata_size, terrain);
+        const uint8_t* blockData = terrain.blockData();
+        const uint8_t* skyLight = terrain.skyLight();
+        const uint8_t* blockLight = terrain.blockLight();
+
         // iterate over chunk space
         uint8_t blockId;
         for (int32_t cy = MAX_BLOCK_HEIGHT_127; cy >= 0; cy--) {
             for (int32_t cx = 0; cx < 16; cx++) {
                 for (int32_t cz = 0; cz < 16; cz++) {
-                    blockId = getBlockId_LevelDB_v2(cdata, cx, cz, cy);
+                    const int32_t off = terrain.offset(cx, cz, cy);
+                    blockId = terrain.blockId[off];
 
                     // todobig - handle block variant?
                     if (fastBlockToGeoJSON[blockId]) {
@@ -64,7 +117,7 @@ namespace mcpe_viz {
                         std::string json = ""
                             + makeGeojsonHeader(ix, iy)
                             + tmpstring;
-                        listGeoJSON.push_back(json);
+                        listGeoJSON.push_back({ dimensionId, json });
                     }
 
                     // check spawnable -- cannot check spawn at 0 or MAX_BLOCK_HEIGHT because we need above/below blocks
@@ -84,31 +137,29 @@ namespace mcpe_viz {
 
                             // "the spawning block itself must be non-opaque and non-liquid"
                             // we add: non-solid
-                            auto block = Block::get(blockId);
-                            if (block != nullptr &&
-                                !block->opaque &&
-                                !block->liquid &&
-                                !block->solid) {
+                            const uint8_t spawnFlags = BlockTable::kFlagUnknown | BlockTable::kFlagOpaque |
+                                BlockTable::kFlagLiquid | BlockTable::kFlagSolid;
+                            if ((BlockTable::flags(BlockTable::state(blockId, 0)) & spawnFlags) == 0) {
 
                                 // "the block directly above it must be non-opaque"
 
-                                uint8_t aboveBlockId = getBlockId_LevelDB_v2(cdata, cx, cz, cy + 1);
-                                auto aboveBlock = Block::get(aboveBlockId);
-                                if (aboveBlock != nullptr && !aboveBlock->opaque) {
+                                uint8_t aboveBlockId = terrain.blockId[off + 1];
+                                const uint8_t aboveFlags = BlockTable::flags(BlockTable::state(aboveBlockId, 0));
+                                if ((aboveFlags & (BlockTable::kFlagUnknown | BlockTable::kFlagOpaque)) == 0) {
 
                                     // "the block directly below it must have a solid top surface (opaque, upside down slabs / stairs and others)"
                                     // "the block directly below it may not be bedrock or barrier" -- take care of with 'spawnable'
 
-                                    uint8_t belowBlockId = getBlockId_LevelDB_v2(cdata, cx, cz, cy - 1);
-                                    uint8_t belowBlockData = getBlockData_LevelDB_v2(cdata, cx, cz, cy - 1);
+                                    uint8_t belowBlockId = terrain.blockId[off - 1];
+                                    uint8_t belowBlockData = blockData[off - 1];
 
-                                    auto belowBlock = Block::get(belowBlockId);
-                                    if (belowBlock != nullptr && belowBlock->isSpawnable(belowBlockData)) {
+                                    const int32_t belowState = BlockTable::state(belowBlockId, belowBlockData);
+                                    if (BlockTable::flags(belowState) & BlockTable::kFlagSpawnable) {
                                     //if ( blockInfoList[belowBlockId].isOpaque() && blockInfoList[belowBlockId].isSpawnable(belowBlockData) ) {
                                     //if (blockInfoList[belowBlockId].isSpawnable(belowBlockData)) {
 
                                         // check the light level
-                                        uint8_t bl = getBlockBlockLight_LevelDB_v2(cdata, cx, cz, cy);
+                                        uint8_t bl = blockLight[off];
                                         if (bl <= 7) {
                                             // spwawnable! add it to the list
                                             double ix, iy;
@@ -127,7 +178,7 @@ namespace mcpe_viz {
                                             std::string json = ""
                                                 + makeGeojsonHeader(ix, iy)
                                                 + tmpstring;
-                                            listGeoJSON.push_back(json);
+                                            listGeoJSON.push_back({ dimensionId, json });
                                         }
                                     }
                                 }
@@ -143,15 +194,14 @@ namespace mcpe_viz {
                             fastBlockForceTopList[blockId]) {
 
                             blocks[cx][cz] = blockId;
-                            data[cx][cz] = getBlockData_LevelDB_v2(cdata, cx, cz, cy);
+                            data[cx][cz] = blockData[off];
                             topBlockY[cx][cz] = cy;
 
 #if 1
                             // todo - we are getting the block light ABOVE this block (correct?)
                             // todo - this will break if we are using force-top stuff
                             int32_t cy2 = cy;
-                            auto block = Block::get(blockId);
-                            if (block != nullptr && block->solid) {
+                            if (BlockTable::flags(BlockTable::state(blockId, 0)) & BlockTable::kFlagSolid) {
                             // if (blockInfoList[blockId].isSolid()) {
                                 // move to block above this block
                                 cy2++;
@@ -160,8 +210,8 @@ namespace mcpe_viz {
                             else {
                                 // if not solid, don't adjust
                             }
-                            uint8_t sl = getBlockSkyLight_LevelDB_v2(cdata, cx, cz, cy2);
-                            uint8_t bl = getBlockBlockLight_LevelDB_v2(cdata, cx, cz, cy2);
+                            uint8_t sl = skyLight[terrain.offset(cx, cz, cy2)];
+                            uint8_t bl = blockLight[terrain.offset(cx, cz, cy2)];
                             // we combine the light nibbles into a byte
                             topLight[cx][cz] = (sl << 4) | bl;
 #endif
@@ -213,14 +263,21 @@ namespace mcpe_viz {
             }
         }
 
+        // decode the whole record once
+        static thread_local LegacyTerrain terrain;
+        decodeLegacyTerrain_LevelDB_v3(cdata, cdata_size, terrain);
+        const uint8_t* blockData = terrain.blockData();
+        const uint8_t* skyLight = terrain.skyLight();
+        const uint8_t* blockLight = terrain.blockLight();
+
         // iterate over chunk space
         uint8_t blockId;
         for (int32_t cy = 0; cy < 16; cy++) {
             for (int32_t cx = 0; cx < 16; cx++) {
                 for (int32_t cz = 0; cz < 16; cz++) {
-                    blockId = getBlockId_LevelDB_v3(cdata, cx, cz, cy);
-                    auto block = Block::get(blockId);
-                    if (block == nullptr) {
+                    blockId = terrain.blockId[terrain.offset(cx, cz, cy)];
+                    const uint8_t blockFlags = BlockTable::flags(BlockTable::state(blockId, 0));
+                    if (blockFlags & BlockTable::kFlagUnknown) {
                         continue;
                     }
                     // todobig - handle block variant?
@@ -233,13 +290,13 @@ namespace mcpe_viz {
                             "\"Block\": true, "
                             "\"Dimension\": \"%d\", "
                             "\"Pos\": [%d, %d, %d]"
-                            "} }", block->name.c_str(), dimensionId,
+                            "} }", Block::get(blockId)->name.c_str(), dimensionId,
                             chunkX * 16 + cx, chunkY * 16 + cy, chunkZ * 16 + cz
                         );
                         std::string json = ""
                             + makeGeojsonHeader(ix, iy)
                             + tmpstring;
-                        listGeoJSON.push_back(json);
+                        listGeoJSON.push_back({ dimensionId, json });
                     }
 
                     // note: we check spawnable later
@@ -256,7 +313,7 @@ namespace mcpe_viz {
                             fastBlockForceTopList[blockId]) {
 
                             blocks[cx][cz] = blockId;
-                            data[cx][cz] = getBlockData_LevelDB_v3(cdata, cdata_size, cx, cz, cy);
+                            data[cx][cz] = blockData[terrain.offset(cx, cz, cy)];
                             topBlockY[cx][cz] = realy;
 
                             int32_t cy2 = cy;
@@ -265,7 +322,7 @@ namespace mcpe_viz {
 #if 1
                                 // todo - we are getting the block light ABOVE this block (correct?)
                                 // todo - this will break if we are using force-top stuff
-                            if (block->solid) {
+                            if (blockFlags & BlockTable::kFlagSolid) {
                                 // move to block above this block
                                 cy2++;
                                 if (cy2 > MAX_BLOCK_HEIGHT) { cy2 = MAX_BLOCK_HEIGHT; }
@@ -274,8 +331,9 @@ namespace mcpe_viz {
                                 // if not solid, don't adjust
                             }
 #endif
-                            uint8_t sl = getBlockSkyLight_LevelDB_v3(cdata, cdata_size, cx, cz, cy2);
-                            uint8_t bl = getBlockBlockLight_LevelDB_v3(cdata, cdata_size, cx, cz, cy2);
+                            // (cy2 can be 16, which is the first block of the next column, as it always was)
+                            uint8_t sl = skyLight[terrain.offset(cx, cz, cy2)];
+                            uint8_t bl = blockLight[terrain.offset(cx, cz, cy2)];
                             // we combine the light nibbles into a byte
                             topLight[cx][cz] = (sl << 4) | bl;
                         }
@@ -319,91 +377,39 @@ namespace mcpe_viz {
             }
         }
 
-        // determine location of chunk palette
-        int32_t blocksPerWord = -1;
-        int32_t bitsPerBlock = -1;
-        bool paddingFlag = false;
-        int32_t offsetBlockInfoList = -1;
-        int32_t extraOffset = -1;
-
-        //logger.msg(kLogWarning,"hey -- cdata %02x %02x %02x\n", cdata[0], cdata[1], cdata[2]);
-
-        if (setupBlockVars_v7(cdata, blocksPerWord, bitsPerBlock, paddingFlag, offsetBlockInfoList, extraOffset) !=
-            0) {
+        uint16_t paletteIndices[16 * 16 * 16];
+        const std::vector<PaletteBlock>* palette = decodeSubChunk_v7(cdata, cdata_size, paletteIndices);
+        if (palette == nullptr) {
             return -1;
         }
 
-        // read chunk palette and associate old-school block id's
-        MyNbtTagList tagList;
-        int xoff = offsetBlockInfoList + 6 + extraOffset;
-
-        parseNbtQuiet(&cdata[xoff], int32_t(cdata_size - xoff), cdata[offsetBlockInfoList + 3], tagList);
-        //parseNbt("chunk-palette",&cdata[xoff], cdata_size-xoff, tagList);
-
-        std::vector<int32_t> chunkBlockPalette_BlockId(tagList.size());
-        std::vector<int32_t> chunkBlockPalette_BlockData(tagList.size());
-
-        for (size_t i = 0; i < tagList.size(); i++) {
-            // check tagList
-            if (tagList[i].second->get_type() == nbt::tag_type::Compound) {
-                nbt::tag_compound tc = tagList[i].second->as<nbt::tag_compound>();
-
-                bool processedFlag = false;
-                if (tc.has_key("name", nbt::tag_type::String)) {
-                    std::string bname = tc["name"].as<nbt::tag_string>().get();
-                    int bdata = 0;
-                    if (tc.has_key("val", nbt::tag_type::Short)) {
-                        bdata = tc["val"].as<nbt::tag_short>().get();
-                    }
-
-                    auto block = Block::getByUname(bname);
-                    if (block != nullptr) {
-                        chunkBlockPalette_BlockId[i] = block->id;
-                        // todonow - correct?
-                        chunkBlockPalette_BlockData[i] = bdata;
-                    }
-                    else {
-                        record_unknow_uname(bname);
-                        // todonow - reasonable?
-                        chunkBlockPalette_BlockId[i] = 0;
-                        chunkBlockPalette_BlockData[i] = 0;
-                    }
-                    processedFlag = true;
-                }
-                if (!processedFlag) {
-                    log::warn("Did not find 'name' tag in a chunk palette! (i={}) (len={})", i, tagList.size());
-                    //todozooz - dump tc to screen log
-                }
-            }
-            else {
-                log::warn("Unexpected NBT format in _do_chunk_v7");
-            }
-        }
-
         //todozooz -- new 16-bit block-id's (instead of 8-bit) are a BIG issue - this needs attention here
         // iterate over chunk space
-        uint8_t paletteBlockId, blockData;
+        uint16_t paletteBlockId;
+        uint8_t blockData;
         int32_t blockId;
+        int32_t blockState;
         for (int32_t cy = 0; cy < 16; cy++) {
             for (int32_t cx = 0; cx < 16; cx++) {
                 for (int32_t cz = 0; cz < 16; cz++) {
-                    paletteBlockId = getBlockId_LevelDB_v7(&cdata[2 + extraOffset],
-                        blocksPerWord, bitsPerBlock, cx, cz, cy);
+                    paletteBlockId = paletteIndices[(((cx * 16) + cz) * 16) + cy];
 
                     // look up blockId
                     // TODO error checking
-                    if (paletteBlockId < chunkBlockPalette_BlockId.size()) {
-                        blockId = chunkBlockPalette_BlockId[paletteBlockId];
-                        blockData = chunkBlockPalette_BlockData[paletteBlockId];
+                    if (paletteBlockId < palette->size()) {
+                        blockId = (*palette)[paletteBlockId].blockId;
+                        blockData = uint8_t((*palette)[paletteBlockId].blockData);
+                        blockState = (*palette)[paletteBlockId].state;
                     }
                     else {
                         blockId = 0;
                         blockData = 0;
+                        blockState = BlockTable::state(0, 0);
                         log::warn("Found chunk palette id out of range {} (size={})",
-                            paletteBlockId, chunkBlockPalette_BlockId.size());
+                            paletteBlockId, palette->size());
                     }
-                    auto block = Block::get(blockId);
-                    if (block == nullptr) {
+                    const uint8_t blockFlags = BlockTable::flags(blockState);
+                    if (blockFlags & BlockTable::kFlagUnknown) {
                         continue;
                     }
 
@@ -417,13 +423,13 @@ namespace mcpe_viz {
                             "\"Block\": true, "
                             "\"Dimension\": \"%d\", "
                             "\"Pos\": [%d, %d, %d]"
-                            "} }", block->name.c_str(), dimensionId,
+                            "} }", Block::get(blockId)->name.c_str(), dimensionId,
                             chunkX * 16 + cx, chunkY * 16 + cy, chunkZ * 16 + cz
                         );
                         std::string json = ""
                             + makeGeojsonHeader(ix, iy)
                             + tmpstring;
-                        listGeoJSON.push_back(json);
+                        listGeoJSON.push_back({ dimensionId, json });
                     }
 
                     // note: we check spawnable later
@@ -449,7 +455,7 @@ namespace mcpe_viz {
 #if 1
                                 // todo - we are getting the block light ABOVE this block (correct?)
                                 // todo - this will break if we are using force-top stuff
-                            if (block->solid) {
+                            if (blockFlags & BlockTable::kFlagSolid) {
                                 // move to block above this block
                                 cy2++;
                                 if (cy2 > MAX_BLOCK_HEIGHT) { cy2 = MAX_BLOCK_HEIGHT; }
@@ -470,6 +476,83 @@ namespace mcpe_viz {
         }
         return 0;
     }
+
+    int32_t ChunkData_LevelDB::_do_chunk_v7_top(int32_t tchunkX, int32_t tchunkZ, SubChunkRecord* subchunks, size_t count,
+        const bool* fastBlockHideList)
+    {
+        chunkX = tchunkX;
+        chunkZ = tchunkZ;
+        chunkFormatVersion = 7;
+
+        std::sort(subchunks, subchunks + count, [](const SubChunkRecord& a, const SubChunkRecord& b) {
+            return a.chunkY > b.chunkY;
+        });
+
+        // bit (cx * 16) + cz is set once that column has its top block
+        std::bitset<16 * 16> resolved;
+        uint16_t paletteIndices[16 * 16 * 16];
+        std::vector<bool> candidate;
+        for (size_t i = 0; i < count && !resolved.all(); i++) {
+            const int32_t chunkY = subchunks[i].chunkY;
+            // (a block below y=0 never becomes the top block, see _do_chunk_v7)
+            if (chunkY < 0) {
+                break;
+            }
+            const std::vector<PaletteBlock>* palette = decodeSubChunk_v7(subchunks[i].value.data(),
+                subchunks[i].value.size(), paletteIndices);
+            if (palette == nullptr) {
+                continue;
+            }
+
+            // the palette entries that can be a top block; a subchunk of air and hidden blocks is done here
+            candidate.assign(palette->size(), false);
+            bool anyCandidate = false;
+            for (size_t p = 0; p < palette->size(); p++) {
+                const int32_t blockId = (*palette)[p].blockId;
+                if (blockId != 0 && !(BlockTable::flags((*palette)[p].state) & BlockTable::kFlagUnknown) &&
+                    !fastBlockHideList[blockId]) {
+                    candidate[p] = true;
+                    anyCandidate = true;
+                }
+            }
+            if (!anyCandidate) {
+                continue;
+            }
+
+            for (int32_t column = 0; column < 16 * 16; column++) {
+                if (resolved[column]) {
+                    continue;
+                }
+                const int32_t cx = column / 16;
+                const int32_t cz = column % 16;
+                for (int32_t cy = 15; cy >= 0; cy--) {
+                    const uint16_t paletteBlockId = paletteIndices[(column * 16) + cy];
+                    if (paletteBlockId >= palette->size()) {
+                        log::warn("Found chunk palette id out of range {} (size={})",
+                            paletteBlockId, palette->size());
+                        continue;
+                    }
+                    if (!candidate[paletteBlockId]) {
+                        continue;
+                    }
+                    // same rule as _do_chunk_v7: a higher top block from a legacy subchunk of this chunk
+                    // (added before, through _do_chunk_v3) stays
+                    const int32_t realy = chunkY * 16 + cy;
+                    if (realy >= topBlockY[cx][cz]) {
+                        blocks[cx][cz] = (*palette)[paletteBlockId].blockId;
+                        data[cx][cz] = uint8_t((*palette)[paletteBlockId].blockData);
+                        topBlockY[cx][cz] = realy;
+                        // no block light or sky light in v7 chunks
+                        topLight[cx][cz] = 0;
+                    }
+                    resolved.set(column);
+                    break;
+                }
+            }
+        }
+        return 0;
+    }
+
     int32_t ChunkData_LevelDB::_do_chunk_biome_v3(int32_t tchunkX, int32_t tchunkZ, const char* cdata, int32_t cdatalen)
     {
         chunkX = tchunkX;
@@ -517,6 +600,7 @@ namespace mcpe_viz {
         std::string svalue;
         const char* pchunk = nullptr;
         size_t pchunk_size;
+        static thread_local LegacyTerrain terrain;
         for (int8_t cubicy = 0; cubicy < MAX_CUBIC_Y; cubicy++) {
 
             // todobug - this fails around level 112? on another1 -- weird -- run a valgrind to see where we're messing up
@@ -546,18 +630,15 @@ namespace mcpe_viz {
                 pchunk = svalue.data();
                 pchunk_size = svalue.size();
 
-                // copy data
-                // todobig - make this faster with memcpy's -- it is important to consider the way we'll extract the data later :)
+                // copy data: a column of the subchunk is 16 bytes in a row in both layouts
+                decodeLegacyTerrain_LevelDB_v3(pchunk, pchunk_size, terrain);
                 for (int32_t cx = 0; cx < 16; cx++) {
                     for (int32_t cz = 0; cz < 16; cz++) {
-                        for (int32_t ccy = 0; ccy < 16; ccy++) {
-                            int32_t cy = cubicy * 16 + ccy;
-
-                            int32_t off = _calcOffsetBlock_LevelDB_v3_fullchunk(cx, cz, cy);
-                            blockidData[off] = getBlockId_LevelDB_v3(pchunk, cx, cz, ccy);
-                            blockdataData[off] = getBlockData_LevelDB_v3(pchunk, pchunk_size, cx, cz, ccy);
-                            blocklightData[off] = getBlockBlockLight_LevelDB_v3(pchunk, pchunk_size, cx, cz, ccy);
-                        }
+                        const int32_t off = _calcOffsetBlock_LevelDB_v3_fullchunk(cx, cz, cubicy * 16);
+                        const int32_t toff = terrain.offset(cx, cz, 0);
+                        memcpy(&blockidData[off], &terrain.blockId[toff], 16);
+                        memcpy(&blockdataData[off], &terrain.blockData()[toff], 16);
+                        memcpy(&blocklightData[off], &terrain.blockLight()[toff], 16);
                     }
                 }
 
@@ -593,17 +674,15 @@ namespace mcpe_viz {
 
                             // "the spawning block itself must be non-opaque and non-liquid"
                             // we add: non-solid
-                            auto block = Block::get(blockId);
-                            if (block != nullptr &&
-                                !block->opaque &&
-                                !block->liquid &&
-                                !block->solid) {
+                            const uint8_t spawnFlags = BlockTable::kFlagUnknown | BlockTable::kFlagOpaque |
+                                BlockTable::kFlagLiquid | BlockTable::kFlagSolid;
+                            if ((BlockTable::flags(BlockTable::state(blockId, 0)) & spawnFlags) == 0) {
 
                                 // "the block directly above it must be non-opaque"
 
                                 uint8_t aboveBlockId = getData_LevelDB_v3_fullchunk(blockidData, cx, cz, cy + 1);
-                                auto aboveBlock = Block::get(aboveBlockId);
-                                if (aboveBlock != nullptr && !aboveBlock->opaque) {
+                                const uint8_t aboveFlags = BlockTable::flags(BlockTable::state(aboveBlockId, 0));
+                                if ((aboveFlags & (BlockTable::kFlagUnknown | BlockTable::kFlagOpaque)) == 0) {
 
                                     // "the block directly below it must have a solid top surface (opaque, upside down slabs / stairs and others)"
                                     // "the block directly below it may not be bedrock or barrier" -- take care of with 'spawnable'
@@ -612,8 +691,8 @@ namespace mcpe_viz {
                                         cy - 1);
                                     uint8_t belowBlockData = getData_LevelDB_v3_fullchunk(blockdataData, cx, cz,
                                         cy - 1);
-                                    auto belowBlock = Block::get(belowBlockId);
-                                    if (belowBlock != nullptr && belowBlock->isSpawnable(belowBlockData)) {
+                                    const int32_t belowState = BlockTable::state(belowBlockId, belowBlockData);
+                                    if (BlockTable::flags(belowState) & BlockTable::kFlagSpawnable) {
                                     //if ( blockInfoList[belowBlockId].isOpaque() && blockInfoList[belowBlockId].isSpawnable(belowBlockData) ) {
                                     // if (blockInfoList[belowBlockId].isSpawnable(belowBlockData)) {
 
@@ -637,7 +716,7 @@ namespace mcpe_viz {
                                             std::string json = ""
                                                 + makeGeojsonHeader(ix, iy)
                                                 + tmpstring;
-                                            listGeoJSON.push_back(json);
+                                            listGeoJSON.push_back({ dimId, json });
                                         }
                                     }
                                 }
@@ -0,0 +1,62 @@
+#include "world/chunk_key.h"
+#include "define.h"
+#include "util.h"
+
+namespace mcpe_viz {
+
+    bool parseChunkRecordKey(const char* key, size_t keySize, ChunkRecordKey& out)
+    {
+        if (keySize != 9 && keySize != 10 && keySize != 13 && keySize != 14) {
+            return false;
+        }
+
+        out.chunkX = myParseInt32(key, 0);
+        out.chunkZ = myParseInt32(key, 4);
+        out.subChunk = -1;
+
+        int32_t typeOffset = 8;
+        if (keySize >= 13) {
+            out.dimId = myParseInt32(key, 8);
+            typeOffset = 12;
+
+            // adjust weird dim id's
+            if (out.dimId == 0x32373639) {
+                out.dimId = kDimIdTheEnd;
+            }
+            if (out.dimId == 0x33373639) {
+                out.dimId = kDimIdNether;
+            }
+            if (out.dimId != kDimIdNether && out.dimId != kDimIdTheEnd) {
+                return false;
+            }
+        }
+        else {
+            out.dimId = kDimIdOverworld;
+        }
+
+        out.type = uint8_t(key[typeOffset]);
+        if (keySize == 10 || keySize == 14) {
+            out.subChunk = uint8_t(key[typeOffset + 1]);
+        }
+        return true;
+    }
+
+    std::string makeChunkRecordKey(int32_t dimId, int32_t chunkX, int32_t chunkZ, uint8_t type, int32_t subChunk)
+    {
+        char keybuf[14];
+        int32_t keybuflen = 0;
+
+        memcpy(&keybuf[0], &chunkX, sizeof(int32_t));
+        memcpy(&keybuf[4], &chunkZ, sizeof(int32_t));
+        keybuflen = 8;
+        if (dimId != kDimIdOverworld) {
+            memcpy(&keybuf[8], &dimId, sizeof(int32_t));
+            keybuflen = 12;
+        }
+        keybuf[keybuflen++] = char(type);
+        if (subChunk >= 0) {
+            keybuf[keybuflen++] = char(subChunk);
+        }
+        return std::string(keybuf, keybuflen);
+    }
+}
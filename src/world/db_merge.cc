@@ -0,0 +1,199 @@
+#include "world/db_merge.h"
+#include "world/prefetch_iterator.h"
+
+namespace
+{
+    // chunk keys start with 8 bytes of chunk coordinates; we search that space as a big-endian number
+    std::string makeSplitKey(uint64_t v)
+    {
+        char keybuf[8];
+        for (int32_t i = 0; i < 8; i++) {
+            keybuf[i] = char((v >> (56 - i * 8)) & 0xff);
+        }
+        return std::string(keybuf, 8);
+    }
+
+    uint64_t sizeBefore(leveldb::DB* db, const std::string& key)
+    {
+        leveldb::Range range("", key);
+        uint64_t size = 0;
+        db->GetApproximateSizes(&range, 1, &size);
+        return size;
+    }
+}
+
+namespace mcpe_viz {
+
+    DbMergeIterator::DbMergeIterator(leveldb::DB* dbA, leveldb::DB* dbB, const leveldb::ReadOptions& options, bool prefetch)
+    {
+        auto newIterator = [&](leveldb::DB* db) {
+            return prefetch ? newScanIterator(db, options) : db->NewIterator(options);
+        };
+        iterA = newIterator(dbA);
+        iterB = (dbB != nullptr) ? newIterator(dbB) : nullptr;
+        curA = curB = false;
+    }
+
+    DbMergeIterator::~DbMergeIterator()
+    {
+        delete iterA;
+        delete iterB;
+    }
+
+    void DbMergeIterator::settle()
+    {
+        bool validA = iterA->Valid();
+        bool validB = (iterB != nullptr) && iterB->Valid();
+        if (validA && validB) {
+            // both db's use the default bytewise comparator
+            int c = iterA->key().compare(iterB->key());
+            curA = (c <= 0);
+            curB = (c >= 0);
+        }
+        else {
+            curA = validA;
+            curB = validB;
+        }
+    }
+
+    void DbMergeIterator::seekToFirst()
+    {
+        iterA->SeekToFirst();
+        if (iterB != nullptr) {
+            iterB->SeekToFirst();
+        }
+        settle();
+    }
+
+    void DbMergeIterator::seek(const leveldb::Slice& target)
+    {
+        iterA->Seek(target);
+        if (iterB != nullptr) {
+            iterB->Seek(target);
+        }
+        settle();
+    }
+
+    void DbMergeIterator::next()
+    {
+        if (curA) {
+            iterA->Next();
+        }
+        if (curB) {
+            iterB->Next();
+        }
+        settle();
+    }
+
+    leveldb::Status DbMergeIterator::status() const
+    {
+        if (!iterA->status().ok()) {
+            return iterA->status();
+        }
+        if (iterB != nullptr) {
+            return iterB->status();
+        }
+        return leveldb::Status::OK();
+    }
+
+    DbMultiMergeIterator::DbMultiMergeIterator(const std::vector<leveldb::DB*>& dbs, const leveldb::ReadOptions& options)
+    {
+        for (auto db : dbs) {
+            iters.push_back(db->NewIterator(options));
+        }
+        cur.assign(iters.size(), false);
+        first = -1;
+    }
+
+    DbMultiMergeIterator::~DbMultiMergeIterator()
+    {
+        for (auto iter : iters) {
+            delete iter;
+        }
+    }
+
+    void DbMultiMergeIterator::settle()
+    {
+        // the number of db's is small, so a linear search for the smallest key is fine
+        first = -1;
+        for (size_t i = 0; i < iters.size(); i++) {
+            cur[i] = false;
+            if (!iters[i]->Valid()) {
+                continue;
+            }
+            if (first < 0) {
+                first = int32_t(i);
+                cur[i] = true;
+                continue;
+            }
+            int c = iters[i]->key().compare(iters[first]->key());
+            if (c < 0) {
+                for (int32_t j = first; j < int32_t(i); j++) {
+                    cur[j] = false;
+                }
+                first = int32_t(i);
+                cur[i] = true;
+            }
+            else if (c == 0) {
+                cur[i] = true;
+            }
+        }
+    }
+
+    void DbMultiMergeIterator::seekToFirst()
+    {
+        for (auto iter : iters) {
+            iter->SeekToFirst();
+        }
+        settle();
+    }
+
+    void DbMultiMergeIterator::next()
+    {
+        for (size_t i = 0; i < iters.size(); i++) {
+            if (cur[i]) {
+                iters[i]->Next();
+            }
+        }
+        settle();
+    }
+
+    leveldb::Status DbMultiMergeIterator::status() const
+    {
+        for (auto iter : iters) {
+            if (!iter->status().ok()) {
+                return iter->status();
+            }
+        }
+        return leveldb::Status::OK();
+    }
+
+    std::vector<std::string> splitKeyRange(leveldb::DB* db, int32_t parts)
+    {
+        std::vector<std::string> splits;
+        const uint64_t total = sizeBefore(db, std::string(9, char(0xff)));
+        if (parts <= 1 || total == 0) {
+            return splits;
+        }
+
+        for (int32_t i = 1; i < parts; i++) {
+            const uint64_t target = total / parts * i;
+            uint64_t lo = 0, hi = UINT64_MAX;
+            while (lo < hi) {
+                uint64_t mid = lo + (hi - lo) / 2;
+                if (sizeBefore(db, makeSplitKey(mid)) < target) {
+                    lo = mid + 1;
+                }
+                else {
+                    hi = mid;
+                }
+            }
+            std::string key = makeSplitKey(lo);
+            // size estimates are coarse (one table block), so neighbouring splits can land on the same key
+            if (splits.empty() || splits.back() < key) {
+                splits.push_back(key);
+            }
+        }
+        return splits;
+    }
+}
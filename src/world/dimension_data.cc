@@ -2,16 +2,25 @@
 #include "control.h"
 #include "utils/unknown_recorder.h"
 #include "world/common.h"
+#include "world/block_list.h"
+#include "world/db_merge.h"
 #include "world/misc.h"
+#include "world/roi.h"
 #include "world/point_conversion.h"
 #include "global.h"
 #include "nbt.h"
 #include "utils/fs.h"
 #include "minecraft/v2/biome.h"
 #include "minecraft/v2/block.h"
+#include "minecraft/v2/block_table.h"
+#include "config.h"
 
+#include <cmath>
 #include <random>
 #include <fstream>
+#include <iostream>
+#include <thread>
+#include <atomic>
 
 namespace
 {
@@ -123,6 +132,53 @@ namespace
         static Palette instance;
         return instance;
     }
+
+    // the map color of a block; getBlockData is only called for blocks with variants
+    // the common case is two loads from the block table, the rest takes the registry path so the unknown
+    // ids/variants are recorded as before; colorNeedCount (per block id) counts blocks without a color
+    template<typename GetBlockData>
+    int32_t getBlockColor(int32_t blockid, GetBlockData getBlockData, std::vector<int32_t>* colorNeedCount)
+    {
+        using mcpe_viz::BlockTable;
+        using mcpe_viz::Block;
+
+        int32_t state = BlockTable::state(blockid, 0);
+        if (state < 0) {
+            mcpe_viz::record_unknown_block_id(blockid);
+            return kColorDefault;
+        }
+        uint8_t flags = BlockTable::flags(state);
+        if (flags & BlockTable::kFlagVariants) {
+            state = BlockTable::state(blockid, getBlockData());
+            flags = (state < 0) ? uint8_t(BlockTable::kFlagNoVariant) : BlockTable::flags(state);
+        }
+        const uint8_t report = (colorNeedCount != nullptr)
+            ? BlockTable::kFlagsReport
+            : uint8_t(BlockTable::kFlagUnknown | BlockTable::kFlagNoVariant);
+        if ((flags & report) == 0) {
+            return BlockTable::rgb(state);
+        }
+
+        auto block = Block::get(blockid);
+        if (block == nullptr) {
+            mcpe_viz::record_unknown_block_id(blockid);
+            return kColorDefault;
+        }
+        if (block->hasVariants()) {
+            const int32_t blockdata = getBlockData();
+            auto variant = block->getVariantByBlockData(blockdata);
+            if (variant != nullptr) {
+                return variant->color();
+            }
+            mcpe_viz::record_unknown_block_variant(blockid, block->name, blockdata);
+            // since we did not find the variant, use the parent block's color
+            return block->color();
+        }
+        if (!block->is_color_set() && colorNeedCount != nullptr) {
+            (*colorNeedCount)[blockid] += 1;
+        }
+        return block->color();
+    }
 }
 
 namespace mcpe_viz {
@@ -185,6 +241,9 @@ namespace mcpe_viz {
             rows[i] = &buf[i * imageW * bpp];
         }
 
+        // blocks without a color in the xml, by block id
+        std::vector<int32_t> colorNeedCount(kMaxBlockCount, 0);
+
         int32_t color;
         const char* pcolor;
         if (bpp == 4) {
@@ -296,37 +355,8 @@ namespace mcpe_viz {
                         }
                         else {
                             // regular image
-                            int32_t blockid = it->blocks[cx][cz];
-                            auto block = Block::get(blockid);
-                            if (block != nullptr) {
-
-                                if (block->hasVariants()) {
-                                    // we need to get blockdata
-                                    int32_t blockdata = it->data[cx][cz];
-                                    auto variant = block->getVariantByBlockData(blockdata);
-                                    if (variant != nullptr) {
-                                        color = variant->color();
-                                    }
-                                    else {
-                                        record_unknown_block_variant(
-                                            blockid,
-                                            block->name,
-                                            blockdata);
-                                        // since we did not find the variant, use the parent block's color
-                                        color = block->color();
-                                    }
-                                }
-                                else {
-                                    color = block->color();
-                                    if (!block->is_color_set()) {
-                                        block->color_set_need_count += 1;
-                                    }
-                                }
-                            }
-                            else {
-                                record_unknown_block_id(blockid);
-                                color = kColorDefault;
-                            }
+                            const int32_t blockid = it->blocks[cx][cz];
+                            color = getBlockColor(blockid, [&]() { return int32_t(it->data[cx][cz]); }, &colorNeedCount);
                         }
 
                         // do grid lines
@@ -379,9 +409,9 @@ namespace mcpe_viz {
         // report items that need to have their color set properly (in the XML file)
         if (imageMode == kImageModeTerrain) {
             for(auto& i: Block::list()) {
-                if (i->color_set_need_count != 0) {
+                if (i->id >= 0 && i->id < kMaxBlockCount && colorNeedCount[i->id] != 0) {
                     log::info("    Need pixel color for: 0x{:x} '{}' (count={})",
-                        i->id, i->name, i->color_set_need_count);
+                        i->id, i->name, colorNeedCount[i->id]);
                 }
             }
         }
@@ -474,6 +504,8 @@ namespace mcpe_viz {
         const char* pcolor = (const char*)&color;
 
         int16_t* emuchunk = new int16_t[NUM_BYTES_CHUNK_V3];
+        // pre-1.2 records are decoded whole into this
+        auto terrain = std::make_unique<LegacyTerrain>();
 
         // create png helpers
         PngWriter png[MAX_BLOCK_HEIGHT + 1];
@@ -520,7 +552,6 @@ namespace mcpe_viz {
 
         int32_t foundCt = 0, notFoundCt2 = 0;
         //todozooz -- new 16-bit block-id's (instead of 8-bit) are a BIG issue - this needs attention here
-        uint8_t blockdata;
         int32_t blockid;
 
         // we operate on sets of 16 rows (which is one chunk high) of image z
@@ -561,7 +592,7 @@ namespace mcpe_viz {
 
                     pchunk = svalue.data();
                     ochunk = pchunk;
-                    // size_t ochunk_size = svalue.size();
+                    decodeLegacyTerrain_LevelDB_v2(ochunk, svalue.size(), *terrain);
                     foundCt++;
 
                     // we step through the chunk in the natural order to speed things up
@@ -572,7 +603,7 @@ namespace mcpe_viz {
 
                                 // todo - if we use this, we get blockdata errors... somethings not right
                                 //blockid = *(pchunk++);
-                                blockid = getBlockId_LevelDB_v2(ochunk, cx, cz, cy);
+                                blockid = terrain->blockId[terrain->offset(cx, cz, cy)];
 
                                 if (blockid == 0 && (cy > currTopBlockY) && (dimId != kDimIdNether)) {
 
@@ -587,31 +618,9 @@ namespace mcpe_viz {
 
                                 }
                                 else {
-                                    auto block = Block::get(blockid);
-                                    if (block != nullptr) {
-                                        if (block->hasVariants()) {
-                                            blockdata = getBlockData_LevelDB_v2(ochunk, cx, cz, cy);
-                                            auto variant = block->getVariantByBlockData(blockdata);
-                                            if (variant != nullptr) {
-                                                color = variant->color();
-                                            }
-                                            else {
-                                                record_unknown_block_variant(
-                                                    block->id,
-                                                    block->name,
-                                                    blockdata);
-                                                // since we did not find the variant, use the parent block's color
-                                                color = block->color();
-                                            }
-                                        }
-                                        else {
-                                            color = block->color();
-                                        }
-                                    }
-                                    else {
-                                        record_unknown_block_id(blockid);
-                                        color = kColorDefault;
-                                    }
+                                    color = getBlockColor(blockid, [&]() {
+                                        return int32_t(terrain->blockData()[terrain->offset(cx, cz, cy)]);
+                                    }, nullptr);
 
 #ifdef PIXEL_COPY_MEMCPY
                                     memcpy(&rbuf[cy][((cz * imageW) + imageX + cx) * 3], &pcolor[1], 3);
@@ -693,6 +702,7 @@ namespace mcpe_viz {
                             else {
                                 wordModeFlag = false;
                                 // slogger.msg(kLogWarning,"Found a non-v7 chunk\n");
+                                decodeLegacyTerrain_LevelDB_v3(rchunk, ochunk_size, *terrain);
                             }
 
                             // the first byte is not interesting to us (it is version #?)
@@ -713,7 +723,7 @@ namespace mcpe_viz {
                                         else {
                                             //todozooz - getting blockid manually fixes issue
                                             // blockid = *(pchunk_byte++);
-                                            blockid = getBlockId_LevelDB_v3(ochunk_byte, cx, cz, ccy);
+                                            blockid = terrain->blockId[terrain->offset(cx, cz, ccy)];
                                         }
 
                                         // blockid = getBlockId_LevelDB_v3(ochunk, cx,cz,ccy);
@@ -733,40 +743,13 @@ namespace mcpe_viz {
                                         else {
                                             // TODO not safe 
                                             if (blockid >= 0 && blockid < 1024) {
-                                                auto block = Block::get(blockid);
-                                                if (block != nullptr) {
-                                                    if (block->hasVariants()) {
-                                                        if (wordModeFlag) {
-                                                            blockdata = getBlockData_LevelDB_v3__fake_v7(ochunk_word,
-                                                                ochunk_size,
-                                                                cx, cz, ccy);
-                                                        }
-                                                        else {
-                                                            blockdata = getBlockData_LevelDB_v3(ochunk_byte,
-                                                                ochunk_size, cx, cz,
-                                                                ccy);
-                                                        }
-                                                        auto variant = block->getVariantByBlockData(blockdata);
-                                                        if (variant != nullptr) {
-                                                            color = variant->color();
-                                                        }
-                                                        else {
-                                                            record_unknown_block_variant(
-                                                                block->id,
-                                                                block->name,
-                                                                blockdata);
-                                                            color = block->color();
-                                                        }
-                                                    }
-                                                    else {
-                                                        color = block->color();
+                                                color = getBlockColor(blockid, [&]() {
+                                                    if (wordModeFlag) {
+                                                        return int32_t(getBlockData_LevelDB_v3__fake_v7(ochunk_word,
+                                                            ochunk_size, cx, cz, ccy));
                                                     }
-                                                }
-                                                else {
-                                                    record_unknown_block_id(blockid);
-                                                    color = kColorDefault;
-                                                }
-
+                                                    return int32_t(terrain->blockData()[terrain->offset(cx, cz, ccy)]);
+                                                }, nullptr);
                                             }
                                             else {
                                                 // bad blockid
@@ -858,122 +841,46 @@ namespace mcpe_viz {
     }
 
 
-const int16_t* DimensionData_LevelDB::findChunk(leveldb::DB* db, DimensionType dimId, int32_t x, uint8_t y, int32_t z)
-{
-    char keybuf[128];
-    int32_t keybuflen=0;
-    int32_t kw = dimId;
-    uint8_t kt_v3 = 0x2f;
-    int32_t blockid = 1025;
-
-    int32_t chunkX = x/16, chunkZ = z/16, cubicy = y/16;
-
-    // construct key to get the chunk
-    if (dimId == kDimIdOverworld) {
-        //overworld
-        memcpy(&keybuf[0], &chunkX, sizeof(int32_t));
-        memcpy(&keybuf[4], &chunkZ, sizeof(int32_t));
-        memcpy(&keybuf[8], &kt_v3, sizeof(uint8_t));
-        memcpy(&keybuf[9], &cubicy, sizeof(uint8_t));
-        keybuflen = 10;
-    }
-    else {
-        // nether (and probably any others that are added)
-        memcpy(&keybuf[0], &chunkX, sizeof(int32_t));
-        memcpy(&keybuf[4], &chunkZ, sizeof(int32_t));
-        memcpy(&keybuf[8], &kw, sizeof(int32_t));
-        memcpy(&keybuf[12], &kt_v3, sizeof(uint8_t));
-        memcpy(&keybuf[13], &cubicy, sizeof(uint8_t));
-        keybuflen = 14;
-    }
-
-    leveldb::Status dstatus;
-    auto emuchunk = new int16_t[NUM_BYTES_CHUNK_V3];
-    int16_t * retPtr = nullptr;
-    std::string svalue;
-    dstatus = db->Get(levelDbReadOptions, leveldb::Slice(keybuf, keybuflen), &svalue);
-    if (dstatus.ok()) {
-        // we got a post-0.17 cubic chunk
-        const char* rchunk = svalue.data();
-
-        // determine if it is a v7 chunk and process accordingly
-        //todozooz - here is where it gets weird
-        // we have a v7 chunk - emulate v3
-        convertChunkV7toV3(rchunk, svalue.size(), emuchunk);
-
-        retPtr = emuchunk;
-    }
-
-    return retPtr;
-}
-
-int32_t DimensionData_LevelDB::generateBlockList(leveldb::DB* db, const std::string& dimName, leveldb::DB* emptyDb)
+int32_t DimensionData_LevelDB::generateBlockList(leveldb::DB* db, const std::string& dimName, leveldb::DB* emptyDb,
+    const SubChunkIndexDiff* indexDiff)
 {
+    // the world bounds cover whole chunks; the limits from the command line narrow them down
     int32_t limMinX = minChunkX*16;
-
     if (control.minX != 0x8FFFFFFF)
     {
-        if (control.minX/16 > minChunkX)
-        {
-           limMinX = control.minX;
-       }
+        limMinX = std::max(limMinX, control.minX);
     }
-
-    int32_t limMaxX = maxChunkX*16;
+    int32_t limMaxX = maxChunkX*16 + 15;
     if (control.maxX != 0x8FFFFFFF)
     {
-        if (control.maxX/16 < maxChunkX)
-        {
-            limMaxX = control.maxX;
-        }
+        limMaxX = std::min(limMaxX, control.maxX);
     }
 
     int32_t limMinZ = minChunkZ*16;
-
     if (control.minZ != 0x8FFFFFFF)
     {
-        if (control.minZ/16 > minChunkZ)
-        {
-           limMinZ = control.minZ;
-       }
+        limMinZ = std::max(limMinZ, control.minZ);
     }
-    int32_t limMaxZ = maxChunkZ*16;
+    int32_t limMaxZ = maxChunkZ*16 + 15;
     if (control.maxZ != 0x8FFFFFFF)
     {
-        if (control.maxZ/16 < maxChunkZ)
-        {
-            limMaxZ = control.maxZ;
-        }
+        limMaxZ = std::min(limMaxZ, control.maxZ);
     }
 
     int32_t limMinY = 0;
-
     if (control.minY != 0x8FFFFFFF)
     {
-        if (control.minY > 0)
-        {
-           limMinY = control.minY;
-       }
+        limMinY = std::max(limMinY, control.minY);
     }
     int32_t limMaxY = 255;
     if (control.maxY != 0x8FFFFFFF)
     {
-        if (control.maxY < 255)
-        {
-            limMaxY = control.maxY;
-        }
+        limMaxY = std::min(limMaxY, control.maxY);
     }
 
-    const int32_t chunkW = (maxChunkX - minChunkX + 1);
-    const int32_t chunkH = (maxChunkZ - minChunkZ + 1);
-    const int32_t imageW = chunkW * 16;
-    const int32_t imageH = chunkH * 16;
-
     unsigned int blockListCnt = 0;
     log::info("   World '{}' of size [X:{} => {}, Z:{} => {}]", control.dirLeveldb, 16*minChunkX, 16*maxChunkX, 16*minChunkZ, 16*maxChunkZ);
     log::info("   Scanning World within limits [X:{} => {}, Y:{} => {}, Z:{} => {}]", limMinX, limMaxX, limMinY, limMaxY, limMinZ, limMaxZ);
-    std::ofstream fd;
-    fd.open(control.dirLeveldb + "_"+ dimName+"_blocks.xyz");
     std::ofstream ld;
     ld.open(control.dirLeveldb+ "_"+ dimName+"_blocks.txt");
     ld << "WORLD NAME: '" << control.dirLeveldb << "'" << std::endl;
@@ -988,120 +895,242 @@ int32_t DimensionData_LevelDB::generateBlockList(leveldb::DB* db, const std::str
     ld << ", Z:" << limMinZ << " => " << limMaxZ << "]" << std::endl;
     ld << "WORLD BLOCKS FILTERED by name '" << control.blockFilter << "'" << std::endl;
 
-    uint64_t blockCnt[1024] = {};
-    struct Coords
-    {
-        int x, y, z;
-    };
-    std::vector<Coords> blockLists[1024];
-
-    // we operate on sets of 16 rows (which is one chunk high) of image z
-    int32_t runCt = 0;
-    uint32_t worldChunksFound = 0;
-    uint32_t emptyMatchChunks = 0;
-    for (int8_t cubicy = 0; cubicy < MAX_CUBIC_Y; cubicy++)
-    for (int32_t imageZ = 0, chunkZ = minChunkZ; imageZ < imageH; imageZ += 16, chunkZ++) {
-
-        if ((runCt++ % 20) == 0) {
-            log::info("    Row {} of {}", imageZ, imageH);
-        }
-
-        for (int32_t imageX = 0, chunkX = minChunkX; imageX < imageW; imageX += 16, chunkX++) {
-
-           const int16_t *firstBlockId = findChunk(db, (DimensionType)dimId, 16*minChunkX + imageX, 16*cubicy, 16*minChunkZ + imageZ);
-           if (firstBlockId != nullptr) {
-
-                worldChunksFound++;
-                // Check if we have a comparison (empty) world
-                const int16_t *emptyBlockId = nullptr;
-                if (emptyDb != nullptr)
-                {
-                    emptyBlockId = findChunk(emptyDb, (DimensionType)dimId, 16*minChunkX + imageX, 16*cubicy, 16*minChunkZ + imageZ);
-                    if (emptyBlockId == nullptr)
-                    {
-                        // When doing a diff, skip unless the chunk exists in both worlds
-                        delete[] firstBlockId;
-                        continue;
-                    }
-                    emptyMatchChunks++;
-                }
-
-                // the first byte is not interesting to us (it is version #?)
-                auto chunkPtr = &firstBlockId[1];
-                const int16_t* emptyChunk = nullptr;
-                if (emptyBlockId != nullptr)
-                {
-                   emptyChunk = &emptyBlockId[1];
-                }
+    // split the key range so that several threads can scan it; the parts are merged in key order,
+    // so the output does not depend on the number of threads
+    // key order is not spatial order, so the capped block lists are sorted back into blockListLess order
+    int32_t threadCount = control.threadCount;
+    if (threadCount <= 0) {
+        threadCount = std::max(1, int32_t(std::thread::hardware_concurrency()));
+    }
+    std::vector<std::string> splitKeys;
+    std::vector<std::string> chunkPrefixes;
+    const ChunkRoi roi = ChunkRoi::fromControl();
+    size_t partCount = 1;
+    if (indexDiff != nullptr) {
+        // with an index we only visit the changed subchunks, split evenly by count
+        if (threadCount > 1) {
+            partCount = std::max(size_t(1), std::min(size_t(threadCount) * 4, indexDiff->changedKeys.size()));
+        }
+    }
+    else if (roi.useSeek()) {
+        // a small region of interest is visited chunk column by chunk column
+        chunkPrefixes = roi.chunkPrefixes();
+        if (threadCount > 1) {
+            partCount = std::max(size_t(1), std::min(size_t(threadCount) * 4, chunkPrefixes.size()));
+        }
+    }
+    else if (threadCount > 1) {
+        splitKeys = splitKeyRange(db, threadCount * 4);
+        partCount = splitKeys.size() + 1;
+    }
 
-                // we step through the chunk in the natural order to speed things up
-                for (int32_t cx = 0; cx < 16; cx++) {
-                    for (int32_t cz = 0; cz < 16; cz++) {
-                        for (int32_t cy = 0; cy < 16; cy++) {
-
-                            int x = 16*minChunkX + imageX + cx;
-                            int z = 16*minChunkZ + imageZ + cz;
-                            int y = 16*cubicy + cy;
-                            uint16_t blockid = *(chunkPtr++);
-                            uint16_t emptyId = blockid+1;
-                            if (emptyChunk != nullptr)
-                            {
-                                emptyId = *(emptyChunk++);
-                            }
+    // the change heatmap is built from the same per-block reports as the block list
+    std::unique_ptr<ChangeHeatmap> heatmap;
+    if (emptyDb != nullptr && control.heatmapMode != kHeatmapModeNone) {
+        heatmap = std::make_unique<ChangeHeatmap>();
+    }
 
-                            if ( (x >= limMinX) and (x <= limMaxX) and (z >= limMinZ) and (z <= limMaxZ) and (y >= limMinY) and (y <= limMaxY))
-                            {
-                                if (blockid < 1024)
-                                {
-                                    auto block = Block::get(blockid);
-                                    if (block == nullptr) continue;
-
-                                    if (emptyId == blockid)
-                                    {
-                                        // When doing a comparison, ignore identical bocks!
-                                        continue;
-                                    }
+    // json records are streamed to a file or stdout while the parts are scanned
+    std::ofstream ndjsonFile;
+    std::unique_ptr<NdjsonStream> ndjson;
+    if (!control.fnNdjson.empty()) {
+        if (control.fnNdjson != "-") {
+            ndjsonFile.open(control.fnNdjson, std::ios::binary);
+            if (!ndjsonFile) {
+                log::error("Failed to open output file (fn={})", control.fnNdjson);
+                return -1;
+            }
+        }
+        ndjson = std::make_unique<NdjsonStream>(control.fnNdjson == "-" ? std::cout : ndjsonFile, dimName, partCount);
+    }
 
-                                    if ((control.blockFilter == "<all>") or (block->name == control.blockFilter))
-                                    {
-                                        // Ignore air blocks in output point cloud
-                                        if (blockid != 0)
-                                        {
-                                            uint32_t color = block->color();
-                                            uint8_t r = (color >> 8) & 0xFF;
-                                            uint8_t g = (color >> 16) & 0xFF;
-                                            uint8_t b = (color >> 24) & 0xFF;
-                                            fd << x << ", " << y << ", " << z << ", ";
-                                            fd << (int16_t)r << ", " << (int16_t)g << ", " << (int16_t)b << std::endl;
-                                        }
-                                        if (blockListCnt < control.blockListMax)
-                                        {
-                                            blockListCnt++;
-                                            ld << "blockid=" << std::dec << blockid  << ", name='" << block->name << "', (" << x << ", " << (int16_t)y << ", " << z << ")" << std::endl;
-                                        }
-                                    }
+    const bool entityDiff = (emptyDb != nullptr && control.entityDiff);
+    const bool changeClusters = (emptyDb != nullptr && control.changeClusters);
+
+    const std::string fnXyz = control.dirLeveldb + "_" + dimName + "_blocks.xyz";
+    const std::string fnBdiff = control.dirLeveldb + "_" + dimName + "_blocks.bdiff";
+    const BlockListLimits limits{ limMinX, limMaxX, limMinY, limMaxY, limMinZ, limMaxZ,
+        control.blockFilter == "<all>", BlockTable::findName(control.blockFilter) };
+    std::vector<std::unique_ptr<BlockListPart>> parts(partCount);
+    for (size_t i = 0; i < parts.size(); i++) {
+        parts[i] = std::make_unique<BlockListPart>();
+        if (heatmap) {
+            parts[i]->heatmap = std::make_unique<ChangeHeatmap>();
+        }
+        if (entityDiff) {
+            parts[i]->entities = std::make_unique<EntityDiff>();
+        }
+        if (changeClusters) {
+            parts[i]->clusterBuilder = std::make_unique<SubChunkClusterBuilder>();
+        }
+        if (indexDiff != nullptr) {
+            const auto& changedKeys = indexDiff->changedKeys;
+            parts[i]->keys.assign(changedKeys.begin() + changedKeys.size() * i / partCount,
+                changedKeys.begin() + changedKeys.size() * (i + 1) / partCount);
+        }
+        else if (!chunkPrefixes.empty()) {
+            parts[i]->chunkPrefixes.assign(chunkPrefixes.begin() + chunkPrefixes.size() * i / partCount,
+                chunkPrefixes.begin() + chunkPrefixes.size() * (i + 1) / partCount);
+        }
+        else {
+            parts[i]->startKey = (i == 0) ? std::string() : splitKeys[i - 1];
+            parts[i]->endKey = (i < splitKeys.size()) ? splitKeys[i] : std::string();
+        }
+        // the first part goes straight into the output file, the others are appended later
+        if (ndjson) {
+            parts[i]->ndjson = ndjson.get();
+            parts[i]->ndjsonPart = i;
+        }
+        else if (control.blockListBinary) {
+            parts[i]->bdiff.open(fnBdiff + ".part" + std::to_string(i), std::ios::binary);
+        }
+        else if (i == 0) {
+            parts[i]->xyz.open(fnXyz);
+        }
+        else {
+            parts[i]->xyz.open(fnXyz + ".part" + std::to_string(i));
+        }
+    }
+    if (indexDiff != nullptr) {
+        log::info("    Subchunk index: {} of {} shared subchunks differ", indexDiff->changedKeys.size(), indexDiff->sharedChunks);
+    }
+    log::info("    Scanning {} key ranges with {} threads", parts.size(), std::min(threadCount, int32_t(parts.size())));
+
+    std::atomic<size_t> nextPart(0);
+    std::atomic<size_t> donePartCt(0);
+    std::vector<int32_t> partStatus(parts.size(), 0);
+    auto worker = [&]() {
+        for (size_t i = nextPart++; i < parts.size(); i = nextPart++) {
+            if (indexDiff != nullptr) {
+                partStatus[i] = parts[i]->scanKeys(db, emptyDb, limits);
+            }
+            else {
+                partStatus[i] = parts[i]->scan(db, emptyDb, dimId, limits);
+            }
+            parts[i]->finishNdjson();
+            parts[i]->xyz.close();
+            parts[i]->bdiff.close();
+            size_t doneCt = ++donePartCt;
+            if ((doneCt % 16) == 0) {
+                log::info("    Range {} of {}", doneCt, parts.size());
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int32_t t = 1; t < std::min(threadCount, int32_t(parts.size())); t++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : workers) {
+        t.join();
+    }
 
-                                    blockCnt[blockid] += 1;
+    // the part files are only needed until they are merged
+    auto removePartFiles = [&]() {
+        for (size_t i = 0; i < parts.size(); i++) {
+            if (control.blockListBinary) {
+                std::remove((fnBdiff + ".part" + std::to_string(i)).c_str());
+            }
+            else if (i > 0) {
+                std::remove((fnXyz + ".part" + std::to_string(i)).c_str());
+            }
+        }
+    };
+    for (size_t i = 0; i < parts.size(); i++) {
+        if (partStatus[i] != 0) {
+            log::error("Failed to scan key range {} of {} for the block list", i + 1, parts.size());
+            removePartFiles();
+            return -1;
+        }
+    }
 
-                                    if (blockCnt[blockid] <= control.blockListRare)
-                                    {
-                                       blockLists[blockid].push_back({x, y, z});
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-                delete [] firstBlockId;
-                if (emptyBlockId != nullptr)
-                {
-                    delete [] emptyBlockId;
+    // merge the parts in key order
+    std::ofstream fd;
+    BlockDiffWriter bdiff;
+    if (control.blockListBinary) {
+        if (bdiff.open(fnBdiff, dimId) != 0) {
+            removePartFiles();
+            return -1;
+        }
+    }
+    else if (!ndjson) {
+        fd.open(fnXyz, std::ios::app);
+    }
+    uint64_t blockCnt[1024] = {};
+    std::vector<BlockListCoords> blockLists[1024];
+    BlockListStats stats;
+    std::vector<BlockListLine> listLines;
+    EntityDiff entities;
+    ChangeClusters clusters;
+    for (size_t i = 0; i < parts.size(); i++) {
+        auto& part = *parts[i];
+        if (control.blockListBinary) {
+            bdiff.appendPart(fnBdiff + ".part" + std::to_string(i), part.bdiffChunks);
+        }
+        else if (i > 0 && !ndjson) {
+            const std::string fnPart = fnXyz + ".part" + std::to_string(i);
+            std::ifstream partIn(fnPart);
+            if (partIn.peek() != std::ifstream::traits_type::eof()) {
+                fd << partIn.rdbuf();
+            }
+            partIn.close();
+        }
+        listLines.insert(listLines.end(), part.listLines.begin(), part.listLines.end());
+        for (int32_t b = 0; b < 1024; b++) {
+            blockCnt[b] += part.blockCnt[b];
+            for (const auto& v : part.blockLists[b]) {
+                if (blockLists[b].size() >= control.blockListRare) {
+                    break;
                 }
-
+                blockLists[b].push_back(v);
             }
         }
+        stats.add(part.stats);
+        if (heatmap) {
+            heatmap->merge(*part.heatmap);
+        }
+        if (entityDiff) {
+            entities.merge(*part.entities);
+        }
+        for (auto& subChunkClusters : part.clusters) {
+            clusters.add(subChunkClusters);
+        }
+        parts[i].reset();
+    }
+    removePartFiles();
+    if (control.blockListBinary && bdiff.close() != 0) {
+        return -1;
+    }
+    // each part kept its first lines, the first lines of the world are among them
+    std::sort(listLines.begin(), listLines.end());
+    for (const auto& line : listLines) {
+        if (blockListCnt >= control.blockListMax) {
+            break;
+        }
+        blockListCnt++;
+        ld << "blockid=" << line.blockId << ", name='" << BlockTable::name(BlockTable::nameIndex(BlockTable::state(line.blockId, 0)))
+           << "', (" << line.pos.x << ", " << int16_t(line.pos.y) << ", " << line.pos.z << ")" << std::endl;
+    }
+    if (indexDiff != nullptr) {
+        // subchunks that were not looked at are accounted for by the index
+        stats.worldChunksFound = indexDiff->sharedChunks + indexDiff->addedChunks;
+        stats.emptyMatchChunks = indexDiff->sharedChunks;
+        stats.addedChunks = indexDiff->addedChunks;
+        stats.removedChunks = indexDiff->removedChunks;
+        stats.sameBytesChunks += indexDiff->sameChunks;
+    }
+
+    if (emptyDb != nullptr)
+    {
+        log::info("    Subchunks: {} added, {} removed, {} shared", stats.addedChunks, stats.removedChunks, stats.emptyMatchChunks);
+        log::info("    Shared subchunks: {} identical records (not decoded), {} identical block id's (not compared), {} with different record size",
+            stats.sameBytesChunks, stats.sameBlocksChunks, stats.sizeDiffChunks);
+        log::info("    Shared subchunks: {} compared in palette space, {} unpacked", stats.paletteChunks,
+            stats.emptyMatchChunks - stats.sameBytesChunks - stats.paletteChunks);
     }
 
+    const uint32_t emptyMatchChunks = stats.emptyMatchChunks;
+    const uint32_t worldChunksFound = stats.worldChunksFound;
     if ((emptyMatchChunks != 0) and (worldChunksFound != 0))
     {
         log::info("    Found {}/{} comparison chunks", emptyMatchChunks, worldChunksFound);
@@ -1129,6 +1158,8 @@ int32_t DimensionData_LevelDB::generateBlockList(leveldb::DB* db, const std::str
         int idx = arrIdx[i];
         if (blockCnt[idx] <= control.blockListRare)
         {
+            // all of them are in the list, in the order of the parts
+            std::sort(blockLists[idx].begin(), blockLists[idx].end(), blockListLess);
             for(auto v : blockLists[idx])
             {
                 auto block = Block::get(idx);
@@ -1140,6 +1171,12 @@ int32_t DimensionData_LevelDB::generateBlockList(leveldb::DB* db, const std::str
 
     uint32_t totCnt = 0;
     for (int i=0; i<1024; i++) totCnt+=blockCnt[i];
+    if (ndjson) {
+        ndjson->writeRecord("{\"type\":\"summary\",\"dim\":\"" + dimName + "\",\"blocks\":" + std::to_string(totCnt) +
+            ",\"added_subchunks\":" + std::to_string(stats.addedChunks) +
+            ",\"removed_subchunks\":" + std::to_string(stats.removedChunks) +
+            ",\"shared_subchunks\":" + std::to_string(stats.emptyMatchChunks) + "}\n");
+    }
     ld << "WORLD BLOCKS LEGEND (TOTAL #= " << totCnt << ")" << std::endl;
     for (int i=0; i<1024; i++)
     {
@@ -1153,9 +1190,250 @@ int32_t DimensionData_LevelDB::generateBlockList(leveldb::DB* db, const std::str
     fd.close();
     ld.close();
 
+    if (changeClusters)
+    {
+        generateChangeClusters(dimName, clusters.result(), ndjson.get());
+    }
+
+    if (entityDiff)
+    {
+        entities.finish();
+        generateEntityDiff(dimName, entities, ndjson.get());
+    }
+
+    if (heatmap)
+    {
+        const std::string dirOut = (control.outputDir / "images").generic_string();
+        log::info("  Generate change heatmap");
+        generateChangeHeatmap(dirOut + "/bedrock_viz." + name + ".changes.png", *heatmap);
+    }
+
     return 0;
 }
 
+    int32_t DimensionData_LevelDB::generateChangeClusters(const std::string& dimName, const std::vector<ChangeCluster>& clusters,
+        NdjsonStream* ndjson)
+    {
+        const std::string fname = control.dirLeveldb + "_" + dimName + "_clusters.txt";
+        std::ofstream out(fname);
+        if (!out) {
+            log::error("Failed to open output file (fn={})", fname);
+            return -1;
+        }
+        log::info("    Changed blocks form {} clusters", clusters.size());
+
+        // the most common block types of a cluster
+        const size_t kTopBlocks = 3;
+        auto topBlocks = [&](const std::map<uint16_t, uint64_t>& counts) {
+            std::vector<std::pair<uint64_t, uint16_t>> sorted;
+            for (const auto& c : counts) {
+                sorted.push_back({ c.second, c.first });
+            }
+            std::stable_sort(sorted.begin(), sorted.end(), [](const std::pair<uint64_t, uint16_t>& a, const std::pair<uint64_t, uint16_t>& b) {
+                return a.first > b.first;
+            });
+            sorted.resize(std::min(sorted.size(), kTopBlocks));
+            return sorted;
+        };
+        auto blockName = [](uint16_t blockId) {
+            auto block = Block::get(blockId);
+            return block ? block->name : std::string("unknown");
+        };
+
+        out << "WORLD NAME: '" << control.dirLeveldb << "'\n";
+        out << "COMPARISON WORLD (EMPTY): '" << control.emptyDbName << "'\n";
+        out << "CHANGE CLUSTERS: " << clusters.size() << " (largest first)\n";
+        for (size_t i = 0; i < clusters.size(); i++) {
+            const auto& c = clusters[i];
+            out << "cluster " << i << ": blocks=" << c.blockCount << ", box=(" << c.minX << ", " << c.minY << ", " << c.minZ
+                << ") - (" << c.maxX << ", " << c.maxY << ", " << c.maxZ << "), now:";
+            for (const auto& b : topBlocks(c.newBlocks)) {
+                out << " '" << blockName(b.second) << "' x " << b.first;
+            }
+            out << ", was:";
+            for (const auto& b : topBlocks(c.oldBlocks)) {
+                out << " '" << blockName(b.second) << "' x " << b.first;
+            }
+            out << "\n";
+
+            if (ndjson != nullptr) {
+                auto jsonBlocks = [&](const std::map<uint16_t, uint64_t>& counts) {
+                    std::string list;
+                    for (const auto& b : topBlocks(counts)) {
+                        list += std::string(list.empty() ? "" : ",") + "{\"id\":" + std::to_string(b.second) + ",\"name\":\"" +
+                            escapeString(blockName(b.second), "\"\\") + "\",\"count\":" + std::to_string(b.first) + "}";
+                    }
+                    return "[" + list + "]";
+                };
+                ndjson->writeRecord("{\"type\":\"cluster\",\"dim\":\"" + dimName + "\",\"blocks\":" + std::to_string(c.blockCount) +
+                    ",\"min\":[" + std::to_string(c.minX) + "," + std::to_string(c.minY) + "," + std::to_string(c.minZ) +
+                    "],\"max\":[" + std::to_string(c.maxX) + "," + std::to_string(c.maxY) + "," + std::to_string(c.maxZ) +
+                    "],\"now\":" + jsonBlocks(c.newBlocks) + ",\"was\":" + jsonBlocks(c.oldBlocks) + "}\n");
+            }
+        }
+        out.close();
+        return 0;
+    }
+
+    int32_t DimensionData_LevelDB::generateEntityDiff(const std::string& dimName, const EntityDiff& entities,
+        NdjsonStream* ndjson)
+    {
+        const std::string fname = control.dirLeveldb + "_" + dimName + "_entities.txt";
+        std::ofstream out(fname);
+        if (!out) {
+            log::error("Failed to open output file (fn={})", fname);
+            return -1;
+        }
+
+        // positions are written as [x, y, z]
+        auto jsonPosition = [](const EntityInfo& e) {
+            std::string pos = e.positionString();
+            return "[" + pos.substr(1, pos.size() - 2) + "]";
+        };
+
+        uint32_t counts[4] = {};
+        for (const auto& change : entities.changes) {
+            counts[change.type]++;
+        }
+        log::info("    Entities: {} added, {} removed, {} moved, {} modified", counts[kEntityAdded], counts[kEntityRemoved],
+            counts[kEntityMoved], counts[kEntityModified]);
+
+        out << "WORLD NAME: '" << control.dirLeveldb << "'\n";
+        out << "COMPARISON WORLD (EMPTY): '" << control.emptyDbName << "'\n";
+        out << "ENTITY CHANGES: " << counts[kEntityAdded] << " added, " << counts[kEntityRemoved] << " removed, "
+            << counts[kEntityMoved] << " moved, " << counts[kEntityModified] << " modified\n";
+        for (const auto& change : entities.changes) {
+            // removed entities only exist in the comparison world
+            const EntityInfo& e = (change.type == kEntityRemoved) ? change.other : change.info;
+            std::string line = std::string(entityChangeName(change.type)) + (e.blockEntity ? " block entity '" : " entity '") +
+                e.id + "'";
+            if (!e.blockEntity) {
+                line += " uid=" + std::to_string(e.uniqueId);
+            }
+            if (change.type == kEntityMoved || (change.type == kEntityModified && !change.info.samePosition(change.other))) {
+                line += " from " + change.other.positionString() + " to " + change.info.positionString();
+            }
+            else {
+                line += " at " + e.positionString();
+            }
+            out << line << "\n";
+
+            if (ndjson != nullptr) {
+                std::string record = "{\"type\":\"" + std::string(e.blockEntity ? "block_entity" : "entity") +
+                    "\",\"dim\":\"" + dimName + "\",\"change\":\"" + entityChangeName(change.type) +
+                    "\",\"id\":\"" + escapeString(e.id, "\"\\") + "\"";
+                if (!e.blockEntity) {
+                    record += ",\"uid\":" + std::to_string(e.uniqueId);
+                }
+                record += ",\"pos\":" + jsonPosition(e);
+                if (change.type == kEntityMoved || change.type == kEntityModified) {
+                    record += ",\"old_pos\":" + jsonPosition(change.other);
+                }
+                record += "}\n";
+                ndjson->writeRecord(record);
+            }
+        }
+        out.close();
+        return 0;
+    }
+
+    int32_t DimensionData_LevelDB::generateChangeHeatmap(const std::string& fname, const ChangeHeatmap& heatmap)
+    {
+        // the scale divides 16, so a pixel never covers more than one chunk
+        const int32_t scale = control.heatmapScale;
+        const int32_t pixelsPerChunk = 16 / scale;
+        const int32_t chunkW = (maxChunkX - minChunkX + 1);
+        const int32_t chunkH = (maxChunkZ - minChunkZ + 1);
+        const int32_t imageW = chunkW * pixelsPerChunk;
+        const int32_t imageH = chunkH * pixelsPerChunk;
+        const int32_t bpp = 4;
+
+        // sum up the columns of each pixel; counts are colored on a log scale up to the busiest pixel
+        auto chunkPixels = [&](const std::array<ChangeColumn, 256>& columns, std::vector<ChangeColumn>& pixels) {
+            pixels.assign(pixelsPerChunk * pixelsPerChunk, ChangeColumn());
+            for (int32_t cx = 0; cx < 16; cx++) {
+                for (int32_t cz = 0; cz < 16; cz++) {
+                    const auto& column = columns[(cx << 4) | cz];
+                    auto& pixel = pixels[(cz / scale) * pixelsPerChunk + (cx / scale)];
+                    pixel.count += column.count;
+                    pixel.maxY = std::max(pixel.maxY, column.maxY);
+                }
+            }
+        };
+        std::vector<ChangeColumn> pixels;
+        uint32_t maxCount = 1;
+        for (const auto& chunk : heatmap.chunks) {
+            chunkPixels(chunk.second, pixels);
+            for (const auto& pixel : pixels) {
+                maxCount = std::max(maxCount, pixel.count);
+            }
+        }
+
+        // blue (few changes) to red (many changes)
+        int32_t countPalette[256];
+        makeHslRamp(countPalette, 0, 255, 0.66, 0.0, 0.9, 0.9, 0.5, 0.5);
+        for (int32_t i = 0; i < 256; i++) {
+            countPalette[i] = local_htobe32(countPalette[i]);
+        }
+
+        uint8_t* buf = new uint8_t[size_t(imageW) * pixelsPerChunk * bpp];
+        std::vector<uint8_t*> rows(pixelsPerChunk);
+        for (int32_t i = 0; i < pixelsPerChunk; i++) {
+            rows[i] = &buf[size_t(i) * imageW * bpp];
+        }
+
+        PngWriter png;
+        if (outputPNG_init(png, fname, "MCPE Viz Image -- World=(" + worldName + ") Dimension=(" + name + ") Image=(Change Heatmap)",
+            imageW, imageH, true) != 0) {
+            delete[] buf;
+            return -1;
+        }
+
+        // chunks are sorted by (chunkZ, chunkX), so we can write one row of chunks at a time
+        auto it = heatmap.chunks.begin();
+        for (int32_t chunkZ = minChunkZ; chunkZ <= maxChunkZ; chunkZ++) {
+            memset(buf, 0, size_t(imageW) * pixelsPerChunk * bpp);
+            for (; it != heatmap.chunks.end() && it->first.first <= chunkZ; ++it) {
+                if (it->first.first < chunkZ) {
+                    continue;
+                }
+                double ix, iy;
+                worldPointToImagePoint(it->first.second * 16, chunkZ * 16, ix, iy, false);
+                const int32_t imageX = int32_t(ix) / scale;
+                if (imageX < 0 || imageX + pixelsPerChunk > imageW) {
+                    continue;
+                }
+
+                chunkPixels(it->second, pixels);
+                for (int32_t pz = 0; pz < pixelsPerChunk; pz++) {
+                    for (int32_t px = 0; px < pixelsPerChunk; px++) {
+                        const auto& pixel = pixels[pz * pixelsPerChunk + px];
+                        if (pixel.count == 0) {
+                            continue;
+                        }
+                        int32_t color;
+                        if (control.heatmapMode == kHeatmapModeMaxY) {
+                            color = get_palette().value[_clamp(pixel.maxY, 0, 255)];
+                        }
+                        else {
+                            const double level = std::log(1.0 + pixel.count) / std::log(1.0 + maxCount);
+                            color = countPalette[_clamp(int32_t(level * 255.0), 0, 255)];
+                        }
+                        // palette colors are stored as big endian 0x00rrggbb
+                        uint8_t* p = &buf[(size_t(pz) * imageW + imageX + px) * bpp];
+                        memcpy(p, &((const char*)&color)[1], 3);
+                        p[3] = 0xff;
+                    }
+                }
+            }
+            outputPNG_writeRows(png, rows.data(), pixelsPerChunk);
+        }
+
+        outputPNG_close(png);
+        delete[] buf;
+        return 0;
+    }
+
     int32_t DimensionData_LevelDB::doOutput_Schematic(leveldb::DB* db)
     {
         for (const auto& schematic : listSchematic) {
@@ -1263,7 +1541,7 @@ int32_t DimensionData_LevelDB::generateBlockList(leveldb::DB* db, const std::str
         return 0;
     }
 
-    int32_t DimensionData_LevelDB::doOutput(leveldb::DB* db, leveldb::DB* emptyWorld)
+    int32_t DimensionData_LevelDB::doOutput(leveldb::DB* db, leveldb::DB* emptyWorld, const SubChunkIndexDiff* indexDiff)
     {
         log::info("Do Output: {}", name);
 
@@ -1280,16 +1558,11 @@ int32_t DimensionData_LevelDB::generateBlockList(leveldb::DB* db, const std::str
         {
 
             log::info("  Generate block list");
-            generateBlockList(db, name, emptyWorld);
+            generateBlockList(db, name, emptyWorld, indexDiff);
         }
 
         //doOutput_Schematic(db);
 
-        // reset
-        for(auto& i: Block::list()) {
-            i->color_set_need_count = 0;
-        }
-
         return 0;
     }
 
@@ -0,0 +1,273 @@
+#include "world/entity_diff.h"
+#include "world/palette.h"
+#include "utils/hash.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+
+namespace
+{
+    bool tagNameIs(const char* name, uint16_t len, const char* s)
+    {
+        return len == strlen(s) && memcmp(name, s, len) == 0;
+    }
+
+    // parse one entity compound starting at p; returns the end of it or nullptr
+    const char* parseEntity(const char* p, const char* end, bool blockEntity, mcpe_viz::EntityInfo& out)
+    {
+        uint16_t len;
+        if (end - p < 3 || p[0] != 10) {
+            return nullptr;
+        }
+        memcpy(&len, p + 1, sizeof(uint16_t));
+        p += 3;
+        if (end - p < len) {
+            return nullptr;
+        }
+        p += len;
+
+        out = mcpe_viz::EntityInfo();
+        out.blockEntity = blockEntity;
+        bool haveUniqueId = false;
+        uint64_t h = 0;
+        while (p < end) {
+            const char* tag = p;
+            const int32_t tagType = uint8_t(*p++);
+            if (tagType == 0) {
+                out.hash = h;
+                // entities without an id are matched by their contents
+                if (!blockEntity && !haveUniqueId) {
+                    out.uniqueId = int64_t(h);
+                }
+                return p;
+            }
+            if (end - p < 2) {
+                return nullptr;
+            }
+            memcpy(&len, p, sizeof(uint16_t));
+            p += 2;
+            if (end - p < len) {
+                return nullptr;
+            }
+            const char* name = p;
+            p += len;
+            const char* payload = p;
+            p = mcpe_viz::skipNbtPayload(tagType, p, end, 1);
+            if (p == nullptr) {
+                return nullptr;
+            }
+
+            if (tagType == 8 && (tagNameIs(name, len, blockEntity ? "id" : "identifier"))) {
+                uint16_t slen;
+                memcpy(&slen, payload, sizeof(uint16_t));
+                out.id.assign(payload + 2, slen);
+            }
+            if (blockEntity) {
+                if (tagType == 3 && len == 1) {
+                    int32_t v;
+                    memcpy(&v, payload, sizeof(int32_t));
+                    if (name[0] == 'x') { out.x = v; }
+                    else if (name[0] == 'y') { out.y = v; }
+                    else if (name[0] == 'z') { out.z = v; }
+                }
+            }
+            else {
+                if (tagType == 4 && tagNameIs(name, len, "UniqueID")) {
+                    memcpy(&out.uniqueId, payload, sizeof(int64_t));
+                    haveUniqueId = true;
+                }
+                // list of 3 floats
+                if (tagType == 9 && tagNameIs(name, len, "Pos") && p - payload == 5 + 12 && payload[0] == 5) {
+                    memcpy(out.pos, payload + 5, sizeof(out.pos));
+                }
+                // an entity that only moved keeps its hash
+                if (tagNameIs(name, len, "Pos") || tagNameIs(name, len, "Rotation") || tagNameIs(name, len, "Motion")) {
+                    continue;
+                }
+            }
+            h = mcpe_viz::hashCombine(h, mcpe_viz::hash64(tag, size_t(p - tag)));
+        }
+        return nullptr;
+    }
+
+    // block entities are matched by position, entities by UniqueID
+    std::tuple<int64_t, int32_t, int32_t, int32_t> entityKey(const mcpe_viz::EntityInfo& e)
+    {
+        if (e.blockEntity) {
+            return std::make_tuple(int64_t(0), e.x, e.y, e.z);
+        }
+        return std::make_tuple(e.uniqueId, 0, 0, 0);
+    }
+}
+
+namespace mcpe_viz {
+
+    bool EntityInfo::samePosition(const EntityInfo& other) const
+    {
+        if (blockEntity) {
+            return x == other.x && y == other.y && z == other.z;
+        }
+        return memcmp(pos, other.pos, sizeof(pos)) == 0;
+    }
+
+    std::string EntityInfo::positionString() const
+    {
+        if (blockEntity) {
+            return "(" + std::to_string(x) + ", " + std::to_string(y) + ", " + std::to_string(z) + ")";
+        }
+        char buf[128];
+        snprintf(buf, sizeof(buf), "(%g, %g, %g)", pos[0], pos[1], pos[2]);
+        return buf;
+    }
+
+    const char* entityChangeName(EntityChangeType type)
+    {
+        switch (type) {
+        case kEntityAdded:
+            return "added";
+        case kEntityRemoved:
+            return "removed";
+        case kEntityMoved:
+            return "moved";
+        case kEntityModified:
+            return "modified";
+        }
+        return "";
+    }
+
+    int32_t parseEntityRecord(const char* data, size_t size, bool blockEntities, std::vector<EntityInfo>& out)
+    {
+        out.clear();
+        const char* p = data;
+        const char* end = data + size;
+        while (p < end) {
+            out.emplace_back();
+            p = parseEntity(p, end, blockEntities, out.back());
+            if (p == nullptr) {
+                out.pop_back();
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    void EntityDiff::compareEntity(const EntityInfo& a, const EntityInfo& b)
+    {
+        if (a.hash != b.hash) {
+            changes.push_back({ kEntityModified, a, b });
+        }
+        else if (!a.samePosition(b)) {
+            changes.push_back({ kEntityMoved, a, b });
+        }
+    }
+
+    void EntityDiff::compareRecords(const leveldb::Slice* valueA, const leveldb::Slice* valueB, bool blockEntities)
+    {
+        entitiesA.clear();
+        entitiesB.clear();
+        if (valueA != nullptr && parseEntityRecord(valueA->data(), valueA->size(), blockEntities, entitiesA) != 0) {
+            log::warn("Damaged {} record in the world", blockEntities ? "block entity" : "entity");
+        }
+        if (valueB != nullptr && parseEntityRecord(valueB->data(), valueB->size(), blockEntities, entitiesB) != 0) {
+            log::warn("Damaged {} record in the comparison world", blockEntities ? "block entity" : "entity");
+        }
+
+        std::map<std::tuple<int64_t, int32_t, int32_t, int32_t>, size_t> keysB;
+        for (size_t i = 0; i < entitiesB.size(); i++) {
+            keysB.emplace(entityKey(entitiesB[i]), i);
+        }
+        std::vector<bool> matchedB(entitiesB.size(), false);
+
+        for (const auto& a : entitiesA) {
+            auto it = keysB.find(entityKey(a));
+            if (it != keysB.end() && !matchedB[it->second]) {
+                matchedB[it->second] = true;
+                compareEntity(a, entitiesB[it->second]);
+            }
+            else if (a.blockEntity) {
+                changes.push_back({ kEntityAdded, a, EntityInfo() });
+            }
+            else {
+                // the entity may have come from a chunk we have already seen
+                auto other = onlyB.find(a.uniqueId);
+                if (other != onlyB.end()) {
+                    compareEntity(a, other->second);
+                    onlyB.erase(other);
+                }
+                else {
+                    onlyA[a.uniqueId] = a;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < entitiesB.size(); i++) {
+            if (matchedB[i]) {
+                continue;
+            }
+            const auto& b = entitiesB[i];
+            if (b.blockEntity) {
+                changes.push_back({ kEntityRemoved, EntityInfo(), b });
+                continue;
+            }
+            auto other = onlyA.find(b.uniqueId);
+            if (other != onlyA.end()) {
+                compareEntity(other->second, b);
+                onlyA.erase(other);
+            }
+            else {
+                onlyB[b.uniqueId] = b;
+            }
+        }
+    }
+
+    void EntityDiff::merge(EntityDiff& other)
+    {
+        changes.insert(changes.end(), other.changes.begin(), other.changes.end());
+        for (const auto& a : other.onlyA) {
+            auto it = onlyB.find(a.first);
+            if (it != onlyB.end()) {
+                compareEntity(a.second, it->second);
+                onlyB.erase(it);
+            }
+            else {
+                onlyA.insert(a);
+            }
+        }
+        for (const auto& b : other.onlyB) {
+            auto it = onlyA.find(b.first);
+            if (it != onlyA.end()) {
+                compareEntity(it->second, b.second);
+                onlyA.erase(it);
+            }
+            else {
+                onlyB.insert(b);
+            }
+        }
+        other.changes.clear();
+        other.onlyA.clear();
+        other.onlyB.clear();
+    }
+
+    void EntityDiff::finish()
+    {
+        for (const auto& a : onlyA) {
+            changes.push_back({ kEntityAdded, a.second, EntityInfo() });
+        }
+        for (const auto& b : onlyB) {
+            changes.push_back({ kEntityRemoved, EntityInfo(), b.second });
+        }
+        onlyA.clear();
+        onlyB.clear();
+
+        // the order must not depend on how the world was split up between threads
+        auto sortKey = [](const EntityChange& c) {
+            const EntityInfo& e = (c.type == kEntityRemoved) ? c.other : c.info;
+            return std::make_tuple(e.blockEntity, entityKey(e), int32_t(c.type));
+        };
+        std::sort(changes.begin(), changes.end(), [&](const EntityChange& l, const EntityChange& r) {
+            return sortKey(l) < sortKey(r);
+        });
+    }
+}
@@ -5,7 +5,35 @@
 #include "logger.h"
 #include "utils/unknown_recorder.h"
 #include "minecraft/v2/block.h"
-
+#include "world/palette.h"
+#include "world/palette_unpack.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define MCPE_VIZ_NIBBLES_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define MCPE_VIZ_NIBBLES_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    // block id's and then the nibble arrays of a record starting at start
+    void decodeLegacyArrays(const char* cdata, size_t cdata_size, size_t start, mcpe_viz::LegacyTerrain& out)
+    {
+        const size_t blockCount = size_t(out.blockCount);
+        size_t have = (cdata_size > start) ? std::min(blockCount, cdata_size - start) : 0;
+        memcpy(out.blockId, &cdata[start], have);
+        memset(&out.blockId[have], 0, blockCount - have);
+
+        const size_t nibbleStart = start + blockCount;
+        have = (cdata_size > nibbleStart) ? std::min(blockCount * 3 / 2, cdata_size - nibbleStart) : 0;
+        mcpe_viz::expandNibbles(&cdata[nibbleStart], have, out.nibbles);
+        memset(&out.nibbles[have * 2], 0, blockCount * 3 + 1 - have * 2);
+    }
+}
 
 namespace mcpe_viz {
 
@@ -240,6 +268,48 @@ namespace mcpe_viz {
         return p[_calcOffsetBlock_LevelDB_v3_fullchunk(x, z, y)];
     }
 
+    void expandNibbles(const char* packed, size_t count, uint8_t* out) {
+        size_t i = 0;
+#if defined(MCPE_VIZ_NIBBLES_SSE2)
+        // 16 bytes at a time: mask the low nibbles, shift down the high ones and interleave them
+        const __m128i mask = _mm_set1_epi8(0x0f);
+        for (; i + 16 <= count; i += 16) {
+            const __m128i v = _mm_loadu_si128((const __m128i*)&packed[i]);
+            const __m128i lo = _mm_and_si128(v, mask);
+            const __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+            _mm_storeu_si128((__m128i*)&out[i * 2], _mm_unpacklo_epi8(lo, hi));
+            _mm_storeu_si128((__m128i*)&out[i * 2 + 16], _mm_unpackhi_epi8(lo, hi));
+        }
+#elif defined(MCPE_VIZ_NIBBLES_NEON)
+        const uint8x16_t mask = vdupq_n_u8(0x0f);
+        for (; i + 16 <= count; i += 16) {
+            const uint8x16_t v = vld1q_u8((const uint8_t*)&packed[i]);
+            uint8x16x2_t both;
+            both.val[0] = vandq_u8(v, mask);
+            both.val[1] = vshrq_n_u8(v, 4);
+            vst2q_u8(&out[i * 2], both);
+        }
+#endif
+        for (; i < count; i++) {
+            const uint8_t v = uint8_t(packed[i]);
+            out[i * 2] = v & 0x0f;
+            out[i * 2 + 1] = v >> 4;
+        }
+    }
+
+    void decodeLegacyTerrain_LevelDB_v2(const char* cdata, size_t cdata_size, LegacyTerrain& out) {
+        out.height = MAX_BLOCK_HEIGHT_127 + 1;
+        out.blockCount = 16 * 16 * out.height;
+        decodeLegacyArrays(cdata, cdata_size, 0, out);
+    }
+
+    void decodeLegacyTerrain_LevelDB_v3(const char* cdata, size_t cdata_size, LegacyTerrain& out) {
+        // the first byte is the version
+        out.height = 16;
+        out.blockCount = 16 * 16 * out.height;
+        decodeLegacyArrays(cdata, cdata_size, 1, out);
+    }
+
 
 
 
@@ -332,72 +402,42 @@ namespace mcpe_viz {
         }
 
         // read chunk palette and associate old-school block id's
-        MyNbtTagList tagList;
-        int xoff = offsetBlockInfoList + 6 + extraOffset;
-        parseNbtQuiet(&cdata[xoff], int32_t(cdata_size) - xoff, cdata[offsetBlockInfoList + 3], tagList);
-
-        std::vector<int32_t> chunkBlockPalette_BlockId(tagList.size());
-        std::vector<int32_t> chunkBlockPalette_BlockData(tagList.size());
-
-        for (size_t i = 0; i < tagList.size(); i++) {
-            // check tagList
-            if (tagList[i].second->get_type() == nbt::tag_type::Compound) {
-                nbt::tag_compound tc = tagList[i].second->as<nbt::tag_compound>();
-
-                bool processedFlag = false;
-                if (tc.has_key("name", nbt::tag_type::String)) {
-                    std::string bname = tc["name"].as<nbt::tag_string>().get();
-                    int bdata = 0;
-                    if (tc.has_key("val", nbt::tag_type::Short)) {
-                        bdata = tc["val"].as<nbt::tag_short>().get();
-                    }
-                    auto block = Block::getByUname(bname);
-                    if (block != nullptr) {
-                        chunkBlockPalette_BlockId[i] = block->id;
-                        // todonow - correct?
-                        chunkBlockPalette_BlockData[i] = bdata;
-                    }
-                    else {
-                        record_unknow_uname(bname);
-                        // todonow - reasonable?
-                        chunkBlockPalette_BlockId[i] = 0;
-                        chunkBlockPalette_BlockData[i] = 0;
-                    }
-                    processedFlag = true;
-                }
-                if (!processedFlag) {
-                    log::warn("(Safe) Did not find 'name' tag in a chunk palette! (i={}) (len={})",
-                        i, tagList.size());
-                    
-                    //todozooz - dump tc to screen log
-                }
-            }
-            else {
-                log::warn("Unexpected NBT format in _do_chunk_v7");
-            }
+        static thread_local PaletteBlockCache paletteCache;
+        const int32_t paletteOffset = offsetBlockInfoList + 2 + extraOffset;
+        const std::vector<PaletteBlock>* palette = nullptr;
+        if (int64_t(cdata_size) > paletteOffset) {
+            palette = paletteCache.resolve(&cdata[paletteOffset], cdata + cdata_size);
         }
+        if (palette == nullptr) {
+            log::warn("Bad chunk palette in convertChunkV7toV3");
+            return -1;
+        }
+
+        // expand all palette indices at once
+        uint16_t paletteIndices[16 * 16 * 16];
+        unpackPaletteIndices(&cdata[2 + extraOffset], bitsPerBlock, paletteIndices);
 
         //todozooz -- new 16-bit block-id's (instead of 8-bit) are a BIG issue - this needs attention here
         // iterate over chunk space
-        uint8_t paletteBlockId, blockData;
+        uint16_t paletteBlockId;
+        uint8_t blockData;
         int32_t blockId;
         for (int32_t cy = 0; cy < 16; cy++) {
             for (int32_t cx = 0; cx < 16; cx++) {
                 for (int32_t cz = 0; cz < 16; cz++) {
-                    paletteBlockId = getBlockId_LevelDB_v7(&cdata[2 + extraOffset], blocksPerWord, bitsPerBlock, cx, cz,
-                        cy);
+                    paletteBlockId = paletteIndices[(((cx * 16) + cz) * 16) + cy];
 
                     // look up blockId
                     //todonow error checking
-                    if (paletteBlockId < chunkBlockPalette_BlockId.size()) {
-                        blockId = chunkBlockPalette_BlockId[paletteBlockId];
-                        blockData = chunkBlockPalette_BlockData[paletteBlockId];
+                    if (paletteBlockId < palette->size()) {
+                        blockId = (*palette)[paletteBlockId].blockId;
+                        blockData = uint8_t((*palette)[paletteBlockId].blockData);
                     }
                     else {
                         blockId = 0;
                         blockData = 0;
                         log::warn("Found chunk palette id out of range {} (size={})", 
-                            paletteBlockId, chunkBlockPalette_BlockId.size());
+                            paletteBlockId, palette->size());
                     }
 
                     int32_t bdoff = _calcOffsetBlock_LevelDB_v3(cx, cz, cy);
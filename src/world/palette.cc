@@ -0,0 +1,532 @@
+#include "world/palette.h"
+#include "world/palette_unpack.h"
+#include "logger.h"
+#include "utils/hash.h"
+#include "utils/unknown_recorder.h"
+#include "minecraft/v2/block.h"
+#include "minecraft/v2/block_table.h"
+
+#include <algorithm>
+
+namespace
+{
+    const int32_t kBlocksPerSubChunk = 16 * 16 * 16;
+    const int32_t kMaxNbtDepth = 512;
+    // drop all cached palettes once their bytes take more than this
+    const size_t kMaxPaletteCacheBytes = 16 * 1024 * 1024;
+
+    bool readInt32(const char*& p, const char* end, int32_t& v)
+    {
+        if (end - p < 4) {
+            return false;
+        }
+        memcpy(&v, p, sizeof(int32_t));
+        p += 4;
+        return true;
+    }
+
+    bool readUInt16(const char*& p, const char* end, uint16_t& v)
+    {
+        if (end - p < 2) {
+            return false;
+        }
+        memcpy(&v, p, sizeof(uint16_t));
+        p += 2;
+        return true;
+    }
+
+    // parse one palette entry (a named root compound) and pick out the block name
+    const char* parsePaletteEntry(const char* p, const char* end, mcpe_viz::PaletteEntry& entry)
+    {
+        entry.nbt = p;
+        entry.name = nullptr;
+        entry.nameSize = 0;
+        entry.version = nullptr;
+        entry.versionSize = 0;
+        entry.val = 0;
+
+        if (end - p < 1 || p[0] != 10) {
+            return nullptr;
+        }
+        p++;
+        uint16_t len;
+        if (!readUInt16(p, end, len) || end - p < len) {
+            return nullptr;
+        }
+        p += len;
+
+        while (p < end) {
+            const char* tag = p;
+            const int32_t tagType = uint8_t(*p++);
+            if (tagType == 0) {
+                entry.nbtSize = size_t(p - entry.nbt);
+                return p;
+            }
+            if (!readUInt16(p, end, len) || end - p < len) {
+                return nullptr;
+            }
+            const char* tagName = p;
+            p += len;
+
+            if (tagType == 8 && len == 4 && memcmp(tagName, "name", 4) == 0) {
+                uint16_t slen;
+                if (!readUInt16(p, end, slen) || end - p < slen) {
+                    return nullptr;
+                }
+                entry.name = p;
+                entry.nameSize = slen;
+                p += slen;
+            }
+            else {
+                p = mcpe_viz::skipNbtPayload(tagType, p, end, 1);
+                if (p == nullptr) {
+                    return nullptr;
+                }
+                if (len == 7 && memcmp(tagName, "version", 7) == 0) {
+                    entry.version = tag;
+                    entry.versionSize = size_t(p - tag);
+                }
+                else if (tagType == 2 && len == 3 && memcmp(tagName, "val", 3) == 0) {
+                    int16_t val;
+                    memcpy(&val, p - 2, sizeof(int16_t));
+                    entry.val = val;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    // walk past one palette entry (a named root compound) without picking out its tags
+    const char* skipPaletteEntry(const char* p, const char* end)
+    {
+        if (end - p < 1 || p[0] != 10) {
+            return nullptr;
+        }
+        p++;
+        uint16_t len;
+        if (!readUInt16(p, end, len) || end - p < len) {
+            return nullptr;
+        }
+        return mcpe_viz::skipNbtPayload(10, p + len, end, 1);
+    }
+
+    // parse one block storage starting at p; returns the end of it or nullptr
+    const char* parseStorage(const char* p, const char* end, mcpe_viz::PaletteStorage& out)
+    {
+        if (end - p < 1) {
+            return nullptr;
+        }
+        const int32_t flags = uint8_t(*p++);
+        // low bit marks runtime (network) palettes, which never show up on disk
+        if (flags & 0x01) {
+            return nullptr;
+        }
+        out.bitsPerBlock = flags >> 1;
+        switch (out.bitsPerBlock) {
+        case 1:
+        case 2:
+        case 3:
+        case 4:
+        case 5:
+        case 6:
+        case 8:
+        case 16:
+            break;
+        default:
+            return nullptr;
+        }
+        out.blocksPerWord = 32 / out.bitsPerBlock;
+        out.wordCount = (kBlocksPerSubChunk + out.blocksPerWord - 1) / out.blocksPerWord;
+        if (end - p < int64_t(out.wordCount) * 4) {
+            return nullptr;
+        }
+        out.words = p;
+        p += out.wordCount * 4;
+
+        int32_t paletteSize;
+        if (!readInt32(p, end, paletteSize) || paletteSize < 0 || paletteSize > kBlocksPerSubChunk) {
+            return nullptr;
+        }
+        out.palette.resize(paletteSize);
+        for (int32_t i = 0; i < paletteSize; i++) {
+            p = parsePaletteEntry(p, end, out.palette[i]);
+            if (p == nullptr) {
+                return nullptr;
+            }
+        }
+        return p;
+    }
+
+    // number of block storages in a record and where the first one starts; -1 if it is not paletted
+    int32_t storageCount(const char* cdata, size_t cdata_size, const char*& first)
+    {
+        if (cdata_size < 3) {
+            return -1;
+        }
+        if (cdata[0] == 0x01) {
+            first = cdata + 1;
+            return 1;
+        }
+        if (cdata[0] == 0x08) {
+            if (cdata[1] < 1) {
+                return -1;
+            }
+            first = cdata + 2;
+            return cdata[1];
+        }
+        return -1;
+    }
+
+    // map each palette entry to a block id (this is what the v3 emulation buffer holds)
+    void mapPaletteToBlockIds(const mcpe_viz::PaletteStorage& storage, std::vector<int32_t>& blockIds)
+    {
+        blockIds.resize(storage.palette.size());
+        for (size_t i = 0; i < storage.palette.size(); i++) {
+            const auto& entry = storage.palette[i];
+            blockIds[i] = 0;
+            if (entry.name == nullptr) {
+                continue;
+            }
+            std::string bname(entry.name, entry.nameSize);
+            auto block = mcpe_viz::Block::getByUname(bname);
+            if (block != nullptr) {
+                blockIds[i] = block->id;
+            }
+            else {
+                mcpe_viz::record_unknow_uname(bname);
+            }
+        }
+    }
+
+    inline int32_t lookupBlockId(const std::vector<int32_t>& blockIds, int32_t paletteIdx)
+    {
+        if (size_t(paletteIdx) < blockIds.size()) {
+            return blockIds[paletteIdx];
+        }
+        return 0;
+    }
+}
+
+namespace mcpe_viz {
+
+    const char* skipNbtPayload(int32_t tagType, const char* p, const char* end, int32_t depth)
+    {
+        if (depth > kMaxNbtDepth) {
+            return nullptr;
+        }
+
+        int32_t count;
+        uint16_t len;
+        switch (tagType) {
+        case 1:
+            return (end - p >= 1) ? p + 1 : nullptr;
+        case 2:
+            return (end - p >= 2) ? p + 2 : nullptr;
+        case 3:
+        case 5:
+            return (end - p >= 4) ? p + 4 : nullptr;
+        case 4:
+        case 6:
+            return (end - p >= 8) ? p + 8 : nullptr;
+        case 7:
+        case 11:
+        case 12: {
+            if (!readInt32(p, end, count) || count < 0) {
+                return nullptr;
+            }
+            const int64_t elemSize = (tagType == 7) ? 1 : ((tagType == 11) ? 4 : 8);
+            if ((end - p) < int64_t(count) * elemSize) {
+                return nullptr;
+            }
+            return p + int64_t(count) * elemSize;
+        }
+        case 8:
+            if (!readUInt16(p, end, len) || end - p < len) {
+                return nullptr;
+            }
+            return p + len;
+        case 9: {
+            if (end - p < 1) {
+                return nullptr;
+            }
+            const int32_t elemType = uint8_t(*p++);
+            if (!readInt32(p, end, count) || count < 0) {
+                return nullptr;
+            }
+            for (int32_t i = 0; i < count && p != nullptr; i++) {
+                p = skipNbtPayload(elemType, p, end, depth + 1);
+            }
+            return p;
+        }
+        case 10:
+            while (p < end) {
+                const int32_t childType = uint8_t(*p++);
+                if (childType == 0) {
+                    return p;
+                }
+                if (!readUInt16(p, end, len) || end - p < len) {
+                    return nullptr;
+                }
+                p = skipNbtPayload(childType, p + len, end, depth + 1);
+                if (p == nullptr) {
+                    return nullptr;
+                }
+            }
+            return nullptr;
+        default:
+            return nullptr;
+        }
+    }
+
+    int32_t parsePaletteStorage(const char* cdata, size_t cdata_size, PaletteStorage& out)
+    {
+        const char* p;
+        if (storageCount(cdata, cdata_size, p) < 1) {
+            return -1;
+        }
+        return parseStorage(p, cdata + cdata_size, out) != nullptr ? 0 : -1;
+    }
+
+    int32_t parsePaletteStorages(const char* cdata, size_t cdata_size, std::vector<PaletteStorage>& out)
+    {
+        const char* p;
+        const int32_t count = storageCount(cdata, cdata_size, p);
+        if (count < 1) {
+            return -1;
+        }
+        out.resize(count);
+        for (int32_t i = 0; i < count; i++) {
+            p = parseStorage(p, cdata + cdata_size, out[i]);
+            if (p == nullptr) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    BlockStateIndex::BlockStateIndex()
+        : blockIds(1, 0)
+    {
+    }
+
+    uint32_t BlockStateIndex::lookup(const PaletteEntry& entry)
+    {
+        if (entry.name == nullptr ||
+            (entry.nameSize == 13 && memcmp(entry.name, "minecraft:air", 13) == 0)) {
+            return kNoState;
+        }
+
+        if (entry.version != nullptr) {
+            key.assign(entry.nbt, entry.version - entry.nbt);
+            key.append(entry.version + entry.versionSize, entry.nbt + entry.nbtSize);
+        }
+        else {
+            key.assign(entry.nbt, entry.nbtSize);
+        }
+        auto it = states.find(key);
+        if (it != states.end()) {
+            return it->second;
+        }
+
+        int32_t blockId = 0;
+        std::string bname(entry.name, entry.nameSize);
+        auto block = Block::getByUname(bname);
+        if (block != nullptr) {
+            blockId = block->id;
+        }
+        else {
+            record_unknow_uname(bname);
+        }
+        const uint32_t state = uint32_t(blockIds.size());
+        blockIds.push_back(blockId);
+        states.emplace(key, state);
+        return state;
+    }
+
+    const std::vector<PaletteBlock>* PaletteBlockCache::resolve(const char* p, const char* end)
+    {
+        int32_t paletteSize;
+        if (!readInt32(p, end, paletteSize) || paletteSize < 0 || paletteSize > kBlocksPerSubChunk) {
+            return nullptr;
+        }
+        const char* start = p;
+        for (int32_t i = 0; i < paletteSize; i++) {
+            p = skipPaletteEntry(p, end);
+            if (p == nullptr) {
+                return nullptr;
+            }
+        }
+
+        const size_t paletteBytes = size_t(p - start);
+        const uint64_t hash = hash64(start, paletteBytes);
+        auto range = palettes.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second.bytes.size() == paletteBytes && memcmp(it->second.bytes.data(), start, paletteBytes) == 0) {
+                return &it->second.blocks;
+            }
+        }
+
+        // a palette that is not cached yet
+        entries.resize(paletteSize);
+        p = start;
+        for (int32_t i = 0; i < paletteSize; i++) {
+            p = parsePaletteEntry(p, end, entries[i]);
+            if (p == nullptr) {
+                return nullptr;
+            }
+        }
+
+        std::vector<PaletteBlock> blocks(entries.size(), PaletteBlock{ 0, 0, BlockTable::state(0, 0) });
+        for (size_t i = 0; i < entries.size(); i++) {
+            const auto& entry = entries[i];
+            if (entry.name == nullptr) {
+                log::warn("Did not find 'name' tag in a chunk palette! (i={}) (len={})", i, entries.size());
+                continue;
+            }
+            std::string bname(entry.name, entry.nameSize);
+            auto block = Block::getByUname(bname);
+            if (block != nullptr) {
+                int32_t state = BlockTable::state(block->id, entry.val);
+                if (state < 0) {
+                    state = BlockTable::state(block->id, 0);
+                }
+                blocks[i] = { block->id, entry.val, state };
+            }
+            else {
+                record_unknow_uname(bname);
+            }
+        }
+
+        if (keyBytes + paletteBytes > kMaxPaletteCacheBytes) {
+            palettes.clear();
+            keyBytes = 0;
+        }
+        keyBytes += paletteBytes;
+        auto it = palettes.emplace(hash, CachedPalette{ std::string(start, paletteBytes), std::move(blocks) });
+        return &it->second.blocks;
+    }
+
+    int32_t decodeSubChunkStates(const char* cdata, size_t cdata_size, BlockStateIndex& index, SubChunkStates& out)
+    {
+        std::vector<PaletteStorage> storages;
+        if (parsePaletteStorages(cdata, cdata_size, storages) != 0) {
+            return -1;
+        }
+
+        out.layerCount = std::min(int32_t(storages.size()), SubChunkStates::kMaxLayers);
+        std::vector<uint32_t> paletteStates;
+        for (int32_t layer = 0; layer < out.layerCount; layer++) {
+            const auto& storage = storages[layer];
+            paletteStates.resize(storage.palette.size());
+            for (size_t i = 0; i < storage.palette.size(); i++) {
+                paletteStates[i] = index.lookup(storage.palette[i]);
+            }
+            uint16_t paletteIndices[kBlocksPerSubChunk];
+            unpackPaletteIndices(storage.words, storage.bitsPerBlock, paletteIndices);
+            uint32_t* states = out.states[layer];
+            for (int32_t blockPos = 0; blockPos < kBlocksPerSubChunk; blockPos++) {
+                const size_t paletteIdx = paletteIndices[blockPos];
+                states[blockPos] = (paletteIdx < paletteStates.size()) ? paletteStates[paletteIdx] : BlockStateIndex::kNoState;
+            }
+        }
+        return 0;
+    }
+
+    int32_t comparePalettedSubChunks(const char* cdataA, size_t cdataA_size, const char* cdataB, size_t cdataB_size,
+        std::vector<BlockIdDiff>& diffs)
+    {
+        diffs.clear();
+
+        PaletteStorage storageA, storageB;
+        if (parsePaletteStorage(cdataA, cdataA_size, storageA) != 0) {
+            return -1;
+        }
+        if (parsePaletteStorage(cdataB, cdataB_size, storageB) != 0) {
+            return -1;
+        }
+
+        std::vector<int32_t> blockIdsA, blockIdsB;
+        mapPaletteToBlockIds(storageA, blockIdsA);
+        mapPaletteToBlockIds(storageB, blockIdsB);
+
+        // equal packed words can only be skipped if both palettes give every shared index the same block id
+        bool wordCompare = (storageA.bitsPerBlock == storageB.bitsPerBlock);
+        if (wordCompare) {
+            const size_t shared = std::min(blockIdsA.size(), blockIdsB.size());
+            for (size_t i = 0; i < shared; i++) {
+                if (blockIdsA[i] != blockIdsB[i]) {
+                    wordCompare = false;
+                    break;
+                }
+            }
+        }
+
+        if (wordCompare) {
+            const int32_t blocksPerWord = storageA.blocksPerWord;
+            for (int32_t w = 0; w < storageA.wordCount; w++) {
+                if (memcmp(&storageA.words[w * 4], &storageB.words[w * 4], 4) == 0) {
+                    continue;
+                }
+                const int32_t lastPos = std::min((w + 1) * blocksPerWord, kBlocksPerSubChunk);
+                for (int32_t blockPos = w * blocksPerWord; blockPos < lastPos; blockPos++) {
+                    const int32_t blockIdA = lookupBlockId(blockIdsA, storageA.getIndex(blockPos));
+                    const int32_t blockIdB = lookupBlockId(blockIdsB, storageB.getIndex(blockPos));
+                    if (blockIdA != blockIdB) {
+                        diffs.push_back({ blockPos, blockIdA, blockIdB });
+                    }
+                }
+            }
+            return 0;
+        }
+
+        uint16_t indicesA[kBlocksPerSubChunk], indicesB[kBlocksPerSubChunk];
+        unpackPaletteIndices(storageA.words, storageA.bitsPerBlock, indicesA);
+        unpackPaletteIndices(storageB.words, storageB.bitsPerBlock, indicesB);
+        for (int32_t blockPos = 0; blockPos < kBlocksPerSubChunk; blockPos++) {
+            const int32_t blockIdA = lookupBlockId(blockIdsA, indicesA[blockPos]);
+            const int32_t blockIdB = lookupBlockId(blockIdsB, indicesB[blockPos]);
+            if (blockIdA != blockIdB) {
+                diffs.push_back({ blockPos, blockIdA, blockIdB });
+            }
+        }
+        return 0;
+    }
+
+    int32_t compareSubChunkStates(const char* cdataA, size_t cdataA_size, const char* cdataB, size_t cdataB_size,
+        BlockStateIndex& index, SubChunkStates& statesA, SubChunkStates& statesB, std::vector<BlockIdDiff>& diffs)
+    {
+        diffs.clear();
+        if (decodeSubChunkStates(cdataA, cdataA_size, index, statesA) != 0) {
+            return -1;
+        }
+        if (decodeSubChunkStates(cdataB, cdataB_size, index, statesB) != 0) {
+            return -1;
+        }
+
+        // a missing layer is the same as a layer without blocks
+        const int32_t layerCount = std::max(statesA.layerCount, statesB.layerCount);
+        for (int32_t layer = 0; layer < layerCount; layer++) {
+            if (layer >= statesA.layerCount) {
+                std::fill_n(statesA.states[layer], kBlocksPerSubChunk, BlockStateIndex::kNoState);
+            }
+            if (layer >= statesB.layerCount) {
+                std::fill_n(statesB.states[layer], kBlocksPerSubChunk, BlockStateIndex::kNoState);
+            }
+        }
+
+        for (int32_t blockPos = 0; blockPos < kBlocksPerSubChunk; blockPos++) {
+            bool same = true;
+            for (int32_t layer = 0; layer < layerCount; layer++) {
+                if (statesA.states[layer][blockPos] != statesB.states[layer][blockPos]) {
+                    same = false;
+                    break;
+                }
+            }
+            if (!same) {
+                diffs.push_back({ blockPos, index.blockId(statesA.states[0][blockPos]),
+                    index.blockId(statesB.states[0][blockPos]) });
+            }
+        }
+        return 0;
+    }
+}
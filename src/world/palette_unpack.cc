@@ -0,0 +1,126 @@
+#include "world/palette_unpack.h"
+
+#include <cstring>
+#include <numeric>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MCPE_VIZ_UNPACK_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    const int32_t kBlocksPerSubChunk = 16 * 16 * 16;
+
+    // the word size and the number of indices are known at compile time, so the inner loop is unrolled
+    // (and vectorized with SSE2 where the compiler can)
+    template<int32_t kBits>
+    void unpackKernel(const char* words, uint16_t* out)
+    {
+        constexpr int32_t kPerWord = 32 / kBits;
+        constexpr uint32_t kMask = (1u << kBits) - 1;
+        constexpr int32_t kFullWords = kBlocksPerSubChunk / kPerWord;
+        constexpr int32_t kRest = kBlocksPerSubChunk - kFullWords * kPerWord;
+
+        uint32_t word;
+        for (int32_t w = 0; w < kFullWords; w++) {
+            memcpy(&word, &words[w * 4], sizeof(uint32_t));
+            for (int32_t j = 0; j < kPerWord; j++) {
+                out[j] = uint16_t((word >> (j * kBits)) & kMask);
+            }
+            out += kPerWord;
+        }
+        if (kRest > 0) {
+            memcpy(&word, &words[kFullWords * 4], sizeof(uint32_t));
+            for (int32_t j = 0; j < kRest; j++) {
+                out[j] = uint16_t((word >> (j * kBits)) & kMask);
+            }
+        }
+    }
+
+#ifdef MCPE_VIZ_UNPACK_AVX2
+    bool cpuHasAvx2()
+    {
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        return avx2;
+    }
+
+    // eight indices per step: permute the words they are in to their lanes, shift each lane by its own amount
+    // and mask; the word/shift pattern repeats every lcm(8, blocksPerWord) indices, which span at most 8 words
+    __attribute__((target("avx2")))
+    void unpackAvx2(const char* words, int32_t bits, uint16_t* out)
+    {
+        const int32_t perWord = 32 / bits;
+        const int32_t wordCount = (kBlocksPerSubChunk + perWord - 1) / perWord;
+        const int32_t period = std::lcm(8, perWord);
+        const int32_t groups = period / 8;
+        const int32_t periodWords = period / perWord;
+
+        __m256i wordIdx[8], shift[8];
+        for (int32_t g = 0; g < groups; g++) {
+            alignas(32) int32_t idx[8], sh[8];
+            for (int32_t j = 0; j < 8; j++) {
+                const int32_t i = g * 8 + j;
+                idx[j] = i / perWord;
+                sh[j] = (i % perWord) * bits;
+            }
+            wordIdx[g] = _mm256_load_si256((const __m256i*)idx);
+            shift[g] = _mm256_load_si256((const __m256i*)sh);
+        }
+        const __m256i mask = _mm256_set1_epi32((1 << bits) - 1);
+
+        int32_t i = 0, w = 0;
+        // (the 32 byte load must stay inside the words)
+        for (; i + period <= kBlocksPerSubChunk && w + 8 <= wordCount; i += period, w += periodWords) {
+            const __m256i v = _mm256_loadu_si256((const __m256i*)&words[w * 4]);
+            for (int32_t g = 0; g < groups; g++) {
+                __m256i x = _mm256_permutevar8x32_epi32(v, wordIdx[g]);
+                x = _mm256_and_si256(_mm256_srlv_epi32(x, shift[g]), mask);
+                const __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+                _mm_storeu_si128((__m128i*)&out[i + g * 8], packed);
+            }
+        }
+        const uint32_t smask = (1u << bits) - 1;
+        for (; i < kBlocksPerSubChunk; i++) {
+            uint32_t word;
+            memcpy(&word, &words[(i / perWord) * 4], sizeof(uint32_t));
+            out[i] = uint16_t((word >> ((i % perWord) * bits)) & smask);
+        }
+    }
+#endif
+}
+
+namespace mcpe_viz {
+
+    int32_t unpackPaletteIndicesScalar(const char* words, int32_t bitsPerBlock, uint16_t* out)
+    {
+        switch (bitsPerBlock) {
+        case 1: unpackKernel<1>(words, out); return 0;
+        case 2: unpackKernel<2>(words, out); return 0;
+        case 3: unpackKernel<3>(words, out); return 0;
+        case 4: unpackKernel<4>(words, out); return 0;
+        case 5: unpackKernel<5>(words, out); return 0;
+        case 6: unpackKernel<6>(words, out); return 0;
+        case 8: unpackKernel<8>(words, out); return 0;
+        case 16: unpackKernel<16>(words, out); return 0;
+        default: return -1;
+        }
+    }
+
+    int32_t unpackPaletteIndices(const char* words, int32_t bitsPerBlock, uint16_t* out)
+    {
+#ifdef MCPE_VIZ_UNPACK_AVX2
+        // (16 bits per block is just a copy, the scalar kernel does that as well)
+        if (cpuHasAvx2() && bitsPerBlock != 16) {
+            switch (bitsPerBlock) {
+            case 1: case 2: case 3: case 4: case 5: case 6: case 8:
+                unpackAvx2(words, bitsPerBlock, out);
+                return 0;
+            default:
+                return -1;
+            }
+        }
+#endif
+        return unpackPaletteIndicesScalar(words, bitsPerBlock, out);
+    }
+}
@@ -9,4 +9,10 @@ namespace mcpe_viz {
     void worldPointToGeoJSONPoint(int32_t dimId, double wx, double wz, double& ix, double& iy) {
         worldPointToImagePoint(dimId, wx, wz, ix, iy, true);
     }
+
+    bool imagePointsKnown(int32_t dimId) {
+        // hack to avoid using wrong dim on pre-0.12 worlds
+        if (dimId < 0) { dimId = 0; }
+        return world->dimDataList[dimId]->getChunkBoundsValid();
+    }
 }
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "world/prefetch_iterator.h"
+#include "control.h"
+
+#include <algorithm>
+
+namespace mcpe_viz {
+
+    PrefetchIterator::PrefetchIterator(leveldb::Iterator* iter, size_t aheadBytes)
+        : iter(iter)
+        , aheadBytes(aheadBytes)
+        , batchBytes(std::max(aheadBytes / 4, size_t(4096)))
+        , stop(false)
+        , generation(0)
+        , seekFirst(false)
+        , queuedBytes(0)
+        , index(0)
+    {
+    }
+
+    PrefetchIterator::~PrefetchIterator()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_all();
+        if (helper.joinable()) {
+            helper.join();
+        }
+        delete iter;
+    }
+
+    // the helper thread: seek, then fill batches until aheadBytes are queued, the end is reached or a new seek comes
+    void PrefetchIterator::run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        uint64_t gen = 0;
+        while (true) {
+            cv.wait(lock, [&]() { return stop || generation != gen; });
+            if (stop) {
+                return;
+            }
+            gen = generation;
+            const bool first = seekFirst;
+            const std::string target = seekTarget;
+            lock.unlock();
+            if (first) {
+                iter->SeekToFirst();
+            }
+            else {
+                iter->Seek(target);
+            }
+            lock.lock();
+
+            while (!stop && gen == generation) {
+                if (queuedBytes >= aheadBytes) {
+                    cv.wait(lock, [&]() { return stop || gen != generation || queuedBytes < aheadBytes; });
+                    continue;
+                }
+                lock.unlock();
+                auto batch = std::make_unique<Batch>();
+                while (iter->Valid() && batch->data.size() < batchBytes) {
+                    const leveldb::Slice key = iter->key();
+                    const leveldb::Slice value = iter->value();
+                    batch->records.push_back({ batch->data.size(), { key.size(), value.size() } });
+                    batch->data.append(key.data(), key.size());
+                    batch->data.append(value.data(), value.size());
+                    iter->Next();
+                }
+                batch->end = !iter->Valid();
+                batch->status = iter->status();
+                const bool end = batch->end;
+                lock.lock();
+                if (gen != generation) {
+                    break;
+                }
+                queuedBytes += batch->data.size();
+                queue.push_back(std::move(batch));
+                cv.notify_all();
+                if (end) {
+                    break;
+                }
+            }
+        }
+    }
+
+    void PrefetchIterator::startSeek(bool first, const leveldb::Slice& target)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            generation++;
+            seekFirst = first;
+            seekTarget = target.ToString();
+            queue.clear();
+            queuedBytes = 0;
+        }
+        cv.notify_all();
+        if (!helper.joinable()) {
+            helper = std::thread(&PrefetchIterator::run, this);
+        }
+        nextBatch();
+    }
+
+    void PrefetchIterator::nextBatch()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return !queue.empty(); });
+        current = std::move(queue.front());
+        queue.pop_front();
+        queuedBytes -= current->data.size();
+        lock.unlock();
+        cv.notify_all();
+        index = 0;
+    }
+
+    bool PrefetchIterator::Valid() const
+    {
+        return current && index < current->records.size();
+    }
+
+    void PrefetchIterator::SeekToFirst()
+    {
+        startSeek(true, leveldb::Slice());
+    }
+
+    void PrefetchIterator::SeekToLast()
+    {
+        current = std::make_unique<Batch>();
+        current->status = leveldb::Status::NotSupported("PrefetchIterator only goes forward");
+        current->end = true;
+    }
+
+    void PrefetchIterator::Seek(const leveldb::Slice& target)
+    {
+        startSeek(false, target);
+    }
+
+    void PrefetchIterator::Next()
+    {
+        index++;
+        if (index >= current->records.size() && !current->end) {
+            nextBatch();
+        }
+    }
+
+    void PrefetchIterator::Prev()
+    {
+        SeekToLast();
+    }
+
+    leveldb::Slice PrefetchIterator::key() const
+    {
+        const auto& r = current->records[index];
+        return leveldb::Slice(current->data.data() + r.first, r.second.first);
+    }
+
+    leveldb::Slice PrefetchIterator::value() const
+    {
+        const auto& r = current->records[index];
+        return leveldb::Slice(current->data.data() + r.first + r.second.first, r.second.second);
+    }
+
+    leveldb::Status PrefetchIterator::status() const
+    {
+        return current ? current->status : leveldb::Status::OK();
+    }
+
+    leveldb::Iterator* newScanIterator(leveldb::DB* db, const leveldb::ReadOptions& options)
+    {
+        leveldb::Iterator* iter = db->NewIterator(options);
+        if (control.prefetchBlocks <= 0) {
+            return iter;
+        }
+        return new PrefetchIterator(iter, size_t(control.prefetchBlocks) * size_t(std::max(control.leveldbBlockSize, 4096)));
+    }
+}
@@ -0,0 +1,179 @@
+#include "world/prune.h"
+#include "world/chunk_key.h"
+#include "world/common.h"
+#include "define.h"
+#include "logger.h"
+#include "util.h"
+
+#include <cstring>
+#include <memory>
+
+#include <leveldb/write_batch.h>
+
+namespace
+{
+    // deletes are written in batches of about this many bytes
+    const size_t kPruneBatchSize = 4 * 1024 * 1024;
+
+    // newer worlds keep the entities of a chunk as separate "actorprefix" records, listed in a
+    // "digp" record: "digp", chunkX, chunkZ, [dimId] -> list of 8 byte actor id's
+    const char kDigpPrefix[] = "digp";
+    const char kActorPrefix[] = "actorprefix";
+
+    // true if the key is really a chunk record: parseChunkRecordKey only checks the size, and text keys
+    // of that size (like "Overworld" or short "map_..." keys) must never be taken for a chunk
+    // - the record type is a chunk record type (0x76 is the old version record)
+    // - only subchunk records (0x2f) have a subchunk byte, and they always have one
+    // - the key is not all printable text (a chunk key has coordinates that are that only for chunks
+    //   hundreds of millions of blocks out)
+    bool parsePruneChunkKey(const leveldb::Slice& key, mcpe_viz::ChunkRecordKey& ck)
+    {
+        if (!mcpe_viz::parseChunkRecordKey(key.data(), key.size(), ck)) {
+            return false;
+        }
+        if (!((ck.type >= 0x2b && ck.type <= 0x3f) || ck.type == 0x76)) {
+            return false;
+        }
+        if ((ck.subChunk >= 0) != (ck.type == 0x2f)) {
+            return false;
+        }
+        for (size_t i = 0; i < key.size(); i++) {
+            const uint8_t c = uint8_t(key[i]);
+            if (c < 0x20 || c > 0x7e) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parseDigpKey(const leveldb::Slice& key, int32_t& chunkX, int32_t& chunkZ, int32_t& dimId)
+    {
+        if ((key.size() != 12 && key.size() != 16) || !key.starts_with(kDigpPrefix)) {
+            return false;
+        }
+        chunkX = mcpe_viz::myParseInt32(key.data(), 4);
+        chunkZ = mcpe_viz::myParseInt32(key.data(), 8);
+        dimId = (key.size() == 16) ? mcpe_viz::myParseInt32(key.data(), 12) : mcpe_viz::kDimIdOverworld;
+        return true;
+    }
+
+    // 1 = keep, 0 = delete, -1 = dimension has no keep area
+    int32_t keepChunk(const std::vector<mcpe_viz::KeepArea>& keepAreas, int32_t dimId, int32_t chunkX, int32_t chunkZ)
+    {
+        int32_t ret = -1;
+        for (const auto& area : keepAreas) {
+            if (area.dimId == dimId) {
+                if (area.containsChunk(chunkX, chunkZ)) {
+                    return 1;
+                }
+                ret = 0;
+            }
+        }
+        return ret;
+    }
+}
+
+namespace mcpe_viz {
+
+    int32_t pruneWorld(leveldb::DB* db, const std::vector<KeepArea>& keepAreas, PruneStats& stats)
+    {
+        leveldb::WriteBatch batch;
+        std::string firstKey, lastKey;
+        leveldb::Status status;
+        auto writeBatch = [&]() {
+            status = db->Write(leveldb::WriteOptions(), &batch);
+            batch.Clear();
+            return status.ok();
+        };
+        auto deleteKey = [&](const leveldb::Slice& key, size_t valueSize) {
+            batch.Delete(key);
+            // actor records are not deleted in key order
+            if (firstKey.empty() || key.compare(firstKey) < 0) {
+                firstKey = key.ToString();
+            }
+            if (lastKey.empty() || key.compare(lastKey) > 0) {
+                lastKey = key.ToString();
+            }
+            stats.deletedRecords++;
+            stats.deletedBytes += key.size() + valueSize;
+        };
+
+        // the iterator reads from an implicit snapshot, so our own deletes do not disturb it
+        std::unique_ptr<leveldb::Iterator> iter(db->NewIterator(levelDbReadOptions));
+        int32_t lastDimId = -1, lastChunkX = 0, lastChunkZ = 0;
+        std::string actorValue;
+        uint64_t recordCt = 0;
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+            if ((++recordCt % 100000) == 0) {
+                log::info("  Processing records: {}", recordCt);
+            }
+            const leveldb::Slice key = iter->key();
+            ChunkRecordKey ck;
+            int32_t keep;
+            if (parsePruneChunkKey(key, ck)) {
+                keep = keepChunk(keepAreas, ck.dimId, ck.chunkX, ck.chunkZ);
+                // the records of a chunk column in one dimension are next to each other
+                if (keep == 0 && (ck.dimId != lastDimId || ck.chunkX != lastChunkX || ck.chunkZ != lastChunkZ)) {
+                    stats.deletedChunks++;
+                    lastDimId = ck.dimId;
+                    lastChunkX = ck.chunkX;
+                    lastChunkZ = ck.chunkZ;
+                }
+            }
+            else if (parseDigpKey(key, ck.chunkX, ck.chunkZ, ck.dimId)) {
+                keep = keepChunk(keepAreas, ck.dimId, ck.chunkX, ck.chunkZ);
+                if (keep == 0) {
+                    // (only the actors that are there are counted)
+                    const leveldb::Slice ids = iter->value();
+                    for (size_t i = 0; i + 8 <= ids.size(); i += 8) {
+                        const std::string actorKey = std::string(kActorPrefix) + std::string(ids.data() + i, 8);
+                        status = db->Get(levelDbReadOptions, actorKey, &actorValue);
+                        if (status.ok()) {
+                            deleteKey(actorKey, actorValue.size());
+                        }
+                        else if (status.IsNotFound()) {
+                            status = leveldb::Status::OK();
+                        }
+                        else {
+                            break;
+                        }
+                    }
+                    if (!status.ok()) {
+                        break;
+                    }
+                }
+            }
+            else {
+                keep = -1;
+            }
+
+            if (keep == 0) {
+                deleteKey(key, iter->value().size());
+                if (batch.ApproximateSize() >= kPruneBatchSize && !writeBatch()) {
+                    break;
+                }
+            }
+            else if (keep == 1) {
+                stats.keptRecords++;
+            }
+        }
+        if (status.ok()) {
+            status = iter->status();
+        }
+        iter.reset();
+        if (status.ok()) {
+            writeBatch();
+        }
+        if (!status.ok()) {
+            log::error("LevelDB operation returned status={}", status.ToString());
+            return -1;
+        }
+
+        if (!firstKey.empty()) {
+            // without this the deleted records stay on disk until leveldb gets around to them
+            const leveldb::Slice begin(firstKey), end(lastKey);
+            db->CompactRange(&begin, &end);
+        }
+        return 0;
+    }
+}
@@ -0,0 +1,586 @@
+#include "world/read_only_db.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// leveldb internals: the MANIFEST, the .log files and the tables are read with leveldb's own readers
+#include "db/dbformat.h"
+#include "db/filename.h"
+#include "db/log_reader.h"
+#include "db/memtable.h"
+#include "db/table_cache.h"
+#include "db/version_set.h"
+#include "db/write_batch_internal.h"
+#include "leveldb/env.h"
+#include "leveldb/write_batch.h"
+#include "table/merger.h"
+
+namespace
+{
+    // a server may be writing the MANIFEST or a log while we read it; we try again a few times
+    const int32_t kOpenAttempts = 5;
+    // parsed tables; a table that drops out of the cache is parsed again from its file, which ReadOnlyEnv keeps open
+    const int kTableCacheSize = 1 << 20;
+
+    class DropReporter : public leveldb::log::Reader::Reporter {
+    public:
+        size_t droppedBytes = 0;
+        void Corruption(size_t bytes, const leveldb::Status&) override
+        {
+            droppedBytes += bytes;
+        }
+    };
+
+    // a table file that stays open until the db is closed, so the server can delete it (after a compaction)
+    // while we still read it
+    class PinnedFile {
+    public:
+        ~PinnedFile()
+        {
+#ifdef _WIN32
+            CloseHandle(handle);
+#else
+            ::close(fd);
+#endif
+        }
+
+        static leveldb::Status open(const std::string& fn, std::shared_ptr<PinnedFile>& file)
+        {
+#ifdef _WIN32
+            // the server may have the file open, and may delete it while we have it open
+            HANDLE handle = CreateFileA(fn.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, nullptr);
+            if (handle == INVALID_HANDLE_VALUE) {
+                const DWORD error = GetLastError();
+                if (error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND) {
+                    return leveldb::Status::NotFound(fn);
+                }
+                if (error == ERROR_TOO_MANY_OPEN_FILES) {
+                    return leveldb::Status::IOError(fn, "too many open files (every table of a read-only world stays open)");
+                }
+                return leveldb::Status::IOError(fn, "error " + std::to_string(error));
+            }
+            file.reset(new PinnedFile(handle));
+#else
+            const int fd = ::open(fn.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                if (errno == ENOENT) {
+                    return leveldb::Status::NotFound(fn);
+                }
+                if (errno == EMFILE || errno == ENFILE) {
+                    return leveldb::Status::IOError(fn,
+                        "too many open files (every table of a read-only world stays open, raise the limit with ulimit -n)");
+                }
+                return leveldb::Status::IOError(fn, strerror(errno));
+            }
+            file.reset(new PinnedFile(fd));
+#endif
+            return leveldb::Status::OK();
+        }
+
+        leveldb::Status read(uint64_t offset, size_t n, leveldb::Slice* result, char* scratch) const
+        {
+#ifdef _WIN32
+            DWORD bytesRead = 0;
+            OVERLAPPED overlapped = {};
+            overlapped.OffsetHigh = DWORD(offset >> 32);
+            overlapped.Offset = DWORD(offset);
+            if (!ReadFile(handle, scratch, DWORD(n), &bytesRead, &overlapped) && GetLastError() != ERROR_HANDLE_EOF) {
+                *result = leveldb::Slice(scratch, 0);
+                return leveldb::Status::IOError("read of a table failed", "error " + std::to_string(GetLastError()));
+            }
+            *result = leveldb::Slice(scratch, bytesRead);
+#else
+            const ssize_t r = ::pread(fd, scratch, n, off_t(offset));
+            if (r < 0) {
+                *result = leveldb::Slice(scratch, 0);
+                return leveldb::Status::IOError("read of a table failed", strerror(errno));
+            }
+            *result = leveldb::Slice(scratch, size_t(r));
+#endif
+            return leveldb::Status::OK();
+        }
+
+    private:
+#ifdef _WIN32
+        explicit PinnedFile(HANDLE handle) : handle(handle) {}
+        HANDLE handle;
+#else
+        explicit PinnedFile(int fd) : fd(fd) {}
+        int fd;
+#endif
+    };
+
+    // what the table cache gets for a pinned file; it may delete this and ask again
+    class PinnedFileRef : public leveldb::RandomAccessFile {
+    public:
+        explicit PinnedFileRef(std::shared_ptr<PinnedFile> file) : file(std::move(file)) {}
+
+        leveldb::Status Read(uint64_t offset, size_t n, leveldb::Slice* result, char* scratch) const override
+        {
+            return file->read(offset, n, result, scratch);
+        }
+
+    private:
+        std::shared_ptr<PinnedFile> file;
+    };
+
+#ifdef _WIN32
+    // leveldb's Windows env shares the files it reads for reading only, so it cannot open a log the server is writing
+    class SharedSequentialFile : public leveldb::SequentialFile {
+    public:
+        explicit SharedSequentialFile(HANDLE handle) : handle(handle) {}
+
+        ~SharedSequentialFile() override
+        {
+            CloseHandle(handle);
+        }
+
+        leveldb::Status Read(size_t n, leveldb::Slice* result, char* scratch) override
+        {
+            DWORD bytesRead = 0;
+            if (!ReadFile(handle, scratch, DWORD(n), &bytesRead, nullptr)) {
+                return leveldb::Status::IOError("read failed", "error " + std::to_string(GetLastError()));
+            }
+            *result = leveldb::Slice(scratch, bytesRead);
+            return leveldb::Status::OK();
+        }
+
+        leveldb::Status Skip(uint64_t n) override
+        {
+            LARGE_INTEGER distance;
+            distance.QuadPart = LONGLONG(n);
+            if (!SetFilePointerEx(handle, distance, nullptr, FILE_CURRENT)) {
+                return leveldb::Status::IOError("skip failed", "error " + std::to_string(GetLastError()));
+            }
+            return leveldb::Status::OK();
+        }
+
+    private:
+        HANDLE handle;
+    };
+#endif
+
+    // the env of a read-only db: leveldb's own env may close a table and open it again later (env_posix keeps
+    // only about 1000 tables mapped and a limited number of fds, then opens the file again for every read),
+    // which fails once the server has deleted the table; here every table is opened once and stays open
+    class ReadOnlyEnv : public leveldb::EnvWrapper {
+    public:
+        explicit ReadOnlyEnv(leveldb::Env* base) : EnvWrapper(base) {}
+
+        leveldb::Status NewRandomAccessFile(const std::string& fn, leveldb::RandomAccessFile** result) override
+        {
+            *result = nullptr;
+            std::lock_guard<std::mutex> lock(mutex);
+            auto& file = files[fn];
+            if (!file) {
+                leveldb::Status status = PinnedFile::open(fn, file);
+                if (!status.ok()) {
+                    files.erase(fn);
+                    return status;
+                }
+            }
+            *result = new PinnedFileRef(file);
+            return leveldb::Status::OK();
+        }
+
+#ifdef _WIN32
+        leveldb::Status NewSequentialFile(const std::string& fn, leveldb::SequentialFile** result) override
+        {
+            *result = nullptr;
+            HANDLE handle = CreateFileA(fn.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (handle == INVALID_HANDLE_VALUE) {
+                const DWORD error = GetLastError();
+                if (error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND) {
+                    return leveldb::Status::NotFound(fn);
+                }
+                return leveldb::Status::IOError(fn, "error " + std::to_string(error));
+            }
+            *result = new SharedSequentialFile(handle);
+            return leveldb::Status::OK();
+        }
+#endif
+
+        // close the files of an earlier attempt to open the db
+        void unpinAll()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            files.clear();
+        }
+
+    private:
+        std::mutex mutex;
+        std::map<std::string, std::shared_ptr<PinnedFile>> files;
+    };
+
+    // the newest entry of each user key (the entries of a user key come newest first), without deleted keys
+    class ReadOnlyDbIterator : public leveldb::Iterator {
+    public:
+        ReadOnlyDbIterator(leveldb::Iterator* iter, const leveldb::Comparator* ucmp)
+            : iter(iter), ucmp(ucmp), valid(false)
+        {
+        }
+
+        ~ReadOnlyDbIterator() override
+        {
+            delete iter;
+        }
+
+        bool Valid() const override { return valid; }
+
+        void SeekToFirst() override
+        {
+            iter->SeekToFirst();
+            findNextUserEntry(false);
+        }
+
+        void SeekToLast() override
+        {
+            notSupported();
+        }
+
+        void Seek(const leveldb::Slice& target) override
+        {
+            std::string ikey;
+            leveldb::AppendInternalKey(&ikey,
+                leveldb::ParsedInternalKey(target, leveldb::kMaxSequenceNumber, leveldb::kValueTypeForSeek));
+            iter->Seek(ikey);
+            findNextUserEntry(false);
+        }
+
+        void Next() override
+        {
+            skipKey.assign(currentKey.data(), currentKey.size());
+            iter->Next();
+            findNextUserEntry(true);
+        }
+
+        void Prev() override
+        {
+            notSupported();
+        }
+
+        leveldb::Slice key() const override { return currentKey; }
+
+        leveldb::Slice value() const override { return iter->value(); }
+
+        leveldb::Status status() const override
+        {
+            return ownStatus.ok() ? iter->status() : ownStatus;
+        }
+
+    private:
+        void findNextUserEntry(bool skipping)
+        {
+            leveldb::ParsedInternalKey ikey;
+            for (; iter->Valid(); iter->Next()) {
+                if (!leveldb::ParseInternalKey(iter->key(), &ikey)) {
+                    ownStatus = leveldb::Status::Corruption("corrupted internal key");
+                    break;
+                }
+                if (skipping && ucmp->Compare(ikey.user_key, skipKey) == 0) {
+                    continue;
+                }
+                if (ikey.type == leveldb::kTypeDeletion) {
+                    skipKey.assign(ikey.user_key.data(), ikey.user_key.size());
+                    skipping = true;
+                    continue;
+                }
+                currentKey = ikey.user_key;
+                valid = true;
+                return;
+            }
+            valid = false;
+        }
+
+        void notSupported()
+        {
+            ownStatus = leveldb::Status::NotSupported("the world is opened read-only (forward iteration only)");
+            valid = false;
+        }
+
+        leveldb::Iterator* iter;
+        const leveldb::Comparator* ucmp;
+        bool valid;
+        leveldb::Slice currentKey;
+        std::string skipKey;
+        leveldb::Status ownStatus;
+    };
+
+    class ReadOnlyDb : public leveldb::DB {
+    public:
+        ReadOnlyDb(const leveldb::Options& rawOptions, const std::string& dirDb)
+            : dirDb(dirDb), icmp(rawOptions.comparator), ipolicy(rawOptions.filter_policy),
+              env((rawOptions.env != nullptr) ? rawOptions.env : leveldb::Env::Default()), mem(nullptr),
+              tableCt(0), logRecordCt(0)
+        {
+            // the tables hold internal keys (see SanitizeOptions in db_impl.cc)
+            options = rawOptions;
+            options.comparator = &icmp;
+            options.filter_policy = (rawOptions.filter_policy != nullptr) ? &ipolicy : nullptr;
+            options.env = &env;
+        }
+
+        ~ReadOnlyDb() override
+        {
+            close();
+        }
+
+        leveldb::Status open()
+        {
+            leveldb::Status status;
+            for (int32_t attempt = 1; attempt <= kOpenAttempts; attempt++) {
+                close();
+                std::string manifest;
+                status = readManifestState(manifest);
+                if (status.ok()) {
+                    status = load();
+                }
+                // the server flushed a log into a table while we were reading; the log we read may be gone
+                std::string manifestAfter;
+                if (status.ok() && (!readManifestState(manifestAfter).ok() || manifestAfter != manifest)) {
+                    status = leveldb::Status::IOError("the MANIFEST changed while it was read");
+                }
+                if (status.ok()) {
+                    return status;
+                }
+                mcpe_viz::log::warn("Read-only open of '{}' failed (attempt {} of {}): {}", dirDb, attempt, kOpenAttempts,
+                    status.ToString());
+                std::this_thread::sleep_for(std::chrono::milliseconds(200 * attempt));
+            }
+            close();
+            return status;
+        }
+
+        leveldb::Status Put(const leveldb::WriteOptions&, const leveldb::Slice&, const leveldb::Slice&) override
+        {
+            return leveldb::Status::NotSupported("the world is opened read-only");
+        }
+
+        leveldb::Status Delete(const leveldb::WriteOptions&, const leveldb::Slice&) override
+        {
+            return leveldb::Status::NotSupported("the world is opened read-only");
+        }
+
+        leveldb::Status Write(const leveldb::WriteOptions&, leveldb::WriteBatch*) override
+        {
+            return leveldb::Status::NotSupported("the world is opened read-only");
+        }
+
+        leveldb::Status Get(const leveldb::ReadOptions& readOptions, const leveldb::Slice& key, std::string* value) override
+        {
+            std::unique_ptr<leveldb::Iterator> iter(NewIterator(readOptions));
+            iter->Seek(key);
+            if (iter->Valid() && iter->key() == key) {
+                value->assign(iter->value().data(), iter->value().size());
+                return leveldb::Status::OK();
+            }
+            return iter->status().ok() ? leveldb::Status::NotFound(leveldb::Slice()) : iter->status();
+        }
+
+        leveldb::Iterator* NewIterator(const leveldb::ReadOptions& readOptions) override
+        {
+            // the db does not change, so the memtable and the version need no refs
+            std::vector<leveldb::Iterator*> list;
+            list.push_back(mem->NewIterator());
+            versions->current()->AddIterators(readOptions, &list);
+            leveldb::Iterator* merged = leveldb::NewMergingIterator(&icmp, list.data(), int(list.size()));
+            return new ReadOnlyDbIterator(merged, icmp.user_comparator());
+        }
+
+        const leveldb::Snapshot* GetSnapshot() override
+        {
+            // the whole db is a snapshot
+            return nullptr;
+        }
+
+        void ReleaseSnapshot(const leveldb::Snapshot*) override
+        {
+        }
+
+        bool GetProperty(const leveldb::Slice& property, std::string* value) override
+        {
+            if (property == "leveldb.sstables") {
+                *value = versions->current()->DebugString();
+                return true;
+            }
+            return false;
+        }
+
+        void GetApproximateSizes(const leveldb::Range* range, int n, uint64_t* sizes) override
+        {
+            // like DBImpl: the tables only, not the logs
+            for (int i = 0; i < n; i++) {
+                leveldb::InternalKey k1(range[i].start, leveldb::kMaxSequenceNumber, leveldb::kValueTypeForSeek);
+                leveldb::InternalKey k2(range[i].limit, leveldb::kMaxSequenceNumber, leveldb::kValueTypeForSeek);
+                const uint64_t start = versions->ApproximateOffsetOf(versions->current(), k1);
+                const uint64_t limit = versions->ApproximateOffsetOf(versions->current(), k2);
+                sizes[i] = (limit >= start) ? (limit - start) : 0;
+            }
+        }
+
+        void CompactRange(const leveldb::Slice*, const leveldb::Slice*) override
+        {
+        }
+
+    private:
+        // the name and size of the current MANIFEST
+        leveldb::Status readManifestState(std::string& state)
+        {
+            std::string current;
+            leveldb::Status status = leveldb::ReadFileToString(options.env, leveldb::CurrentFileName(dirDb), &current);
+            if (!status.ok()) {
+                return status;
+            }
+            while (!current.empty() && current.back() == '\n') {
+                current.pop_back();
+            }
+            uint64_t size = 0;
+            status = options.env->GetFileSize(dirDb + "/" + current, &size);
+            state = current + ":" + std::to_string(size);
+            return status;
+        }
+
+        leveldb::Status load()
+        {
+            tableCache = std::make_unique<leveldb::TableCache>(dirDb, options, kTableCacheSize);
+            versions = std::make_unique<leveldb::VersionSet>(dirDb, &options, tableCache.get(), &icmp);
+            bool saveManifest = false;
+            leveldb::Status status = versions->Recover(&saveManifest);
+            if (!status.ok()) {
+                return status;
+            }
+
+            // the logs that are not yet in a table, oldest first (see DBImpl::Recover)
+            std::vector<std::string> fileNames;
+            status = options.env->GetChildren(dirDb, &fileNames);
+            if (!status.ok()) {
+                return status;
+            }
+            std::vector<uint64_t> logs;
+            for (const auto& fn : fileNames) {
+                uint64_t number;
+                leveldb::FileType type;
+                if (leveldb::ParseFileName(fn, &number, &type) && type == leveldb::kLogFile &&
+                    (number >= versions->LogNumber() || number == versions->PrevLogNumber())) {
+                    logs.push_back(number);
+                }
+            }
+            std::sort(logs.begin(), logs.end());
+
+            mem = new leveldb::MemTable(icmp);
+            mem->Ref();
+            for (uint64_t number : logs) {
+                status = readLog(number);
+                if (!status.ok()) {
+                    return status;
+                }
+            }
+
+            // open every table now; the server may delete a table when it compacts, but the env keeps the file open
+            for (int level = 0; level < leveldb::config::kNumLevels; level++) {
+                std::vector<leveldb::FileMetaData*> files;
+                versions->current()->GetOverlappingInputs(level, nullptr, nullptr, &files);
+                for (const auto* f : files) {
+                    std::unique_ptr<leveldb::Iterator> iter(
+                        tableCache->NewIterator(leveldb::ReadOptions(), f->number, f->file_size));
+                    if (!iter->status().ok()) {
+                        return iter->status();
+                    }
+                    tableCt++;
+                }
+            }
+
+            mcpe_viz::log::info("Read-only open: {} tables, {} records from {} logs", tableCt, logRecordCt, logs.size());
+            return leveldb::Status::OK();
+        }
+
+        leveldb::Status readLog(uint64_t number)
+        {
+            const std::string fn = leveldb::LogFileName(dirDb, number);
+            leveldb::SequentialFile* file = nullptr;
+            leveldb::Status status = options.env->NewSequentialFile(fn, &file);
+            if (!status.ok()) {
+                return status;
+            }
+
+            // the last record may be half written by the server; it is dropped
+            DropReporter reporter;
+            leveldb::log::Reader reader(file, &reporter, true, 0);
+            std::string scratch;
+            leveldb::Slice record;
+            leveldb::WriteBatch batch;
+            while (reader.ReadRecord(&record, &scratch)) {
+                if (record.size() < 12) {
+                    reporter.droppedBytes += record.size();
+                    continue;
+                }
+                leveldb::WriteBatchInternal::SetContents(&batch, record);
+                status = leveldb::WriteBatchInternal::InsertInto(&batch, mem);
+                if (!status.ok()) {
+                    break;
+                }
+                logRecordCt += leveldb::WriteBatchInternal::Count(&batch);
+            }
+            delete file;
+            if (reporter.droppedBytes > 0) {
+                mcpe_viz::log::warn("Read-only open: dropped {} bytes of '{}'", reporter.droppedBytes, fn);
+            }
+            return status;
+        }
+
+        void close()
+        {
+            if (mem != nullptr) {
+                mem->Unref();
+                mem = nullptr;
+            }
+            versions.reset();
+            tableCache.reset();
+            env.unpinAll();
+            tableCt = 0;
+            logRecordCt = 0;
+        }
+
+        const std::string dirDb;
+        const leveldb::InternalKeyComparator icmp;
+        const leveldb::InternalFilterPolicy ipolicy;
+        ReadOnlyEnv env;
+        leveldb::Options options;
+        std::unique_ptr<leveldb::TableCache> tableCache;
+        std::unique_ptr<leveldb::VersionSet> versions;
+        leveldb::MemTable* mem;
+        size_t tableCt;
+        size_t logRecordCt;
+    };
+}
+
+namespace mcpe_viz {
+
+    leveldb::Status openReadOnlyDb(const leveldb::Options& options, const std::string& dirDb, leveldb::DB** dbptr)
+    {
+        *dbptr = nullptr;
+        auto db = std::make_unique<ReadOnlyDb>(options, dirDb);
+        leveldb::Status status = db->open();
+        if (status.ok()) {
+            *dbptr = db.release();
+        }
+        return status;
+    }
+}
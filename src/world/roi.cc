@@ -0,0 +1,191 @@
+#include "world/roi.h"
+#include "world/chunk_key.h"
+#include "world/prefetch_iterator.h"
+#include "control.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace
+{
+    // the non-chunk records that dbParse knows about
+    const char* kRecordNames[] = {
+        "AutonomousEntities", "BiomeData", "Nether", "Overworld", "dimension", "game_flatworldlayers",
+        "idcounts", "mVillages", "player_", "portals", "villages", "~local_player"
+    };
+
+    const int32_t kUnsetLimit = 0x8FFFFFFF;
+
+    bool isRecordName(const char* key, size_t keySize)
+    {
+        for (const char* name : kRecordNames) {
+            const size_t len = strlen(name);
+            if (keySize >= len && memcmp(key, name, len) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+namespace mcpe_viz {
+
+    ChunkRoi ChunkRoi::fromControl()
+    {
+        // block coordinates to chunk coordinates (rounding towards -infinity)
+        ChunkRoi roi;
+        roi.minChunkX = (control.minX != kUnsetLimit) ? (control.minX >> 4) : INT32_MIN;
+        roi.maxChunkX = (control.maxX != kUnsetLimit) ? (control.maxX >> 4) : INT32_MAX;
+        roi.minChunkZ = (control.minZ != kUnsetLimit) ? (control.minZ >> 4) : INT32_MIN;
+        roi.maxChunkZ = (control.maxZ != kUnsetLimit) ? (control.maxZ >> 4) : INT32_MAX;
+        roi.minSubChunk = (control.minY != kUnsetLimit) ? std::max(0, control.minY >> 4) : 0;
+        roi.maxSubChunk = (control.maxY != kUnsetLimit) ? std::min(255, control.maxY >> 4) : 255;
+        return roi;
+    }
+
+    bool ChunkRoi::active() const
+    {
+        return (minChunkX != INT32_MIN) || (maxChunkX != INT32_MAX) || (minChunkZ != INT32_MIN) || (maxChunkZ != INT32_MAX) ||
+            (minSubChunk != 0) || (maxSubChunk != 255);
+    }
+
+    bool ChunkRoi::excludesKey(const char* key, size_t keySize) const
+    {
+        ChunkRecordKey ck;
+        if (isRecordName(key, keySize) || !parseChunkRecordKey(key, keySize, ck)) {
+            return false;
+        }
+        if (!containsChunk(ck.chunkX, ck.chunkZ)) {
+            return true;
+        }
+        return (ck.type == 0x2f) && (ck.subChunk >= 0) && !containsSubChunk(ck.subChunk);
+    }
+
+    bool ChunkRoi::useSeek() const
+    {
+        if (minChunkX == INT32_MIN || maxChunkX == INT32_MAX || minChunkZ == INT32_MIN || maxChunkZ == INT32_MAX) {
+            return false;
+        }
+        if (maxChunkX < minChunkX || maxChunkZ < minChunkZ) {
+            return true;
+        }
+        const uint64_t count = uint64_t(int64_t(maxChunkX) - minChunkX + 1) * uint64_t(int64_t(maxChunkZ) - minChunkZ + 1);
+        return count <= kMaxSeekChunks;
+    }
+
+    std::vector<std::string> ChunkRoi::chunkPrefixes() const
+    {
+        std::vector<std::string> out;
+        if (!useSeek()) {
+            return out;
+        }
+        for (int32_t x = minChunkX; x <= maxChunkX; x++) {
+            for (int32_t z = minChunkZ; z <= maxChunkZ; z++) {
+                char keybuf[8];
+                memcpy(&keybuf[0], &x, sizeof(int32_t));
+                memcpy(&keybuf[4], &z, sizeof(int32_t));
+                out.push_back(std::string(keybuf, 8));
+            }
+        }
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+
+    RoiIterator::RoiIterator(leveldb::DB* db, const leveldb::ReadOptions& options, const ChunkRoi& roi)
+        : roi(roi)
+        , prefixIndex(0)
+    {
+        // a full scan reads ahead; seeks per chunk column would throw most of it away
+        iter = roi.useSeek() ? db->NewIterator(options) : newScanIterator(db, options);
+        if (roi.useSeek()) {
+            prefixes = roi.chunkPrefixes();
+            for (const char* name : kRecordNames) {
+                prefixes.push_back(name);
+            }
+            std::sort(prefixes.begin(), prefixes.end());
+        }
+    }
+
+    RoiIterator::~RoiIterator()
+    {
+        delete iter;
+    }
+
+    bool RoiIterator::inPrefix() const
+    {
+        return iter->Valid() && iter->key().starts_with(prefixes[prefixIndex]);
+    }
+
+    // move to the first record of the current prefix or a later one
+    void RoiIterator::seekPrefix()
+    {
+        for (; prefixIndex < prefixes.size(); prefixIndex++) {
+            iter->Seek(prefixes[prefixIndex]);
+            if (inPrefix()) {
+                return;
+            }
+        }
+    }
+
+    void RoiIterator::skipExcluded()
+    {
+        while (valid() && roi.excludesKey(iter->key().data(), iter->key().size())) {
+            next();
+        }
+    }
+
+    void RoiIterator::seekToFirst()
+    {
+        if (prefixes.empty()) {
+            iter->SeekToFirst();
+        }
+        else {
+            prefixIndex = 0;
+            seekPrefix();
+        }
+        skipExcluded();
+    }
+
+    void RoiIterator::seek(const leveldb::Slice& target)
+    {
+        if (prefixes.empty()) {
+            iter->Seek(target);
+        }
+        else {
+            prefixIndex = std::lower_bound(prefixes.begin(), prefixes.end(), target.ToString()) - prefixes.begin();
+            // the target can be inside of the prefix before that
+            if (prefixIndex > 0 && target.starts_with(prefixes[prefixIndex - 1])) {
+                prefixIndex--;
+                iter->Seek(target);
+                if (!inPrefix()) {
+                    prefixIndex++;
+                    seekPrefix();
+                }
+            }
+            else {
+                seekPrefix();
+            }
+        }
+        skipExcluded();
+    }
+
+    void RoiIterator::next()
+    {
+        do {
+            iter->Next();
+            if (!prefixes.empty() && !inPrefix()) {
+                prefixIndex++;
+                seekPrefix();
+            }
+        } while (valid() && roi.excludesKey(iter->key().data(), iter->key().size()));
+    }
+
+    bool RoiIterator::valid() const
+    {
+        if (prefixes.empty()) {
+            return iter->Valid();
+        }
+        return prefixIndex < prefixes.size() && iter->Valid();
+    }
+}
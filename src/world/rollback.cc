@@ -0,0 +1,134 @@
+#include "world/rollback.h"
+#include "world/chunk_key.h"
+#include "world/common.h"
+#include "logger.h"
+
+#include <memory>
+
+#include <leveldb/write_batch.h>
+
+namespace
+{
+    // the chunk records that make up what a player can change in a region, and the records that
+    // describe how the chunk was saved (version, finalized state, checksums)
+    bool isRestoredType(int32_t type)
+    {
+        return type == 0x2b || type == 0x2c || type == 0x2d || type == 0x2f || type == 0x31 || type == 0x32 ||
+            type == 0x36 || type == 0x3b || type == 0x76;
+    }
+
+    // a column that is only in one of the worlds is deleted or copied as a whole
+    bool isRestoredRecord(const leveldb::Slice& key, int32_t dimId, const mcpe_viz::ChunkRoi& roi, bool wholeColumn)
+    {
+        mcpe_viz::ChunkRecordKey ck;
+        if (!mcpe_viz::parseChunkRecordKey(key.data(), key.size(), ck) || ck.dimId != dimId) {
+            return false;
+        }
+        if (wholeColumn) {
+            return true;
+        }
+        if (!isRestoredType(ck.type)) {
+            return false;
+        }
+        return ck.type != 0x2f || (ck.subChunk >= 0 && roi.containsSubChunk(ck.subChunk));
+    }
+
+    // move to the next restored record of the chunk column (or past the column)
+    bool nextInColumn(leveldb::Iterator* iter, const std::string& prefix, int32_t dimId, const mcpe_viz::ChunkRoi& roi,
+        bool wholeColumn)
+    {
+        while (iter->Valid() && iter->key().starts_with(prefix)) {
+            if (isRestoredRecord(iter->key(), dimId, roi, wholeColumn)) {
+                return true;
+            }
+            iter->Next();
+        }
+        return false;
+    }
+}
+
+namespace mcpe_viz {
+
+    int32_t rollbackRegion(leveldb::DB* db, leveldb::DB* backupDb, int32_t dimId, const ChunkRoi& roi,
+        RollbackStats& stats)
+    {
+        if (!roi.useSeek()) {
+            log::error("Rollback needs --min-x, --max-x, --min-z and --max-z around at most {} chunks", uint64_t(ChunkRoi::kMaxSeekChunks));
+            return -1;
+        }
+
+        std::unique_ptr<leveldb::Iterator> iter(db->NewIterator(levelDbReadOptions));
+        std::unique_ptr<leveldb::Iterator> backupIter(backupDb->NewIterator(levelDbReadOptions));
+        leveldb::WriteBatch batch;
+        std::string firstKey, lastKey;
+        auto written = [&](const leveldb::Slice& key) {
+            if (firstKey.empty()) {
+                firstKey = key.ToString();
+            }
+            lastKey = key.ToString();
+        };
+
+        // the column prefixes are sorted, so both iterators only ever seek forward
+        for (const auto& prefix : roi.chunkPrefixes()) {
+            iter->Seek(prefix);
+            backupIter->Seek(prefix);
+            // both iterators stop at the first record of the column, which is not after any restored one
+            bool inTarget = nextInColumn(iter.get(), prefix, dimId, roi, true);
+            bool inBackup = nextInColumn(backupIter.get(), prefix, dimId, roi, true);
+            if (inTarget || inBackup) {
+                stats.chunks++;
+            }
+            const bool wholeColumn = !inTarget || !inBackup;
+            if (!wholeColumn) {
+                inTarget = nextInColumn(iter.get(), prefix, dimId, roi, false);
+                inBackup = nextInColumn(backupIter.get(), prefix, dimId, roi, false);
+            }
+            while (inTarget || inBackup) {
+                const int32_t order = !inTarget ? 1 : (!inBackup ? -1 : iter->key().compare(backupIter->key()));
+                if (order < 0) {
+                    batch.Delete(iter->key());
+                    written(iter->key());
+                    stats.deletedRecords++;
+                }
+                else if (order > 0 || iter->value() != backupIter->value()) {
+                    batch.Put(backupIter->key(), backupIter->value());
+                    written(backupIter->key());
+                    stats.restoredRecords++;
+                }
+                else {
+                    stats.unchangedRecords++;
+                }
+                if (order <= 0) {
+                    iter->Next();
+                    inTarget = nextInColumn(iter.get(), prefix, dimId, roi, wholeColumn);
+                }
+                if (order >= 0) {
+                    backupIter->Next();
+                    inBackup = nextInColumn(backupIter.get(), prefix, dimId, roi, wholeColumn);
+                }
+            }
+        }
+        if (!iter->status().ok() || !backupIter->status().ok()) {
+            log::error("LevelDB operation returned status={}", (iter->status().ok() ? backupIter->status() : iter->status()).ToString());
+            return -1;
+        }
+        iter.reset();
+        backupIter.reset();
+
+        if (firstKey.empty()) {
+            return 0;
+        }
+        // all or nothing
+        leveldb::WriteOptions options;
+        options.sync = true;
+        leveldb::Status status = db->Write(options, &batch);
+        if (!status.ok()) {
+            log::error("LevelDB operation returned status={}", status.ToString());
+            return -1;
+        }
+        // push the new records down and drop the replaced ones, so the world does not grow with every rollback
+        const leveldb::Slice begin(firstKey), end(lastKey);
+        db->CompactRange(&begin, &end);
+        return 0;
+    }
+}
@@ -0,0 +1,478 @@
+#include "world/subchunk_index.h"
+#include "world/chunk_key.h"
+#include "utils/fs.h"
+#include "utils/hash.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <leveldb/env.h>
+#include <leveldb/table.h>
+
+namespace
+{
+    const char kIndexMagic[4] = { 'B', 'V', 'I', 'X' };
+    const uint32_t kIndexVersion = 1;
+
+    void writeU64(std::ofstream& out, uint64_t v)
+    {
+        out.write((const char*)&v, sizeof(v));
+    }
+
+    void writeString(std::ofstream& out, const std::string& s)
+    {
+        writeU64(out, s.size());
+        out.write(s.data(), s.size());
+    }
+
+    bool readU64(std::ifstream& in, uint64_t& v)
+    {
+        return bool(in.read((char*)&v, sizeof(v)));
+    }
+
+    bool readString(std::ifstream& in, std::string& s)
+    {
+        uint64_t len;
+        if (!readU64(in, len) || len > 0x10000) {
+            return false;
+        }
+        s.resize(len);
+        return bool(in.read(&s[0], len));
+    }
+
+    // table keys are leveldb internal keys: the user key followed by 8 bytes of sequence number and type
+    std::string userKey(const leveldb::Slice& internalKey)
+    {
+        if (internalKey.size() < 8) {
+            return internalKey.ToString();
+        }
+        return std::string(internalKey.data(), internalKey.size() - 8);
+    }
+
+    // "leveldb.sstables" has one line per table: " number:size[smallest .. largest]"
+    // the keys in there are escaped for humans, so we only take the number and size from it
+    void parseTableList(const std::string& s, std::vector<std::pair<uint64_t, uint64_t>>& out)
+    {
+        std::istringstream in(s);
+        std::string line;
+        while (std::getline(in, line)) {
+            unsigned long long number, size;
+            if (line.size() > 1 && line[0] == ' ' && sscanf(line.c_str(), " %llu:%llu[", &number, &size) == 2) {
+                out.push_back({ number, size });
+            }
+        }
+    }
+}
+
+namespace mcpe_viz {
+
+    std::string SubChunkIndex::fileName(const std::string& dirWorld)
+    {
+        return dirWorld + "/bedrock_viz.index";
+    }
+
+    int32_t SubChunkIndex::open(leveldb::DB* db, const leveldb::Options& options, const std::string& dirWorld)
+    {
+        const std::string fn = fileName(dirWorld);
+        const std::string dirDb = dirWorld + "/db";
+        if (file_exists(fn) && load(fn) == 0) {
+            if (update(db, options, dirDb) != 0) {
+                return -1;
+            }
+        }
+        else {
+            log::info("  Building subchunk index for '{}'", dirWorld);
+            if (build(db, options, dirDb) != 0) {
+                return -1;
+            }
+        }
+        if (changedFlag) {
+            return save(fn);
+        }
+        return 0;
+    }
+
+    int32_t SubChunkIndex::load(const std::string& fn)
+    {
+        std::ifstream in(fn, std::ios::binary);
+        if (!in) {
+            return -1;
+        }
+
+        char magic[4];
+        uint64_t version;
+        if (!in.read(magic, 4) || memcmp(magic, kIndexMagic, 4) != 0 || !readU64(in, version) || version != kIndexVersion) {
+            log::warn("Ignoring subchunk index with unknown format (fn={})", fn);
+            return -1;
+        }
+
+        clearTree();
+        tables.clear();
+        leaves.clear();
+        uint64_t count;
+        if (!readU64(in, count)) {
+            return -1;
+        }
+        for (uint64_t i = 0; i < count; i++) {
+            TableInfo t;
+            if (!readU64(in, t.number) || !readU64(in, t.size) || !readString(in, t.smallest) || !readString(in, t.largest)) {
+                log::warn("Subchunk index is truncated (fn={})", fn);
+                return -1;
+            }
+            tables.push_back(t);
+        }
+        if (!readU64(in, count)) {
+            return -1;
+        }
+        for (uint64_t i = 0; i < count; i++) {
+            std::string key;
+            uint64_t hash;
+            if (!readString(in, key) || !readU64(in, hash)) {
+                log::warn("Subchunk index is truncated (fn={})", fn);
+                return -1;
+            }
+            leaves.emplace_hint(leaves.end(), key, hash);
+        }
+
+        rollUp();
+        changedFlag = false;
+        log::info("  Loaded subchunk index (fn={} tables={} subchunks={})", fn, tables.size(), leaves.size());
+        return 0;
+    }
+
+    int32_t SubChunkIndex::save(const std::string& fn) const
+    {
+        // write to a temporary file so that an interrupted run does not leave a broken index behind
+        const std::string fnTemp = fn + ".tmp";
+        std::ofstream out(fnTemp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            log::warn("Failed to write subchunk index (fn={})", fnTemp);
+            return -1;
+        }
+
+        out.write(kIndexMagic, 4);
+        writeU64(out, kIndexVersion);
+        writeU64(out, tables.size());
+        for (const auto& t : tables) {
+            writeU64(out, t.number);
+            writeU64(out, t.size);
+            writeString(out, t.smallest);
+            writeString(out, t.largest);
+        }
+        writeU64(out, leaves.size());
+        for (const auto& leaf : leaves) {
+            writeString(out, leaf.first);
+            writeU64(out, leaf.second);
+        }
+        out.close();
+        if (!out) {
+            log::warn("Failed to write subchunk index (fn={})", fnTemp);
+            return -1;
+        }
+
+        if (std::rename(fnTemp.c_str(), fn.c_str()) != 0) {
+            log::warn("Failed to rename subchunk index (fn={})", fn);
+            return -1;
+        }
+        return 0;
+    }
+
+    int32_t SubChunkIndex::readTables(leveldb::DB* db, const leveldb::Options& options, const std::string& dirDb,
+        std::vector<TableInfo>& current)
+    {
+        std::string prop;
+        if (!db->GetProperty("leveldb.sstables", &prop)) {
+            log::warn("Failed to get the table list of '{}'", dirDb);
+            return -1;
+        }
+        std::vector<std::pair<uint64_t, uint64_t>> numbers;
+        parseTableList(prop, numbers);
+
+        // tables are immutable, so a table we already know keeps its key range
+        std::map<uint64_t, const TableInfo*> known;
+        for (const auto& t : tables) {
+            known[t.number] = &t;
+        }
+
+        leveldb::Env* env = (options.env != nullptr) ? options.env : leveldb::Env::Default();
+        for (const auto& n : numbers) {
+            auto it = known.find(n.first);
+            if (it != known.end()) {
+                current.push_back(*it->second);
+                continue;
+            }
+
+            char buf[32];
+            snprintf(buf, sizeof(buf), "/%06llu.ldb", (unsigned long long)n.first);
+            std::string fn = dirDb + buf;
+            if (!env->FileExists(fn)) {
+                snprintf(buf, sizeof(buf), "/%06llu.sst", (unsigned long long)n.first);
+                fn = dirDb + buf;
+            }
+
+            leveldb::RandomAccessFile* file = nullptr;
+            leveldb::Table* table = nullptr;
+            leveldb::Status status = env->NewRandomAccessFile(fn, &file);
+            if (status.ok()) {
+                status = leveldb::Table::Open(options, file, n.second, &table);
+            }
+            if (!status.ok()) {
+                log::warn("Failed to open table (fn={} status={})", fn, status.ToString());
+                delete file;
+                return -1;
+            }
+
+            TableInfo t;
+            t.number = n.first;
+            t.size = n.second;
+            leveldb::Iterator* iter = table->NewIterator(leveldb::ReadOptions());
+            iter->SeekToFirst();
+            if (iter->Valid()) {
+                t.smallest = userKey(iter->key());
+                iter->SeekToLast();
+                t.largest = userKey(iter->key());
+                current.push_back(t);
+            }
+            delete iter;
+            delete table;
+            delete file;
+        }
+
+        std::sort(current.begin(), current.end(), [](const TableInfo& a, const TableInfo& b) {
+            return a.number < b.number;
+        });
+        return 0;
+    }
+
+    int32_t SubChunkIndex::rescan(leveldb::DB* db, const std::string& smallest, const std::string& largest)
+    {
+        // an empty largest key means "to the end of the db"
+        leaves.erase(leaves.lower_bound(smallest), largest.empty() ? leaves.end() : leaves.upper_bound(largest));
+
+        ChunkRecordKey ck;
+        leveldb::Iterator* iter = db->NewIterator(leveldb::ReadOptions());
+        for (iter->Seek(smallest); iter->Valid(); iter->Next()) {
+            const leveldb::Slice key = iter->key();
+            if (!largest.empty() && key.compare(largest) > 0) {
+                break;
+            }
+            if (!parseChunkRecordKey(key.data(), key.size(), ck) || ck.type != 0x2f || ck.subChunk < 0) {
+                continue;
+            }
+            const leveldb::Slice value = iter->value();
+            leaves.emplace_hint(leaves.end(), key.ToString(), hash64(value.data(), value.size()));
+        }
+
+        leveldb::Status status = iter->status();
+        delete iter;
+        if (!status.ok()) {
+            log::warn("LevelDB operation returned status={}", status.ToString());
+            return -1;
+        }
+        return 0;
+    }
+
+    int32_t SubChunkIndex::build(leveldb::DB* db, const leveldb::Options& options, const std::string& dirDb)
+    {
+        clearTree();
+        tables.clear();
+        leaves.clear();
+
+        std::vector<TableInfo> current;
+        if (readTables(db, options, dirDb, current) != 0) {
+            return -1;
+        }
+        if (rescan(db, std::string(), std::string()) != 0) {
+            return -1;
+        }
+
+        tables = current;
+        rollUp();
+        changedFlag = true;
+        return 0;
+    }
+
+    int32_t SubChunkIndex::update(leveldb::DB* db, const leveldb::Options& options, const std::string& dirDb)
+    {
+        std::vector<TableInfo> current;
+        if (readTables(db, options, dirDb, current) != 0) {
+            return -1;
+        }
+
+        // every key that was written or deleted since the last update is in a table we have not seen yet;
+        // tables that are gone were compacted into new ones, their old ranges may have lost keys
+        auto byNumber = [](const TableInfo& a, const TableInfo& b) { return a.number < b.number; };
+        std::vector<TableInfo> added, removed;
+        std::set_difference(current.begin(), current.end(), tables.begin(), tables.end(), std::back_inserter(added), byNumber);
+        std::set_difference(tables.begin(), tables.end(), current.begin(), current.end(), std::back_inserter(removed), byNumber);
+        if (added.empty() && removed.empty()) {
+            return 0;
+        }
+
+        std::vector<std::pair<std::string, std::string>> ranges;
+        for (const auto& t : added) {
+            ranges.push_back({ t.smallest, t.largest });
+        }
+        for (const auto& t : removed) {
+            ranges.push_back({ t.smallest, t.largest });
+        }
+        std::sort(ranges.begin(), ranges.end());
+
+        // merge overlapping ranges so that nothing is read twice
+        std::vector<std::pair<std::string, std::string>> merged;
+        for (const auto& r : ranges) {
+            if (!merged.empty() && r.first <= merged.back().second) {
+                merged.back().second = std::max(merged.back().second, r.second);
+            }
+            else {
+                merged.push_back(r);
+            }
+        }
+
+        log::info("  Updating subchunk index ({} new tables, {} removed tables, {} key ranges)",
+            added.size(), removed.size(), merged.size());
+        clearTree();
+        for (const auto& r : merged) {
+            if (rescan(db, r.first, r.second) != 0) {
+                return -1;
+            }
+        }
+
+        tables = current;
+        rollUp();
+        changedFlag = true;
+        return 0;
+    }
+
+    void SubChunkIndex::clearTree()
+    {
+        for (auto& dim : dims) {
+            dim = DimNode();
+        }
+    }
+
+    void SubChunkIndex::rollUp()
+    {
+        ChunkRecordKey ck;
+        clearTree();
+        for (const auto& leaf : leaves) {
+            if (!parseChunkRecordKey(leaf.first.data(), leaf.first.size(), ck)) {
+                continue;
+            }
+            const XZ regionPos(ck.chunkX >> kRegionShift, ck.chunkZ >> kRegionShift);
+            dims[ck.dimId].regions[regionPos].chunks[XZ(ck.chunkX, ck.chunkZ)].subChunks[ck.subChunk] = &leaf;
+        }
+
+        for (auto& dim : dims) {
+            for (auto& region : dim.regions) {
+                for (auto& chunk : region.second.chunks) {
+                    uint64_t h = 0;
+                    for (const auto& sub : chunk.second.subChunks) {
+                        h = hashCombine(hashCombine(h, uint64_t(sub.first)), sub.second->second);
+                    }
+                    chunk.second.hash = h;
+                    region.second.subChunkCount += chunk.second.subChunks.size();
+                }
+                uint64_t h = 0;
+                for (const auto& chunk : region.second.chunks) {
+                    h = hashCombine(h, uint64_t(uint32_t(chunk.first.first)) << 32 | uint32_t(chunk.first.second));
+                    h = hashCombine(h, chunk.second.hash);
+                }
+                region.second.hash = h;
+                dim.subChunkCount += region.second.subChunkCount;
+            }
+            uint64_t h = 0;
+            for (const auto& region : dim.regions) {
+                h = hashCombine(h, uint64_t(uint32_t(region.first.first)) << 32 | uint32_t(region.first.second));
+                h = hashCombine(h, region.second.hash);
+            }
+            dim.hash = h;
+        }
+    }
+
+    void diffSubChunkIndex(const SubChunkIndex& indexA, const SubChunkIndex& indexB, int32_t dimId,
+        SubChunkIndexDiff& diff)
+    {
+        const auto& dimA = indexA.dims[dimId];
+        const auto& dimB = indexB.dims[dimId];
+        if (dimA.hash == dimB.hash && dimA.subChunkCount == dimB.subChunkCount) {
+            diff.sharedChunks += dimA.subChunkCount;
+            diff.sameChunks += dimA.subChunkCount;
+            return;
+        }
+
+        // walk both trees side by side and only descend where the hashes differ
+        auto regionA = dimA.regions.begin();
+        auto regionB = dimB.regions.begin();
+        while (regionA != dimA.regions.end() || regionB != dimB.regions.end()) {
+            if (regionB == dimB.regions.end() || (regionA != dimA.regions.end() && regionA->first < regionB->first)) {
+                diff.addedChunks += regionA->second.subChunkCount;
+                ++regionA;
+                continue;
+            }
+            if (regionA == dimA.regions.end() || regionB->first < regionA->first) {
+                diff.removedChunks += regionB->second.subChunkCount;
+                ++regionB;
+                continue;
+            }
+
+            if (regionA->second.hash == regionB->second.hash && regionA->second.subChunkCount == regionB->second.subChunkCount) {
+                diff.sharedChunks += regionA->second.subChunkCount;
+                diff.sameChunks += regionA->second.subChunkCount;
+            }
+            else {
+                const auto& chunksA = regionA->second.chunks;
+                const auto& chunksB = regionB->second.chunks;
+                auto chunkA = chunksA.begin();
+                auto chunkB = chunksB.begin();
+                while (chunkA != chunksA.end() || chunkB != chunksB.end()) {
+                    if (chunkB == chunksB.end() || (chunkA != chunksA.end() && chunkA->first < chunkB->first)) {
+                        diff.addedChunks += chunkA->second.subChunks.size();
+                        ++chunkA;
+                        continue;
+                    }
+                    if (chunkA == chunksA.end() || chunkB->first < chunkA->first) {
+                        diff.removedChunks += chunkB->second.subChunks.size();
+                        ++chunkB;
+                        continue;
+                    }
+
+                    if (chunkA->second.hash == chunkB->second.hash && chunkA->second.subChunks.size() == chunkB->second.subChunks.size()) {
+                        diff.sharedChunks += chunkA->second.subChunks.size();
+                        diff.sameChunks += chunkA->second.subChunks.size();
+                    }
+                    else {
+                        for (const auto& sub : chunkA->second.subChunks) {
+                            auto other = chunkB->second.subChunks.find(sub.first);
+                            if (other == chunkB->second.subChunks.end()) {
+                                diff.addedChunks++;
+                                continue;
+                            }
+                            diff.sharedChunks++;
+                            if (other->second->second == sub.second->second) {
+                                diff.sameChunks++;
+                            }
+                            else {
+                                diff.changedKeys.push_back(sub.second->first);
+                            }
+                        }
+                        for (const auto& sub : chunkB->second.subChunks) {
+                            if (chunkA->second.subChunks.count(sub.first) == 0) {
+                                diff.removedChunks++;
+                            }
+                        }
+                    }
+                    ++chunkA;
+                    ++chunkB;
+                }
+            }
+            ++regionA;
+            ++regionB;
+        }
+
+        // the block list is reported in leveldb key order
+        std::sort(diff.changedKeys.begin(), diff.changedKeys.end());
+    }
+}
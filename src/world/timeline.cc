@@ -0,0 +1,163 @@
+#include "world/timeline.h"
+#include "world/chunk_key.h"
+#include "world/common.h"
+#include "world/db_merge.h"
+#include "world/palette.h"
+#include "world/roi.h"
+#include "define.h"
+#include "logger.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    const char kTimelineSame = '.';
+    const char kTimelineChanged = 'x';
+    const char kTimelineAdded = '+';
+    const char kTimelineRemoved = '-';
+
+    // a subchunk counts as unchanged if the record is the same or only differs in things other than the blocks
+    bool sameSubChunk(const leveldb::Slice& a, const leveldb::Slice& b, std::vector<mcpe_viz::BlockIdDiff>& diffs)
+    {
+        if (a.size() == b.size() && memcmp(a.data(), b.data(), a.size()) == 0) {
+            return true;
+        }
+        return mcpe_viz::comparePalettedSubChunks(a.data(), a.size(), b.data(), b.size(), diffs) == 0 && diffs.empty();
+    }
+
+    // a chunk column is 'changed' if its subchunks changed in different ways
+    char combineState(char prev, char state)
+    {
+        if (prev == kTimelineSame || prev == state) {
+            return state;
+        }
+        return kTimelineChanged;
+    }
+}
+
+namespace mcpe_viz {
+
+    int32_t generateTimeline(const std::vector<leveldb::DB*>& dbs, const std::vector<std::string>& names,
+        const std::string& fnOut)
+    {
+        const size_t pairCount = dbs.size() - 1;
+        std::ofstream out(fnOut);
+        if (!out) {
+            log::error("Failed to open output file (fn={})", fnOut);
+            return -1;
+        }
+
+        out << "TIMELINE SNAPSHOTS: " << dbs.size() << "\n";
+        for (size_t i = 0; i < names.size(); i++) {
+            out << "SNAPSHOT " << i << ": '" << names[i] << "'\n";
+        }
+        out << "CHUNK TIMELINES (dimension, chunkX, chunkZ, one character per snapshot after the first: '"
+            << kTimelineSame << "' same, '" << kTimelineChanged << "' changed, '" << kTimelineAdded << "' added, '"
+            << kTimelineRemoved << "' removed)\n";
+
+        std::vector<std::vector<TimelineStats>> stats(kDimIdCount, std::vector<TimelineStats>(dbs.size()));
+        std::vector<std::string> timelines(kDimIdCount, std::string(pairCount, kTimelineSame));
+        int32_t curChunkX = 0, curChunkZ = 0;
+        bool haveChunk = false;
+
+        // all records of a chunk column (in every dimension) share the same 8 byte key prefix,
+        // so a column is complete as soon as the prefix changes
+        auto flushChunk = [&]() {
+            for (int32_t dimId = 0; dimId < kDimIdCount; dimId++) {
+                auto& timeline = timelines[dimId];
+                if (timeline.find_first_not_of(kTimelineSame) == std::string::npos) {
+                    continue;
+                }
+                out << kDimIdNames[dimId] << " " << curChunkX << " " << curChunkZ << " " << timeline << "\n";
+                for (size_t i = 0; i < pairCount; i++) {
+                    if (timeline[i] != kTimelineSame) {
+                        stats[dimId][i + 1].changedChunks++;
+                    }
+                }
+                timeline.assign(pairCount, kTimelineSame);
+            }
+        };
+
+        const ChunkRoi roi = ChunkRoi::fromControl();
+        std::vector<BlockIdDiff> diffs;
+        ChunkRecordKey ck;
+        uint64_t recordCt = 0;
+
+        DbMultiMergeIterator iter(dbs, levelDbReadOptions);
+        for (iter.seekToFirst(); iter.valid(); iter.next()) {
+            const leveldb::Slice skey = iter.key();
+            if (!parseChunkRecordKey(skey.data(), skey.size(), ck) || ck.type != 0x2f || ck.subChunk < 0) {
+                continue;
+            }
+            if (roi.excludesKey(skey.data(), skey.size())) {
+                continue;
+            }
+
+            if (!haveChunk || ck.chunkX != curChunkX || ck.chunkZ != curChunkZ) {
+                if (haveChunk) {
+                    flushChunk();
+                }
+                curChunkX = ck.chunkX;
+                curChunkZ = ck.chunkZ;
+                haveChunk = true;
+            }
+
+            if ((++recordCt % 100000) == 0) {
+                log::info("  Processing subchunks: {}", recordCt);
+            }
+
+            auto& timeline = timelines[ck.dimId];
+            for (size_t i = 1; i < dbs.size(); i++) {
+                const bool inPrev = iter.in(i - 1);
+                const bool inCur = iter.in(i);
+                char state;
+                if (inPrev && inCur) {
+                    if (sameSubChunk(iter.value(i), iter.value(i - 1), diffs)) {
+                        continue;
+                    }
+                    state = kTimelineChanged;
+                    stats[ck.dimId][i].changedSubChunks++;
+                }
+                else if (inCur) {
+                    state = kTimelineAdded;
+                    stats[ck.dimId][i].addedSubChunks++;
+                }
+                else if (inPrev) {
+                    state = kTimelineRemoved;
+                    stats[ck.dimId][i].removedSubChunks++;
+                }
+                else {
+                    continue;
+                }
+                timeline[i - 1] = combineState(timeline[i - 1], state);
+            }
+        }
+        if (haveChunk) {
+            flushChunk();
+        }
+
+        if (!iter.status().ok()) {
+            log::warn("LevelDB operation returned status={}", iter.status().ToString());
+        }
+
+        out << "CHANGES PER SNAPSHOT (snapshot, dimension, changed subchunks, added subchunks, removed subchunks, changed chunks)\n";
+        for (size_t i = 1; i < dbs.size(); i++) {
+            TimelineStats total;
+            for (int32_t dimId = 0; dimId < kDimIdCount; dimId++) {
+                const auto& s = stats[dimId][i];
+                out << i << " " << kDimIdNames[dimId] << " " << s.changedSubChunks << " " << s.addedSubChunks << " "
+                    << s.removedSubChunks << " " << s.changedChunks << "\n";
+                total.changedSubChunks += s.changedSubChunks;
+                total.addedSubChunks += s.addedSubChunks;
+                total.removedSubChunks += s.removedSubChunks;
+                total.changedChunks += s.changedChunks;
+            }
+            log::info("  Snapshot {} ('{}'): {} changed, {} added, {} removed subchunks in {} chunks", i, names[i],
+                total.changedSubChunks, total.addedSubChunks, total.removedSubChunks, total.changedChunks);
+        }
+
+        out.close();
+        return 0;
+    }
+}
@@ -1,4 +1,10 @@
 #include "world/world.h"
+#include "world/roi.h"
+#include "world/db_merge.h"
+#include "world/timeline.h"
+#include "world/world_patch.h"
+#include "world/rollback.h"
+#include "world/read_only_db.h"
 #include "control.h"
 #include "nbt.h"
 #include "global.h"
@@ -8,7 +14,11 @@
 #include "minecraft/v2/biome.h"
 #include "minecraft/v2/block.h"
 
+#include <atomic>
+#include <cmath>
 #include <ctime>
+#include <filesystem>
+#include <thread>
 #include <leveldb/filter_policy.h>
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
@@ -32,6 +42,43 @@ namespace
         }
         return true;
     }
+
+    // move the coordinates of a geojson item by (dx, dy); the items are made while the world is parsed,
+    // before the image bounds are known
+    std::string moveGeojsonPoints(const std::string& json, double dx, double dy)
+    {
+        const std::string tag = "\"coordinates\":[";
+        const size_t start = json.find(tag);
+        if (start == std::string::npos) {
+            return json;
+        }
+        const size_t end = json.find("]}", start);
+        if (end == std::string::npos) {
+            return json;
+        }
+
+        // a Point is "x,y", a MultiPoint is "[x,y],[x,y],..."
+        std::string s = json.substr(0, start + tag.size());
+        char tmpstring[64];
+        bool xFlag = true;
+        for (size_t i = start + tag.size(); i < end; ) {
+            const char c = json[i];
+            if (c == '-' || (c >= '0' && c <= '9')) {
+                char* next;
+                const double v = strtod(&json[i], &next);
+                sprintf(tmpstring, "%.1lf", v + (xFlag ? dx : dy));
+                s += tmpstring;
+                xFlag = !xFlag;
+                i = size_t(next - json.data());
+            }
+            else {
+                s += c;
+                i++;
+            }
+        }
+        s += json.substr(end);
+        return s;
+    }
 }
 
 namespace mcpe_viz
@@ -39,6 +86,7 @@ namespace mcpe_viz
     MinecraftWorld_LevelDB::MinecraftWorld_LevelDB()
     {
         db = nullptr;
+        totalRecordCt = 0;
 
         levelDbReadOptions.fill_cache = false;
         // suggestion from leveldb/mcpe_sample_setup.cpp
@@ -145,16 +193,14 @@ namespace mcpe_viz
 
     int32_t MinecraftWorld_LevelDB::dbOpen(const std::string& dirDb)
     {
-        // todobig - leveldb read-only? snapshot?
-        // note: seems impossible, see <https://github.com/google/leveldb/issues/182>
-        log::info("DB Open: dir={}", dirDb);
-        leveldb::Status openstatus = leveldb::DB::Open(*dbOptions, std::string(dirDb + "/db"), &db);
+        log::info("DB Open: dir={}{}", dirDb, control.readOnlyDb ? " (read-only)" : "");
+        leveldb::Status openstatus = openDb(dirDb, &db);
         log::info("DB Open Status: {} (block_size={} bloom_filter_bits={})", openstatus.ToString(), control.leveldbBlockSize, control.leveldbFilter);
         fflush(stderr);
         if (!openstatus.ok()) {
             log::error("LevelDB operation returned status={}", openstatus.ToString());
             
-            if (control.tryDbRepair)
+            if (control.tryDbRepair && !control.readOnlyDb)
             {
                 log::info("Attempting leveldb repair due to failed open");
                 leveldb::Options options_;
@@ -172,6 +218,15 @@ namespace mcpe_viz
         return 0;
     }
 
+    leveldb::Status MinecraftWorld_LevelDB::openDb(const std::string& dirWorld, leveldb::DB** dbptr)
+    {
+        // read-only worlds are read without the leveldb LOCK, so a world in use by a server can be read
+        if (control.readOnlyDb) {
+            return openReadOnlyDb(*dbOptions, dirWorld + "/db", dbptr);
+        }
+        return leveldb::DB::Open(*dbOptions, dirWorld + "/db", dbptr);
+    }
+
 
     int32_t MinecraftWorld_LevelDB::calcChunkBounds()
     {
@@ -192,16 +247,23 @@ namespace mcpe_viz
         }
 
         int32_t chunkX = -1, chunkZ = -1, chunkDimId = -1, chunkType = -1;
+        ChunkBounds bounds[kDimIdCount];
 
         log::info("Scan keys to get world boundaries");
         int32_t recordCt = 0;
 
-        // todobig - is there a faster way to enumerate the keys?
-        leveldb::Iterator* iter = db->NewIterator(levelDbReadOptions);
+        // only chunks inside of the region of interest count, so the images are sized to it
+        const ChunkRoi roi = ChunkRoi::fromControl();
+        if (roi.active()) {
+            log::info("  Region of interest: chunks [X:{} => {}, Z:{} => {}], subchunks [{} => {}]{}",
+                roi.minChunkX, roi.maxChunkX, roi.minChunkZ, roi.maxChunkZ, roi.minSubChunk, roi.maxSubChunk,
+                roi.useSeek() ? "" : " (full scan)");
+        }
+        RoiIterator* iter = new RoiIterator(db, levelDbReadOptions, roi);
         leveldb::Slice skey;
         int32_t key_size;
         const char* key;
-        for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        for (iter->seekToFirst(); iter->valid(); iter->next()) {
             skey = iter->key();
             key_size = int32_t(skey.size());
             key = skey.data();
@@ -220,7 +282,7 @@ namespace mcpe_viz
                 if (chunkType == 0x30) {
                     // pre-0.17 chunk block data
                     if (legalChunkPos(chunkX, chunkZ)) {
-                        dimDataList[0]->addToChunkBounds(chunkX, chunkZ);
+                        bounds[0].add(chunkX, chunkZ);
                     }
                 }
             }
@@ -233,7 +295,7 @@ namespace mcpe_viz
                 // sanity checks
                 if (chunkType == 0x2f) {
                     if (legalChunkPos(chunkX, chunkZ)) {
-                        dimDataList[0]->addToChunkBounds(chunkX, chunkZ);
+                        bounds[0].add(chunkX, chunkZ);
                     }
                 }
             }
@@ -247,7 +309,7 @@ namespace mcpe_viz
                 // sanity checks
                 if (chunkType == 0x30) {
                     if (legalChunkPos(chunkX, chunkZ)) {
-                        dimDataList[chunkDimId]->addToChunkBounds(chunkX, chunkZ);
+                        bounds[chunkDimId].add(chunkX, chunkZ);
                     }
                 }
             }
@@ -261,7 +323,7 @@ namespace mcpe_viz
                 // sanity checks
                 if (chunkType == 0x2f) {
                     if (legalChunkPos(chunkX, chunkZ)) {
-                        dimDataList[chunkDimId]->addToChunkBounds(chunkX, chunkZ);
+                        bounds[chunkDimId].add(chunkX, chunkZ);
                     }
                 }
             }
@@ -272,11 +334,7 @@ namespace mcpe_viz
         }
         delete iter;
 
-        // mark bounds valid
-        for (int32_t i = 0; i < kDimIdCount; i++) {
-            dimDataList[i]->setChunkBoundsValid();
-            dimDataList[i]->reportChunkBounds();
-        }
+        setChunkBounds(bounds, roi);
 
         log::info("  {} records", recordCt);
         totalRecordCt = recordCt;
@@ -284,16 +342,47 @@ namespace mcpe_viz
         return 0;
     }
 
-    int32_t MinecraftWorld_LevelDB::dbParse()
+    void MinecraftWorld_LevelDB::setChunkBounds(const ChunkBounds bounds[kDimIdCount], const ChunkRoi& roi)
     {
-        char tmpstring[256];
-
-        int32_t chunkX = -1, chunkZ = -1, chunkDimId = -1, chunkType = -1, chunkTypeSub = -1;
-        int32_t chunkFormatVersion = 2; //todonow - get properly
-
+        for (int32_t dimId = 0; dimId < kDimIdCount; dimId++) {
+            ChunkBounds b;
+            if (bounds[dimId].empty()) {
+                b.add(0, 0);
+            }
+            else {
+                b = bounds[dimId];
+            }
+            if (roi.active()) {
+                b.minChunkX = std::min(std::max(b.minChunkX, roi.minChunkX), roi.maxChunkX);
+                b.maxChunkX = std::min(std::max(b.maxChunkX, roi.minChunkX), roi.maxChunkX);
+                b.minChunkZ = std::min(std::max(b.minChunkZ, roi.minChunkZ), roi.maxChunkZ);
+                b.maxChunkZ = std::min(std::max(b.maxChunkZ, roi.minChunkZ), roi.maxChunkZ);
+            }
+            dimDataList[dimId]->setChunkBounds(b.minChunkX, b.maxChunkX, b.minChunkZ, b.maxChunkZ);
+            dimDataList[dimId]->setChunkBoundsValid();
+            dimDataList[dimId]->reportChunkBounds();
+        }
+    }
 
-        // we make sure that we know the chunk bounds before we start so that we can translate world coords to image coords
-        calcChunkBounds();
+    int32_t MinecraftWorld_LevelDB::dbParse()
+    {
+        // the chunk bounds are collected while parsing, so the world is read once; until then the bounds of
+        // all dimensions are (0, 0), and the image coords of geojson items are moved afterwards
+        bool boundsValid = true;
+        for (int32_t dimId = 0; dimId < kDimIdCount; dimId++) {
+            if (!dimDataList[dimId]->getChunkBoundsValid()) {
+                boundsValid = false;
+            }
+        }
+        if (!boundsValid) {
+            for (int32_t dimId = 0; dimId < kDimIdCount; dimId++) {
+                dimDataList[dimId]->unsetChunkBoundsValid();
+            }
+            totalRecordCt = 0;
+        }
+        // set by the local player record
+        const double prevPlayerPositionImageX = playerPositionImageX, prevPlayerPositionImageY = playerPositionImageY;
+        playerPositionImageX = playerPositionImageY = std::nan("");
 
         // report hide and force lists
         {
@@ -336,8 +425,104 @@ namespace mcpe_viz
 
         log::info("Parse all leveldb records");
 
+        // split the key range so that several threads can parse it; all records of a chunk column share
+        // the column's key prefix, so each column is parsed by one thread
+        // the parts are merged in key order, so the output does not depend on the number of threads
+        int32_t threadCount = control.threadCount;
+        if (threadCount <= 0) {
+            threadCount = std::max(1, int32_t(std::thread::hardware_concurrency()));
+        }
+        const ChunkRoi roi = ChunkRoi::fromControl();
+        if (roi.active()) {
+            log::info("  Region of interest: chunks [X:{} => {}, Z:{} => {}], subchunks [{} => {}]{}",
+                roi.minChunkX, roi.maxChunkX, roi.minChunkZ, roi.maxChunkZ, roi.minSubChunk, roi.maxSubChunk,
+                roi.useSeek() ? "" : " (full scan)");
+        }
+        std::vector<std::string> splitKeys;
+        // (a small region of interest is read with seeks, and --shortrun needs the records in order)
+        if (threadCount > 1 && !roi.useSeek() && !control.shortRunFlag) {
+            splitKeys = splitKeyRange(db, threadCount * 4);
+        }
+        std::vector<std::unique_ptr<ParsePart>> parts(splitKeys.size() + 1);
+        for (size_t i = 0; i < parts.size(); i++) {
+            parts[i] = std::make_unique<ParsePart>();
+            parts[i]->startKey = (i == 0) ? std::string() : splitKeys[i - 1];
+            parts[i]->endKey = (i < splitKeys.size()) ? splitKeys[i] : std::string();
+        }
+        if (parts.size() > 1) {
+            log::info("  Parsing {} key ranges with {} threads", parts.size(), std::min(threadCount, int32_t(parts.size())));
+        }
+
+        // geojson items go to a list per thread (see global.h); keep the ones we already have
+        std::vector<GeoJsonItem> geoJSON;
+        geoJSON.swap(listGeoJSON);
+
+        parsedRecordCt = 0;
+        std::atomic<size_t> nextPart(0);
+        auto worker = [&]() {
+            for (size_t i = nextPart++; i < parts.size(); i = nextPart++) {
+                dbParseRange(roi, *parts[i]);
+                parts[i]->geoJSON.swap(listGeoJSON);
+                listGeoJSON.clear();
+            }
+        };
+        std::vector<std::thread> workers;
+        for (int32_t t = 1; t < std::min(threadCount, int32_t(parts.size())); t++) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto& t : workers) {
+            t.join();
+        }
+
+        // merge the parts in key order
+        int32_t recordCt = 0;
+        ChunkBounds bounds[kDimIdCount];
+        for (auto& part : parts) {
+            for (int32_t dimId = 0; dimId < kDimIdCount; dimId++) {
+                dimDataList[dimId]->mergeChunks(part->chunks[dimId]);
+                bounds[dimId].merge(part->bounds[dimId]);
+            }
+            geoJSON.insert(geoJSON.end(), std::make_move_iterator(part->geoJSON.begin()),
+                std::make_move_iterator(part->geoJSON.end()));
+            recordCt += part->recordCt;
+            part.reset();
+        }
+        log::info("Read {} records", recordCt);
+
+        if (!boundsValid) {
+            setChunkBounds(bounds, roi);
+            totalRecordCt = recordCt;
+
+            // image coords were made with bounds of (0, 0); see DimensionData_LevelDB::worldPointToImagePoint
+            for (auto& item : geoJSON) {
+                const auto& dimData = dimDataList[std::max(item.dimId, 0)];
+                item.json = moveGeojsonPoints(item.json, -dimData->getMinChunkX() * 16.0, dimData->getMaxChunkZ() * 16.0);
+            }
+            if (!std::isnan(playerPositionImageX)) {
+                const auto& dimData = dimDataList[std::max(playerPositionDimensionId, 0)];
+                playerPositionImageX += -dimData->getMinChunkX() * 16.0;
+                playerPositionImageY += dimData->getMaxChunkZ() * 16.0;
+            }
+        }
+        if (std::isnan(playerPositionImageX)) {
+            playerPositionImageX = prevPlayerPositionImageX;
+            playerPositionImageY = prevPlayerPositionImageY;
+        }
+        listGeoJSON.swap(geoJSON);
+
+        return 0;
+    }
+
+    int32_t MinecraftWorld_LevelDB::dbParseRange(const ChunkRoi& roi, ParsePart& part)
+    {
+        char tmpstring[256];
+
+        int32_t chunkX = -1, chunkZ = -1, chunkDimId = -1, chunkType = -1, chunkTypeSub = -1;
+        int32_t chunkFormatVersion = 2; //todonow - get properly
+
         MyNbtTagList tagList;
-        int32_t recordCt = 0, ret;
+        int32_t ret;
 
         leveldb::Slice skey, svalue;
         size_t key_size;
@@ -346,25 +531,54 @@ namespace mcpe_viz
         const char* cdata;
         std::string dimName, chunkstr;
 
-        leveldb::Iterator* iter = db->NewIterator(levelDbReadOptions);
-        for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        // the paletted subchunks of the current chunk, when only its top blocks are needed (see topBlocksOnly)
+        // (the records of a chunk are next to each other, so the chunk is complete when another one starts)
+        std::vector<SubChunkRecord> topSubChunks;
+        size_t topCount = 0;
+        int32_t topDimId = -1, topChunkX = 0, topChunkZ = 0;
+        auto flushTopSubChunks = [&]() {
+            if (topCount > 0) {
+                dimDataList[topDimId]->addChunkTop_v7(part.chunks[topDimId], topChunkX, topChunkZ, topSubChunks.data(), topCount);
+                topCount = 0;
+            }
+        };
+
+        // records outside of the region of interest are not read at all
+        RoiIterator* iter = new RoiIterator(db, levelDbReadOptions, roi);
+        if (part.startKey.empty()) {
+            iter->seekToFirst();
+        }
+        else {
+            iter->seek(part.startKey);
+        }
+        for (; iter->valid(); iter->next()) {
 
             // note: we get the raw buffer early to avoid overhead (maybe?)
             skey = iter->key();
             key_size = (int)skey.size();
             key = skey.data();
 
+            if (!part.endKey.empty() && skey.compare(part.endKey) >= 0) {
+                break;
+            }
+
             svalue = iter->value();
             cdata_size = svalue.size();
             cdata = svalue.data();
 
-            ++recordCt;
-            if (control.shortRunFlag && recordCt > 1000) {
+            ++part.recordCt;
+            if (control.shortRunFlag && part.recordCt > 1000) {
                 break;
             }
+            const int32_t recordCt = ++parsedRecordCt;
             if ((recordCt % 10000) == 0) {
-                double pct = (double)recordCt / (double)totalRecordCt;
-                log::info("  Processing records: {} / {} ({:.1f}%)", recordCt, totalRecordCt, pct * 100.0);
+                if (totalRecordCt > 0) {
+                    double pct = (double)recordCt / (double)totalRecordCt;
+                    log::info("  Processing records: {} / {} ({:.1f}%)", recordCt, totalRecordCt, pct * 100.0);
+                }
+                else {
+                    log::info("  Processing records: {}", recordCt);
+                }
             }
 
             // we look at the key to determine what we have, some records have text keys
@@ -559,12 +773,17 @@ namespace mcpe_viz
                     continue;
                 }
 
+                // chunk bounds come from the block data records (see calcChunkBounds)
+                if ((chunkType == 0x30 && (key_size == 9 || key_size == 13)) || (chunkType == 0x2f && (key_size == 10 || key_size == 14))) {
+                    part.bounds[chunkDimId].add(chunkX, chunkZ);
+                }
+
                 // report info about the chunk
                 chunkstr = dimName + "-chunk: ";
                 sprintf(tmpstring, "%d %d (type=0x%02x) (subtype=0x%02x) (size=%d)", chunkX, chunkZ, chunkType,
                     chunkTypeSub, (int32_t)cdata_size);
                 chunkstr += tmpstring;
-                if (true) {
+                if (dimDataList[chunkDimId]->getChunkBoundsValid()) {
                     // show approximate image coordinates for chunk
                     double tix, tiy;
                     dimDataList[chunkDimId]->worldPointToImagePoint(chunkX * 16, chunkZ * 16, tix, tiy, false);
@@ -584,7 +803,7 @@ namespace mcpe_viz
                     // chunk block data
                     // we do the parsing in the destination object to save memcpy's
                     // todonow - would be better to get the version # from the proper chunk record (0x76)
-                    dimDataList[chunkDimId]->addChunk(2, chunkX, 0, chunkZ, cdata, cdata_size);
+                    dimDataList[chunkDimId]->addChunk(part.chunks[chunkDimId], 2, chunkX, 0, chunkZ, cdata, cdata_size);
                     break;
 
                 case 0x31:
@@ -715,15 +934,29 @@ namespace mcpe_viz
                 {
                     int32_t chunkY = chunkTypeSub;
                     // check the first byte to see if anything interesting is in it
-                    if (cdata[0] != 0) {
+                    if (cdata[0] != 0 && dimDataList[chunkDimId]->topBlocksOnly()) {
+                        if (topCount > 0 && (topDimId != chunkDimId || topChunkX != chunkX || topChunkZ != chunkZ)) {
+                            flushTopSubChunks();
+                        }
+                        topDimId = chunkDimId;
+                        topChunkX = chunkX;
+                        topChunkZ = chunkZ;
+                        if (topCount == topSubChunks.size()) {
+                            topSubChunks.emplace_back();
+                        }
+                        topSubChunks[topCount].chunkY = chunkY;
+                        topSubChunks[topCount].value.assign(cdata, cdata_size);
+                        topCount++;
+                    }
+                    else if (cdata[0] != 0) {
                         //logger.msg(kLogInfo1, "WARNING: UNKNOWN Byte 0 of 0x2f chunk: b0=[%d 0x%02x]\n", (int)cdata[0], (int)cdata[0]);
-                        dimDataList[chunkDimId]->addChunk(7, chunkX, chunkY, chunkZ, cdata, cdata_size);
+                        dimDataList[chunkDimId]->addChunk(part.chunks[chunkDimId], 7, chunkX, chunkY, chunkZ, cdata, cdata_size);
                     }
                     else {
                         if (cdata_size != 6145 && cdata_size != 10241) {
                             log::warn("UNKNOWN cdata_size={} of 0x2f chunk", cdata_size);
                         }
-                        dimDataList[chunkDimId]->addChunk(chunkFormatVersion, chunkX, chunkY, chunkZ, cdata,
+                        dimDataList[chunkDimId]->addChunk(part.chunks[chunkDimId], chunkFormatVersion, chunkX, chunkY, chunkZ, cdata,
                             cdata_size);
                     }
                 }
@@ -740,7 +973,7 @@ namespace mcpe_viz
 
                     // todonow - would be better to get the version # from the proper chunk record (0x76)
                 {
-                    dimDataList[chunkDimId]->addChunkColumnData(3, chunkX, chunkZ, cdata, int32_t(cdata_size));
+                    dimDataList[chunkDimId]->addChunkColumnData(part.chunks[chunkDimId], 3, chunkX, chunkZ, cdata, int32_t(cdata_size));
                 }
                 break;
 
@@ -798,8 +1031,8 @@ namespace mcpe_viz
                 printKeyValue(key, int32_t(key_size), cdata, int32_t(cdata_size), true);
             }
         }
-        log::info("Read {} records", recordCt);
-        log::info("Status: {}", iter->status().ToString());
+        flushTopSubChunks();
+        log::debug("Read {} records, status: {}", part.recordCt, iter->status().ToString());
 
         if (!iter->status().ok()) {
             log::warn("LevelDB operation returned status={}", iter->status().ToString());
@@ -817,7 +1050,7 @@ namespace mcpe_viz
         leveldb::DB *emptyWorld = nullptr;
         if (control.emptyDbName != "<none>")
         {
-            leveldb::Status openstatus = leveldb::DB::Open(*dbOptions, std::string(control.emptyDbName + "/db"), &emptyWorld);
+            leveldb::Status openstatus = openDb(control.emptyDbName, &emptyWorld);
             log::info("DB Open Status: {} (block_size={} bloom_filter_bits={})", openstatus.ToString(), control.leveldbBlockSize, control.leveldbFilter);
             fflush(stderr);
             if (!openstatus.ok()) {
@@ -825,12 +1058,142 @@ namespace mcpe_viz
             }
         }
 
+        // with a subchunk index for both worlds the block list only has to look at subchunks that changed
+        std::unique_ptr<SubChunkIndexDiff[]> indexDiffs;
+        // (the entity diff needs all records, so it always scans the world; a read-only world may have records
+        // that are only in its logs, which the index does not see)
+        if (emptyWorld != nullptr && !control.entityDiff && !control.readOnlyDb && (control.buildIndex ||
+            (file_exists(SubChunkIndex::fileName(control.dirLeveldb)) && file_exists(SubChunkIndex::fileName(control.emptyDbName)))))
+        {
+            SubChunkIndex index, emptyIndex;
+            if (index.open(db, *dbOptions, control.dirLeveldb) == 0 && emptyIndex.open(emptyWorld, *dbOptions, control.emptyDbName) == 0) {
+                indexDiffs = std::make_unique<SubChunkIndexDiff[]>(kDimIdCount);
+                for (int32_t i = 0; i < kDimIdCount; i++) {
+                    diffSubChunkIndex(index, emptyIndex, i, indexDiffs[i]);
+                }
+            }
+            else {
+                log::warn("Failed to prepare the subchunk index, comparing the whole world");
+            }
+        }
+
         for (int32_t i = 0; i < kDimIdCount; i++) {
-            dimDataList[i]->doOutput(db, emptyWorld);
+            dimDataList[i]->doOutput(db, emptyWorld, indexDiffs ? &indexDiffs[i] : nullptr);
         }
 
         return 0;
     }
 
+    int32_t MinecraftWorld_LevelDB::doOutput_Timeline(const std::vector<std::string>& dirs)
+    {
+        std::vector<leveldb::DB*> dbs;
+        int32_t ret = 0;
+        for (const auto& dir : dirs) {
+            leveldb::DB* snapshot = nullptr;
+            log::info("DB Open: dir={}", dir);
+            leveldb::Status openstatus = openDb(dir, &snapshot);
+            if (!openstatus.ok()) {
+                log::error("LevelDB operation returned status={}", openstatus.ToString());
+                ret = -1;
+                break;
+            }
+            dbs.push_back(snapshot);
+        }
+
+        if (ret == 0) {
+            const std::string fnOut = (control.outputDir / "bedrock_viz.timeline.txt").generic_string();
+            log::info("Writing timeline of {} snapshots to {}", dirs.size(), fnOut);
+            ret = generateTimeline(dbs, dirs, fnOut);
+        }
+
+        for (auto snapshot : dbs) {
+            delete snapshot;
+        }
+        return ret;
+    }
+
+    int32_t MinecraftWorld_LevelDB::makePatch(const std::string& fn)
+    {
+        if (db == nullptr) {
+            return -1;
+        }
+        leveldb::DB* baseDb = nullptr;
+        log::info("DB Open: dir={}", control.emptyDbName);
+        leveldb::Status openstatus = openDb(control.emptyDbName, &baseDb);
+        if (!openstatus.ok()) {
+            log::error("LevelDB operation returned status={}", openstatus.ToString());
+            return -1;
+        }
+        log::info("Writing world patch to {}", fn);
+        int32_t ret = writeWorldPatch(db, baseDb, fn);
+        delete baseDb;
+        return ret;
+    }
+
+    int32_t MinecraftWorld_LevelDB::applyPatch(const std::string& fn)
+    {
+        if (db == nullptr) {
+            return -1;
+        }
+        log::info("Applying world patch {}", fn);
+        return applyWorldPatch(db, fn);
+    }
+
+    int32_t MinecraftWorld_LevelDB::rollback(const std::string& dirBackup)
+    {
+        if (db == nullptr) {
+            return -1;
+        }
+        leveldb::DB* backupDb = nullptr;
+        log::info("DB Open: dir={}", dirBackup);
+        leveldb::Status openstatus = openReadOnlyDb(*dbOptions, dirBackup + "/db", &backupDb);
+        if (!openstatus.ok()) {
+            log::error("LevelDB operation returned status={}", openstatus.ToString());
+            return -1;
+        }
+        const ChunkRoi roi = ChunkRoi::fromControl();
+        log::info("Restoring {} chunks x={}..{} z={}..{} subchunks={}..{} from {}", kDimIdNames[control.rollbackDimId],
+            roi.minChunkX, roi.maxChunkX, roi.minChunkZ, roi.maxChunkZ, roi.minSubChunk, roi.maxSubChunk, dirBackup);
+        RollbackStats stats;
+        int32_t ret = rollbackRegion(db, backupDb, control.rollbackDimId, roi, stats);
+        if (ret == 0) {
+            log::info("Rollback: {} records restored, {} deleted, {} unchanged in {} chunks",
+                stats.restoredRecords, stats.deletedRecords, stats.unchangedRecords, stats.chunks);
+        }
+        delete backupDb;
+        return ret;
+    }
+
+    int32_t MinecraftWorld_LevelDB::prune(const std::vector<KeepArea>& keepAreas)
+    {
+        if (db == nullptr) {
+            return -1;
+        }
+        auto diskSize = [&]() {
+            uint64_t size = 0;
+            std::error_code ec;
+            for (const auto& entry : std::filesystem::directory_iterator(control.dirLeveldb + "/db", ec)) {
+                if (entry.is_regular_file(ec)) {
+                    size += entry.file_size(ec);
+                }
+            }
+            return size;
+        };
+        for (const auto& area : keepAreas) {
+            log::info("Keeping {} chunks x={}..{} z={}..{}", kDimIdNames[area.dimId],
+                area.minChunkX, area.maxChunkX, area.minChunkZ, area.maxChunkZ);
+        }
+        const uint64_t sizeBefore = diskSize();
+        PruneStats stats;
+        int32_t ret = pruneWorld(db, keepAreas, stats);
+        if (ret == 0) {
+            const uint64_t sizeAfter = diskSize();
+            log::info("Prune: deleted {} chunks ({} records, {} bytes), kept {} records; db size {} -> {} bytes ({} bytes reclaimed)",
+                stats.deletedChunks, stats.deletedRecords, stats.deletedBytes, stats.keptRecords, sizeBefore, sizeAfter,
+                sizeBefore > sizeAfter ? sizeBefore - sizeAfter : 0);
+        }
+        return ret;
+    }
+
     std::unique_ptr<MinecraftWorld_LevelDB> world;
 }
@@ -0,0 +1,313 @@
+#include "world/world_patch.h"
+#include "world/common.h"
+#include "world/db_merge.h"
+#include "utils/hash.h"
+#include "logger.h"
+
+#include <cstring>
+#include <fstream>
+
+#include <leveldb/write_batch.h>
+#include <zlib.h>
+
+namespace
+{
+    const char kPatchMagic[4] = { 'B', 'V', 'P', 'T' };
+    // patches are applied in batches of about this many bytes
+    const size_t kPatchBatchSize = 4 * 1024 * 1024;
+
+    template<typename T>
+    void writeValue(std::ostream& out, T v)
+    {
+        out.write((const char*)&v, sizeof(T));
+    }
+
+    template<typename T>
+    bool readValue(std::istream& in, T& v)
+    {
+        return bool(in.read((char*)&v, sizeof(T)));
+    }
+
+    bool deflateValue(const char* data, size_t size, std::string& out)
+    {
+        uLongf len = compressBound(uLong(size));
+        out.resize(len);
+        if (compress2((Bytef*)&out[0], &len, (const Bytef*)data, uLong(size), Z_BEST_SPEED) != Z_OK) {
+            return false;
+        }
+        out.resize(len);
+        return true;
+    }
+
+    bool inflateValue(const std::string& data, size_t size, std::string& out)
+    {
+        out.resize(size);
+        uLongf len = uLongf(size);
+        if (size == 0) {
+            return true;
+        }
+        return uncompress((Bytef*)&out[0], &len, (const Bytef*)data.data(), uLong(data.size())) == Z_OK && len == size;
+    }
+
+    // value xor base; the base is cut off or padded with zeros to the size of the value
+    void xorValue(const char* value, size_t size, const leveldb::Slice& base, std::string& out)
+    {
+        out.assign(value, size);
+        const size_t shared = std::min(size, base.size());
+        for (size_t i = 0; i < shared; i++) {
+            out[i] ^= base.data()[i];
+        }
+    }
+
+    struct PatchRecord {
+        uint8_t op;
+        std::string key;
+        uint64_t baseHash;
+        uint64_t valueHash;
+        uint32_t valueSize;
+        std::string data;
+    };
+
+    // read the next record; false if the file is damaged
+    bool readRecord(std::istream& in, PatchRecord& r)
+    {
+        if (!readValue(in, r.op)) {
+            return false;
+        }
+        if (r.op == mcpe_viz::kPatchEnd) {
+            return true;
+        }
+        if (r.op != mcpe_viz::kPatchPut && r.op != mcpe_viz::kPatchDelta && r.op != mcpe_viz::kPatchDelete) {
+            return false;
+        }
+        uint32_t keySize;
+        if (!readValue(in, keySize)) {
+            return false;
+        }
+        r.key.resize(keySize);
+        if (keySize > 0 && !in.read(&r.key[0], keySize)) {
+            return false;
+        }
+        if (r.op == mcpe_viz::kPatchDelete) {
+            return true;
+        }
+        if (r.op == mcpe_viz::kPatchDelta && !readValue(in, r.baseHash)) {
+            return false;
+        }
+        if (!readValue(in, r.valueHash)) {
+            return false;
+        }
+        uint32_t dataSize;
+        if (!readValue(in, r.valueSize) || !readValue(in, dataSize)) {
+            return false;
+        }
+        r.data.resize(dataSize);
+        return dataSize == 0 || bool(in.read(&r.data[0], dataSize));
+    }
+
+    // the value a put or delta record writes (base is the current value of a delta record's key);
+    // false if the record is damaged
+    bool decodeValue(const PatchRecord& r, const std::string& base, std::string& delta, std::string& value)
+    {
+        if (r.op == mcpe_viz::kPatchPut) {
+            if (!inflateValue(r.data, r.valueSize, value)) {
+                return false;
+            }
+        }
+        else {
+            if (!inflateValue(r.data, r.valueSize, delta)) {
+                return false;
+            }
+            xorValue(delta.data(), delta.size(), base, value);
+        }
+        return mcpe_viz::hash64(value.data(), value.size()) == r.valueHash;
+    }
+
+    bool openPatch(const std::string& fn, std::ifstream& in)
+    {
+        in.open(fn, std::ios::binary);
+        char magic[4];
+        uint32_t version;
+        if (!in || !in.read(magic, 4) || memcmp(magic, kPatchMagic, 4) != 0 || !readValue(in, version)) {
+            mcpe_viz::log::error("Not a world patch (fn={})", fn);
+            return false;
+        }
+        if (version != mcpe_viz::kWorldPatchVersion) {
+            mcpe_viz::log::error("Unsupported world patch version {} (fn={})", version, fn);
+            return false;
+        }
+        return true;
+    }
+}
+
+namespace mcpe_viz {
+
+    int32_t writeWorldPatch(leveldb::DB* db, leveldb::DB* baseDb, const std::string& fn)
+    {
+        std::ofstream out(fn, std::ios::binary);
+        if (!out) {
+            log::error("Failed to open output file (fn={})", fn);
+            return -1;
+        }
+        out.write(kPatchMagic, 4);
+        writeValue(out, kWorldPatchVersion);
+
+        uint64_t recordCt = 0, keyCt = 0, putCt = 0, deltaCt = 0, deleteCt = 0;
+        std::string raw, delta, xored;
+        DbMergeIterator iter(db, baseDb, levelDbReadOptions, true);
+        for (iter.seekToFirst(); iter.valid(); iter.next()) {
+            if ((++keyCt % 100000) == 0) {
+                log::info("  Processing records: {}", keyCt);
+            }
+            const leveldb::Slice key = iter.key();
+            if (!iter.inA()) {
+                writeValue(out, uint8_t(kPatchDelete));
+                writeValue(out, uint32_t(key.size()));
+                out.write(key.data(), key.size());
+                deleteCt++;
+                recordCt++;
+                continue;
+            }
+
+            const leveldb::Slice value = iter.valueA();
+            if (!deflateValue(value.data(), value.size(), raw)) {
+                log::error("Failed to compress a record");
+                return -1;
+            }
+            bool useDelta = false;
+            uint64_t baseHash = 0;
+            if (iter.inB()) {
+                const leveldb::Slice base = iter.valueB();
+                if (value == base) {
+                    continue;
+                }
+                // most changed records keep most of their bytes, so the xor is mostly zeros
+                xorValue(value.data(), value.size(), base, xored);
+                if (!deflateValue(xored.data(), xored.size(), delta)) {
+                    log::error("Failed to compress a record");
+                    return -1;
+                }
+                useDelta = delta.size() < raw.size();
+                baseHash = hash64(base.data(), base.size());
+            }
+
+            writeValue(out, uint8_t(useDelta ? kPatchDelta : kPatchPut));
+            writeValue(out, uint32_t(key.size()));
+            out.write(key.data(), key.size());
+            if (useDelta) {
+                writeValue(out, baseHash);
+            }
+            writeValue(out, hash64(value.data(), value.size()));
+            const std::string& data = useDelta ? delta : raw;
+            writeValue(out, uint32_t(value.size()));
+            writeValue(out, uint32_t(data.size()));
+            out.write(data.data(), data.size());
+            if (useDelta) {
+                deltaCt++;
+            }
+            else {
+                putCt++;
+            }
+            recordCt++;
+        }
+        if (!iter.status().ok()) {
+            log::error("LevelDB operation returned status={}", iter.status().ToString());
+            return -1;
+        }
+
+        writeValue(out, uint8_t(kPatchEnd));
+        writeValue(out, recordCt);
+        out.close();
+        if (!out) {
+            log::error("Failed to write world patch (fn={})", fn);
+            return -1;
+        }
+        log::info("World patch: {} new or changed records ({} as delta), {} deleted records, {} records in total",
+            putCt + deltaCt, deltaCt, deleteCt, keyCt);
+        return 0;
+    }
+
+    int32_t applyWorldPatch(leveldb::DB* db, const std::string& fn)
+    {
+        std::ifstream in;
+        if (!openPatch(fn, in)) {
+            return -1;
+        }
+        const std::streampos firstRecord = in.tellg();
+
+        // check the whole patch first, so a wrong base world or a damaged patch does not leave the world half patched
+        PatchRecord r;
+        std::string base, value, delta;
+        uint64_t recordCt = 0;
+        while (true) {
+            if (!readRecord(in, r)) {
+                log::error("World patch is damaged (fn={})", fn);
+                return -1;
+            }
+            if (r.op == kPatchEnd) {
+                break;
+            }
+            if (r.op == kPatchDelta) {
+                leveldb::Status status = db->Get(levelDbReadOptions, r.key, &base);
+                if (!status.ok() || hash64(base.data(), base.size()) != r.baseHash) {
+                    log::error("The world does not match the base world of the patch");
+                    return -1;
+                }
+            }
+            if (r.op != kPatchDelete && !decodeValue(r, base, delta, value)) {
+                log::error("World patch is damaged (fn={})", fn);
+                return -1;
+            }
+            recordCt++;
+        }
+        uint64_t expectedCt;
+        if (!readValue(in, expectedCt) || expectedCt != recordCt) {
+            log::error("World patch is damaged (fn={})", fn);
+            return -1;
+        }
+
+        in.clear();
+        in.seekg(firstRecord);
+        leveldb::WriteBatch batch;
+        uint64_t appliedCt = 0;
+        auto writeBatch = [&](bool sync) {
+            leveldb::WriteOptions options;
+            options.sync = sync;
+            leveldb::Status status = db->Write(options, &batch);
+            batch.Clear();
+            if (!status.ok()) {
+                log::error("LevelDB operation returned status={}", status.ToString());
+                return false;
+            }
+            return true;
+        };
+        while (readRecord(in, r) && r.op != kPatchEnd) {
+            if (r.op == kPatchDelete) {
+                batch.Delete(r.key);
+            }
+            else {
+                // (checked above; this only fails if the file or the world changed since)
+                if (r.op == kPatchDelta && !db->Get(levelDbReadOptions, r.key, &base).ok()) {
+                    log::error("The world does not match the base world of the patch");
+                    return -1;
+                }
+                if (!decodeValue(r, base, delta, value)) {
+                    log::error("World patch is damaged (fn={})", fn);
+                    return -1;
+                }
+                batch.Put(r.key, value);
+            }
+            if ((++appliedCt % 100000) == 0) {
+                log::info("  Applying records: {} of {}", appliedCt, recordCt);
+            }
+            if (batch.ApproximateSize() >= kPatchBatchSize && !writeBatch(false)) {
+                return -1;
+            }
+        }
+        if (!writeBatch(true)) {
+            return -1;
+        }
+        log::info("World patch: applied {} records", appliedCt);
+        return 0;
+    }
+}
@@ -1,5 +1,6 @@
 #include "xml/load_block.h"
 #include "minecraft/v2/block.h"
+#include "minecraft/v2/block_table.h"
 #include "logger.h"
 #include "util.h"
 
@@ -91,6 +92,7 @@ namespace mcpe_viz
                 
             }
         }
+        BlockTable::build();
         return 0;
     }
 }
@@ -0,0 +1,79 @@
+#include "world/block_diff_file.h"
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace mcpe_viz;
+
+namespace {
+    // write entries for (chunkX, chunkZ, subChunk) to a part file, like BlockListPart does
+    void writePart(const std::string& fn, const std::vector<std::vector<int32_t>>& subChunks,
+                   std::vector<BlockDiffChunk>& chunks) {
+        std::ofstream out(fn, std::ios::binary);
+        BlockDiffEntryBuilder builder;
+        uint64_t size = 0;
+        for (const auto& sc : subChunks) {
+            builder.reset(sc[0], sc[1], sc[2]);
+            builder.add(0, 1, 2);
+            builder.add(17, 1, 3);
+            builder.add(4095, 0, 2);
+            if (chunks.empty() || chunks.back().chunkX != sc[0] || chunks.back().chunkZ != sc[1]) {
+                chunks.push_back({ sc[0], sc[1], 0, 0, size });
+            }
+            chunks.back().entryCount++;
+            size += builder.write(out);
+        }
+    }
+}
+
+TEST(BlockDiffFile, RoundTrip)
+{
+    const std::string fn = "block_diff_file_test.bdiff";
+    std::vector<BlockDiffChunk> chunks1, chunks2;
+    // chunk (5, -1) is split over both parts
+    writePart(fn + ".part0", { { 5, 2, 0 }, { 5, -1, 1 } }, chunks1);
+    writePart(fn + ".part1", { { 5, -1, 2 }, { -3, 0, 4 } }, chunks2);
+
+    BlockDiffWriter writer;
+    ASSERT_EQ(writer.open(fn, 0), 0);
+    writer.appendPart(fn + ".part0", chunks1);
+    writer.appendPart(fn + ".part1", chunks2);
+    ASSERT_EQ(writer.close(), 0);
+    std::remove((fn + ".part0").c_str());
+    std::remove((fn + ".part1").c_str());
+
+    BlockDiffFile diff;
+    ASSERT_EQ(diff.open(fn), 0);
+    EXPECT_EQ(diff.header().entryCount, 4u);
+    ASSERT_EQ(diff.chunkCount(), 3u);
+    // the index is sorted by (x, z)
+    EXPECT_EQ(diff.chunk(0).chunkX, -3);
+    EXPECT_EQ(diff.chunk(1).chunkZ, -1);
+    EXPECT_EQ(diff.chunk(2).chunkZ, 2);
+
+    EXPECT_EQ(diff.findChunk(0, 0), nullptr);
+    const BlockDiffChunk* chunk = diff.findChunk(5, -1);
+    ASSERT_NE(chunk, nullptr);
+    ASSERT_EQ(chunk->entryCount, 2u);
+
+    const BlockDiffEntry* entry = diff.firstEntry(*chunk);
+    EXPECT_EQ(entry->subChunk, 1);
+    EXPECT_EQ(entry->changeCount, 3);
+    EXPECT_EQ(entry->paletteCount, 4);
+    EXPECT_TRUE(entry->changed(0));
+    EXPECT_TRUE(entry->changed(17));
+    EXPECT_FALSE(entry->changed(16));
+    EXPECT_TRUE(entry->changed(4095));
+    EXPECT_EQ(entry->oldBlockId(1), 1);
+    EXPECT_EQ(entry->newBlockId(1), 3);
+    EXPECT_EQ(entry->oldBlockId(2), 0);
+
+    entry = BlockDiffFile::nextEntry(entry);
+    EXPECT_EQ(entry->chunkX, 5);
+    EXPECT_EQ(entry->subChunk, 2);
+
+    diff.close();
+    std::remove(fn.c_str());
+}
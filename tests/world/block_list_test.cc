@@ -0,0 +1,125 @@
+#include "world/block_list.h"
+#include "world/db_merge.h"
+#include "world/dimension_data.h"
+#include "minecraft/v2/block.h"
+#include "minecraft/v2/block_table.h"
+#include "control.h"
+#include "test_world.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+using namespace mcpe_viz;
+using namespace test_world;
+
+namespace {
+    std::string readFile(const std::string& fn) {
+        std::ifstream in(fn, std::ios::binary);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        return ss.str();
+    }
+
+    // the _blocks.txt and .xyz outputs of generateBlockList with the given number of threads
+    std::pair<std::string, std::string> blockList(leveldb::DB* db, int32_t threadCount) {
+        DimensionData_LevelDB dim;
+        dim.setDimId(0);
+        dim.addToChunkBounds(-4, -4);
+        dim.addToChunkBounds(3, 3);
+        control.threadCount = threadCount;
+        EXPECT_EQ(dim.generateBlockList(db, "overworld"), 0);
+        return { readFile(control.dirLeveldb + "_overworld_blocks.txt"), readFile(control.dirLeveldb + "_overworld_blocks.xyz") };
+    }
+}
+
+class BlockListTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        const char* names[] = { "block_list_test:stone", "block_list_test:dirt", "block_list_test:gold" };
+        for (int i = 0; i < 3; i++) {
+            auto block = Block::add(730 + i, names[i]);
+            if (block != nullptr) {
+                block->addUname(names[i]);
+            }
+        }
+        BlockTable::build();
+    }
+};
+
+TEST(BlockList, SpatialOrder)
+{
+    // subchunk layer first, then chunk row and chunk column, then x, z, y inside the subchunk
+    std::vector<BlockListCoords> coords = {
+        { 0, 16, 0 }, { -16, 0, 16 }, { 16, 0, -16 }, { 0, 0, 16 }, { -1, 0, 0 },
+        { 1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, 0, 0 }, { 0, -1, 0 },
+    };
+    std::sort(coords.begin(), coords.end(), blockListLess);
+    const std::vector<std::vector<int32_t>> expected = {
+        { 0, -1, 0 }, { 16, 0, -16 }, { -1, 0, 0 }, { 0, 0, 0 }, { 0, 1, 0 },
+        { 0, 0, 1 }, { 1, 0, 0 }, { -16, 0, 16 }, { 0, 0, 16 }, { 0, 16, 0 },
+    };
+    ASSERT_EQ(coords.size(), expected.size());
+    for (size_t i = 0; i < coords.size(); i++) {
+        EXPECT_EQ(coords[i].x, expected[i][0]) << i;
+        EXPECT_EQ(coords[i].y, expected[i][1]) << i;
+        EXPECT_EQ(coords[i].z, expected[i][2]) << i;
+    }
+}
+
+TEST_F(BlockListTest, SameForAnyNumberOfParts)
+{
+    const std::vector<std::string> palette = { "minecraft:air", "block_list_test:stone", "block_list_test:dirt",
+        "block_list_test:gold" };
+    std::map<std::string, std::string> records;
+    std::mt19937 rng(7);
+    for (int32_t chunkX = -4; chunkX < 4; chunkX++) {
+        for (int32_t chunkZ = -4; chunkZ < 4; chunkZ++) {
+            for (int32_t chunkY = 0; chunkY < 4; chunkY++) {
+                std::vector<uint16_t> indices(4096);
+                for (auto& index : indices) {
+                    index = uint16_t(rng() % 8 == 0 ? 1 + rng() % 2 : 0);
+                }
+                // a few rare blocks
+                if (rng() % 64 == 0) {
+                    indices[rng() % 4096] = 3;
+                }
+                std::string key((const char*)&chunkX, 4);
+                key.append((const char*)&chunkZ, 4);
+                key.push_back(0x2f);
+                key.push_back(char(chunkY));
+                records[key] = makeSubChunk(palette, indices);
+            }
+        }
+    }
+    auto db = openDb("block_list_test_db", records);
+    db->CompactRange(nullptr, nullptr);
+    // the key range has to split, or there is only one part anyway
+    ASSERT_FALSE(splitKeyRange(db.get(), 16).empty());
+
+    const Control saved = control;
+    control.dirLeveldb = "block_list_test";
+    control.blockFilter = "<all>";
+    control.blockListMax = 40;
+    control.blockListRare = 10;
+    const auto one = blockList(db.get(), 1);
+    const auto many = blockList(db.get(), 4);
+    control = saved;
+
+    EXPECT_EQ(one.first, many.first);
+    EXPECT_EQ(one.second, many.second);
+    EXPECT_NE(one.first.find("block_list_test:gold"), std::string::npos);
+    // the parts are merged into the outputs and removed
+    for (const auto& entry : std::filesystem::directory_iterator(".")) {
+        EXPECT_EQ(entry.path().filename().string().find("block_list_test_overworld_blocks.xyz.part"), std::string::npos);
+    }
+
+    db.reset();
+    std::filesystem::remove_all("block_list_test_db");
+    std::remove("block_list_test_overworld_blocks.txt");
+    std::remove("block_list_test_overworld_blocks.xyz");
+}
@@ -0,0 +1,78 @@
+#include "minecraft/v2/block.h"
+#include "minecraft/v2/block_table.h"
+#include "config.h"
+#include "define.h"
+
+#include <gtest/gtest.h>
+
+using namespace mcpe_viz;
+
+class BlockTableTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        // a plain block, a block without a color and a block with two variants
+        auto stone = Block::add(720, "block_table_test:stone");
+        if (stone != nullptr) {
+            stone->color(0x808080);
+            stone->spawnable = true;
+            stone->opaque = true;
+        }
+        auto glass = Block::add(721, "block_table_test:glass");
+        if (glass != nullptr) {
+            glass->solid = false;
+        }
+        auto wool = Block::add(722, "block_table_test:wool");
+        if (wool != nullptr) {
+            wool->color(0xffffff);
+            wool->spawnable = true;
+            auto white = wool->addVariant(0, "block_table_test:white wool");
+            white->color(0xeeeeee);
+            white->spawnable = true;
+            auto red = wool->addVariant(3, "block_table_test:red wool");
+            red->color(0xff0000);
+        }
+        BlockTable::build();
+    }
+};
+
+TEST_F(BlockTableTest, SameAsTheRegistry)
+{
+    for (int32_t id : { 720, 721, 722 }) {
+        auto block = Block::get(id);
+        ASSERT_NE(block, nullptr);
+        for (int32_t data = 0; data < 16; data++) {
+            const int32_t state = BlockTable::state(id, data);
+            ASSERT_GE(state, 0);
+            const uint8_t flags = BlockTable::flags(state);
+            auto variant = block->getVariantByBlockData(data);
+            EXPECT_EQ(BlockTable::rgb(state), variant ? variant->color() : block->color()) << id << " " << data;
+            EXPECT_EQ(bool(flags & BlockTable::kFlagSpawnable), block->isSpawnable(data)) << id << " " << data;
+            EXPECT_EQ(bool(flags & BlockTable::kFlagSolid), block->solid);
+            EXPECT_EQ(bool(flags & BlockTable::kFlagOpaque), block->opaque);
+            EXPECT_EQ(bool(flags & BlockTable::kFlagLiquid), block->liquid);
+            EXPECT_EQ(bool(flags & BlockTable::kFlagVariants), block->hasVariants());
+            EXPECT_EQ(bool(flags & BlockTable::kFlagNoVariant), block->hasVariants() && variant == nullptr);
+            EXPECT_EQ(bool(flags & BlockTable::kFlagNoColor), !block->hasVariants() && !block->is_color_set());
+            EXPECT_FALSE(flags & BlockTable::kFlagUnknown);
+            EXPECT_EQ(BlockTable::name(BlockTable::nameIndex(state)), block->name);
+        }
+    }
+}
+
+TEST_F(BlockTableTest, UnknownBlocks)
+{
+    EXPECT_EQ(BlockTable::state(-1, 0), -1);
+    EXPECT_EQ(BlockTable::state(720, 16), -1);
+    EXPECT_EQ(BlockTable::state(kMaxBlockCount, 0), -1);
+    EXPECT_EQ(BlockTable::flags(-1), BlockTable::kFlagUnknown);
+
+    // an id no block has
+    const int32_t state = BlockTable::state(723, 0);
+    ASSERT_GE(state, 0);
+    EXPECT_EQ(BlockTable::flags(state), BlockTable::kFlagUnknown);
+    EXPECT_EQ(BlockTable::rgb(state), kColorDefault);
+    EXPECT_EQ(BlockTable::name(BlockTable::nameIndex(state)), "");
+
+    EXPECT_EQ(BlockTable::findName("block_table_test:wool"), BlockTable::nameIndex(BlockTable::state(722, 3)));
+    EXPECT_EQ(BlockTable::findName("block_table_test:nothing"), -1);
+}
@@ -0,0 +1,58 @@
+#include "world/change_clusters.h"
+
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace mcpe_viz;
+
+namespace {
+    struct Block {
+        int32_t x, y, z;
+    };
+
+    // feed the blocks to the builder one subchunk at a time, like the block list does
+    void addSubChunk(ChangeClusters& clusters, int32_t chunkX, int32_t subChunk, int32_t chunkZ,
+                     const std::vector<Block>& blocks) {
+        SubChunkClusterBuilder builder;
+        builder.begin(chunkX, subChunk, chunkZ);
+        for (const auto& b : blocks) {
+            builder.add(b.x, b.y, b.z, 4, 1);
+        }
+        SubChunkClusters sc;
+        if (builder.end(sc)) {
+            clusters.add(sc);
+        }
+    }
+}
+
+TEST(ChangeClusters, UnitInsideSubChunk) {
+    ChangeClusters clusters;
+    // a diagonal line of 3 blocks and a single block that does not touch it
+    addSubChunk(clusters, 0, 0, 0, { { 1, 1, 1 }, { 2, 2, 2 }, { 3, 3, 3 }, { 10, 3, 3 } });
+    auto result = clusters.result();
+    ASSERT_EQ(result.size(), 2u);
+    EXPECT_EQ(result[0].blockCount, 3u);
+    EXPECT_EQ(result[0].maxX, 3);
+    EXPECT_EQ(result[0].newBlocks[4], 3u);
+    EXPECT_EQ(result[0].oldBlocks[1], 3u);
+    EXPECT_EQ(result[1].blockCount, 1u);
+}
+
+TEST(ChangeClusters, UnitAcrossSubChunks) {
+    ChangeClusters clusters;
+    // one cluster that touches 4 subchunks only at their corners, added in no particular order;
+    // negative chunk coordinates included
+    addSubChunk(clusters, 0, 1, 0, { { 0, 16, 0 } });
+    addSubChunk(clusters, -1, 0, -1, { { -1, 15, -1 }, { -5, 2, -5 } });
+    addSubChunk(clusters, 0, 0, -1, { { 0, 15, -1 } });
+    addSubChunk(clusters, -1, 1, 0, { { -1, 16, 0 } });
+    // this one is two blocks away
+    addSubChunk(clusters, 1, 1, 0, { { 17, 16, 0 } });
+    auto result = clusters.result();
+    ASSERT_EQ(result.size(), 3u);
+    EXPECT_EQ(result[0].blockCount, 4u);
+    EXPECT_EQ(result[0].minX, -1);
+    EXPECT_EQ(result[0].minY, 15);
+    EXPECT_EQ(result[0].maxY, 16);
+    EXPECT_EQ(result[0].maxZ, 0);
+}
@@ -0,0 +1,141 @@
+#include "world/chunk_data.h"
+#include "minecraft/v2/block.h"
+#include "minecraft/v2/block_table.h"
+#include "test_world.h"
+
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mcpe_viz;
+using namespace test_world;
+
+namespace {
+    // a 0.17 style subchunk record: block id's, then the data, sky light and block light nibbles
+    std::string makeLegacySubChunk(const std::vector<uint8_t>& ids) {
+        std::string s(1 + 4096 + 3 * 2048, '\0');
+        for (int32_t i = 0; i < 4096; i++) {
+            s[1 + i] = char(ids[i]);
+        }
+        // some sky light, so the light of a legacy top block is not 0
+        for (int32_t i = 0; i < 2048; i++) {
+            s[1 + 4096 + 2048 + i] = char(0xa5);
+        }
+        return s;
+    }
+}
+
+class ChunkTopTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        const char* names[] = { "chunk_top_test:stone", "chunk_top_test:dirt", "chunk_top_test:hidden" };
+        for (int i = 0; i < 3; i++) {
+            auto block = Block::add(710 + i, names[i]);
+            if (block != nullptr) {
+                block->addUname(names[i]);
+            }
+        }
+        // legacy subchunks have 8-bit block id's
+        Block::add(250, "chunk_top_test:legacy");
+        BlockTable::build();
+    }
+};
+
+TEST_F(ChunkTopTest, SameAsEverySubChunk)
+{
+    bool hide[1024] = {}, forceTop[1024] = {}, geoJson[1024] = {};
+    hide[712] = true;
+    const std::vector<std::string> palette = { "minecraft:air", "chunk_top_test:stone", "chunk_top_test:dirt",
+        "chunk_top_test:hidden" };
+
+    std::mt19937 rng(42);
+    for (int run = 0; run < 20; run++) {
+        // mostly air higher up, so columns end in different subchunks (and some never get a block)
+        std::vector<SubChunkRecord> records;
+        for (int32_t chunkY : { 0, 1, 2, 3, -1 }) {
+            std::vector<uint16_t> indices(4096);
+            const uint32_t airChance = (chunkY < 0) ? 0 : uint32_t(40 + chunkY * 20);
+            for (auto& idx : indices) {
+                idx = (rng() % 100 < airChance) ? 0 : uint16_t(1 + rng() % 3);
+            }
+            records.push_back({ chunkY, makeSubChunk(palette, indices) });
+        }
+
+        // every subchunk in key order (negative subchunks sort last)
+        ChunkData_LevelDB all;
+        for (const auto& r : records) {
+            ASSERT_EQ(all._do_chunk_v7(3, r.chunkY, 5, r.value.data(), r.value.size(), 0, "overworld", hide, forceTop,
+                geoJson, CheckSpawnList()), 0);
+        }
+        ChunkData_LevelDB top;
+        ASSERT_EQ(top._do_chunk_v7_top(3, 5, records.data(), records.size(), hide), 0);
+
+        for (int32_t cx = 0; cx < 16; cx++) {
+            for (int32_t cz = 0; cz < 16; cz++) {
+                ASSERT_EQ(top.blocks[cx][cz], all.blocks[cx][cz]) << cx << " " << cz;
+                ASSERT_EQ(top.data[cx][cz], all.data[cx][cz]);
+                ASSERT_EQ(top.topBlockY[cx][cz], all.topBlockY[cx][cz]);
+                ASSERT_EQ(top.topLight[cx][cz], all.topLight[cx][cz]);
+            }
+        }
+    }
+}
+
+TEST_F(ChunkTopTest, KeepsHigherLegacyTopBlock)
+{
+    bool hide[1024] = {}, forceTop[1024] = {}, geoJson[1024] = {};
+    const std::vector<std::string> palette = { "minecraft:air", "chunk_top_test:stone" };
+
+    std::mt19937 rng(7);
+    for (int run = 0; run < 10; run++) {
+        // legacy subchunks at 2 and 4, paletted ones at 1 and 3; all of them partly air
+        std::vector<SubChunkRecord> paletted, legacy;
+        for (int32_t chunkY : { 1, 2, 3, 4 }) {
+            if (chunkY % 2 == 0) {
+                std::vector<uint8_t> ids(4096);
+                for (auto& id : ids) {
+                    id = (rng() % 100 < 90) ? 0 : 250;
+                }
+                legacy.push_back({ chunkY, makeLegacySubChunk(ids) });
+            }
+            else {
+                std::vector<uint16_t> indices(4096);
+                for (auto& idx : indices) {
+                    idx = (rng() % 100 < 90) ? 0 : 1;
+                }
+                paletted.push_back({ chunkY, makeSubChunk(palette, indices) });
+            }
+        }
+
+        // every subchunk in key order
+        ChunkData_LevelDB all;
+        for (int32_t chunkY = 1; chunkY <= 4; chunkY++) {
+            const auto& r = (chunkY % 2 == 0) ? legacy[chunkY / 2 - 1] : paletted[chunkY / 2];
+            if (chunkY % 2 == 0) {
+                ASSERT_EQ(all._do_chunk_v3(3, r.chunkY, 5, r.value.data(), r.value.size(), 0, "overworld", hide,
+                    forceTop, geoJson, CheckSpawnList()), 0);
+            }
+            else {
+                ASSERT_EQ(all._do_chunk_v7(3, r.chunkY, 5, r.value.data(), r.value.size(), 0, "overworld", hide,
+                    forceTop, geoJson, CheckSpawnList()), 0);
+            }
+        }
+        // the legacy subchunks while scanning, the paletted ones when the chunk is done
+        ChunkData_LevelDB top;
+        for (const auto& r : legacy) {
+            ASSERT_EQ(top._do_chunk_v3(3, r.chunkY, 5, r.value.data(), r.value.size(), 0, "overworld", hide,
+                forceTop, geoJson, CheckSpawnList()), 0);
+        }
+        ASSERT_EQ(top._do_chunk_v7_top(3, 5, paletted.data(), paletted.size(), hide), 0);
+
+        for (int32_t cx = 0; cx < 16; cx++) {
+            for (int32_t cz = 0; cz < 16; cz++) {
+                ASSERT_EQ(top.blocks[cx][cz], all.blocks[cx][cz]) << cx << " " << cz;
+                ASSERT_EQ(top.data[cx][cz], all.data[cx][cz]);
+                ASSERT_EQ(top.topBlockY[cx][cz], all.topBlockY[cx][cz]);
+                ASSERT_EQ(top.topLight[cx][cz], all.topLight[cx][cz]);
+            }
+        }
+    }
+}
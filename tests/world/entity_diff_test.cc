@@ -0,0 +1,69 @@
+#include "world/entity_diff.h"
+#include "test_world.h"
+
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace mcpe_viz;
+using namespace test_world;
+
+namespace {
+    std::string makeEntity(int64_t uid, float x, int32_t health) {
+        std::string s;
+        s.push_back(10);
+        putName(s, "");
+        s.push_back(8);
+        putName(s, "identifier");
+        putName(s, "minecraft:cow");
+        s.push_back(4);
+        putName(s, "UniqueID");
+        s.append((const char*)&uid, 8);
+        s.push_back(9);
+        putName(s, "Pos");
+        s.push_back(5);
+        int32_t count = 3;
+        s.append((const char*)&count, 4);
+        float pos[3] = { x, 64.0f, 0.5f };
+        s.append((const char*)pos, 12);
+        s.push_back(3);
+        putName(s, "Health");
+        s.append((const char*)&health, 4);
+        s.push_back(0);
+        return s;
+    }
+}
+
+TEST(EntityDiff, UnitSameChunk) {
+    // entity 1 moved, 2 was hurt, 3 is new, 4 is gone
+    const std::string a = makeEntity(1, 2.5f, 20) + makeEntity(2, 4.5f, 10) + makeEntity(3, 6.5f, 20);
+    const std::string b = makeEntity(1, 1.5f, 20) + makeEntity(2, 4.5f, 20) + makeEntity(4, 8.5f, 20);
+    const leveldb::Slice sa(a), sb(b);
+
+    EntityDiff diff;
+    diff.compareRecords(&sa, &sb, false);
+    diff.finish();
+    ASSERT_EQ(diff.changes.size(), 4u);
+    EXPECT_EQ(diff.changes[0].type, kEntityMoved);
+    EXPECT_EQ(diff.changes[0].other.pos[0], 1.5f);
+    EXPECT_EQ(diff.changes[1].type, kEntityModified);
+    EXPECT_EQ(diff.changes[2].type, kEntityAdded);
+    EXPECT_EQ(diff.changes[2].info.uniqueId, 3);
+    EXPECT_EQ(diff.changes[3].type, kEntityRemoved);
+    EXPECT_EQ(diff.changes[3].other.uniqueId, 4);
+}
+
+TEST(EntityDiff, UnitOtherChunk) {
+    // entity 7 walked from one chunk into another that is scanned by a different part
+    const std::string before = makeEntity(7, 15.5f, 20);
+    const std::string after = makeEntity(7, 16.5f, 20);
+    const leveldb::Slice sBefore(before), sAfter(after);
+
+    EntityDiff part1, part2;
+    part1.compareRecords(nullptr, &sBefore, false);
+    part2.compareRecords(&sAfter, nullptr, false);
+    part1.merge(part2);
+    part1.finish();
+    ASSERT_EQ(part1.changes.size(), 1u);
+    EXPECT_EQ(part1.changes[0].type, kEntityMoved);
+    EXPECT_EQ(part1.changes[0].info.pos[0], 16.5f);
+}
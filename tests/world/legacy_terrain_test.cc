@@ -0,0 +1,61 @@
+#include "world/misc.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <string>
+
+using namespace mcpe_viz;
+
+namespace {
+    std::string randomRecord(size_t size, uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::string s(size, '\0');
+        for (auto& c : s) {
+            c = char(rng());
+        }
+        return s;
+    }
+}
+
+TEST(LegacyTerrain, SameAsOneBlockAtATime_v2)
+{
+    auto s = randomRecord(83200, 1);
+    auto terrain = std::make_unique<LegacyTerrain>();
+    decodeLegacyTerrain_LevelDB_v2(s.data(), s.size(), *terrain);
+    for (int32_t x = 0; x < 16; x++) {
+        for (int32_t z = 0; z < 16; z++) {
+            for (int32_t y = 0; y < 128; y++) {
+                const int32_t off = terrain->offset(x, z, y);
+                ASSERT_EQ(terrain->blockId[off], getBlockId_LevelDB_v2(s.data(), x, z, y));
+                ASSERT_EQ(terrain->blockData()[off], getBlockData_LevelDB_v2(s.data(), x, z, y));
+                ASSERT_EQ(terrain->skyLight()[off], getBlockSkyLight_LevelDB_v2(s.data(), x, z, y));
+                ASSERT_EQ(terrain->blockLight()[off], getBlockBlockLight_LevelDB_v2(s.data(), x, z, y));
+            }
+        }
+    }
+}
+
+TEST(LegacyTerrain, SameAsOneBlockAtATime_v3)
+{
+    // a full record, and one that stops in the middle of the sky light
+    for (size_t size : { size_t(10241), size_t(4097 + 2048 + 1000) }) {
+        auto s = randomRecord(size, 2);
+        auto terrain = std::make_unique<LegacyTerrain>();
+        decodeLegacyTerrain_LevelDB_v3(s.data(), s.size(), *terrain);
+        for (int32_t x = 0; x < 16; x++) {
+            for (int32_t z = 0; z < 16; z++) {
+                // y = 16 is where the light of the block above the top of a column is read from
+                for (int32_t y = 0; y <= 16; y++) {
+                    const int32_t off = terrain->offset(x, z, y);
+                    if (y < 16) {
+                        ASSERT_EQ(terrain->blockId[off], getBlockId_LevelDB_v3(s.data(), x, z, y));
+                        ASSERT_EQ(terrain->blockData()[off], getBlockData_LevelDB_v3(s.data(), size, x, z, y));
+                    }
+                    ASSERT_EQ(terrain->skyLight()[off], getBlockSkyLight_LevelDB_v3(s.data(), size, x, z, y));
+                    ASSERT_EQ(terrain->blockLight()[off], getBlockBlockLight_LevelDB_v3(s.data(), size, x, z, y));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,199 @@
+#include "world/palette.h"
+#include "minecraft/v2/block.h"
+#include "test_world.h"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace mcpe_viz;
+using namespace test_world;
+
+namespace {
+    // append one block storage; vals (if given) and version (if not 0) go into each palette entry
+    void appendStorage(std::string& s, const std::vector<std::string>& palette, const std::vector<uint16_t>& indices,
+                       int32_t bitsPerBlock, const std::vector<int16_t>& vals = {}, int32_t version = 0) {
+        s.push_back(char(bitsPerBlock << 1));
+
+        int32_t blocksPerWord = 32 / bitsPerBlock;
+        std::vector<uint32_t> words((4096 + blocksPerWord - 1) / blocksPerWord, 0);
+        for (int32_t i = 0; i < 4096; i++) {
+            words[i / blocksPerWord] |= uint32_t(indices[i]) << ((i % blocksPerWord) * bitsPerBlock);
+        }
+        s.append((const char*)words.data(), words.size() * 4);
+
+        int32_t count = int32_t(palette.size());
+        s.append((const char*)&count, 4);
+        for (size_t i = 0; i < palette.size(); i++) {
+            s.push_back(10);
+            putName(s, "");
+            s.push_back(8);
+            putName(s, "name");
+            putName(s, palette[i]);
+            s.push_back(10);
+            putName(s, "states");
+            s.push_back(0);
+            s.push_back(2);
+            putName(s, "val");
+            int16_t val = (i < vals.size()) ? vals[i] : 0;
+            s.append((const char*)&val, 2);
+            if (version != 0) {
+                s.push_back(3);
+                putName(s, "version");
+                s.append((const char*)&version, 4);
+            }
+            s.push_back(0);
+        }
+    }
+
+    // build a single storage v8 subchunk record
+    std::string makeSubChunk(const std::vector<std::string>& palette, const std::vector<uint16_t>& indices,
+                             int32_t bitsPerBlock) {
+        std::string s;
+        s.push_back(8);
+        s.push_back(1);
+        appendStorage(s, palette, indices, bitsPerBlock);
+        return s;
+    }
+}
+
+class PaletteTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        const char* names[] = { "palette_test:air", "palette_test:stone", "palette_test:dirt", "palette_test:wool" };
+        for (int i = 0; i < 4; i++) {
+            auto block = Block::add(700 + i, names[i]);
+            if (block != nullptr) {
+                block->addUname(names[i]);
+            }
+        }
+    }
+};
+
+TEST_F(PaletteTest, UnitParseStorage) {
+    std::vector<uint16_t> indices(4096, 1);
+    auto s = makeSubChunk({ "palette_test:air", "palette_test:stone" }, indices, 1);
+
+    PaletteStorage storage;
+    ASSERT_EQ(parsePaletteStorage(s.data(), s.size(), storage), 0);
+    ASSERT_EQ(storage.bitsPerBlock, 1);
+    ASSERT_EQ(storage.palette.size(), 2u);
+    ASSERT_EQ(std::string(storage.palette[1].name, storage.palette[1].nameSize), "palette_test:stone");
+    ASSERT_EQ(storage.getIndex(4095), 1);
+}
+
+TEST_F(PaletteTest, UnitChangedBlocks) {
+    std::vector<uint16_t> indices(4096, 1);
+    auto a = makeSubChunk({ "palette_test:air", "palette_test:stone", "palette_test:dirt" }, indices, 2);
+    indices[17] = 2;
+    indices[4000] = 0;
+    auto b = makeSubChunk({ "palette_test:air", "palette_test:stone", "palette_test:dirt" }, indices, 2);
+
+    std::vector<BlockIdDiff> diffs;
+    ASSERT_EQ(comparePalettedSubChunks(b.data(), b.size(), a.data(), a.size(), diffs), 0);
+    ASSERT_EQ(diffs.size(), 2u);
+    ASSERT_EQ(diffs[0].blockPos, 17);
+    ASSERT_EQ(diffs[0].blockId, 702);
+    ASSERT_EQ(diffs[0].otherBlockId, 701);
+    ASSERT_EQ(diffs[1].blockPos, 4000);
+    ASSERT_EQ(diffs[1].blockId, 700);
+}
+
+TEST_F(PaletteTest, UnitReorderedPalette) {
+    std::vector<uint16_t> indicesA(4096), indicesB(4096);
+    for (int i = 0; i < 4096; i++) {
+        indicesA[i] = uint16_t(i % 3);
+        indicesB[i] = uint16_t(2 - (i % 3));
+    }
+    auto a = makeSubChunk({ "palette_test:air", "palette_test:stone", "palette_test:dirt" }, indicesA, 2);
+    auto b = makeSubChunk({ "palette_test:dirt", "palette_test:stone", "palette_test:air", "palette_test:wool" },
+        indicesB, 3);
+
+    std::vector<BlockIdDiff> diffs;
+    ASSERT_EQ(comparePalettedSubChunks(a.data(), a.size(), b.data(), b.size(), diffs), 0);
+    ASSERT_TRUE(diffs.empty());
+}
+
+TEST_F(PaletteTest, UnitNotPaletted) {
+    std::string legacy(10241, '\0');
+    std::vector<uint16_t> indices(4096, 0);
+    auto a = makeSubChunk({ "palette_test:air" }, indices, 1);
+
+    std::vector<BlockIdDiff> diffs;
+    ASSERT_EQ(comparePalettedSubChunks(a.data(), a.size(), legacy.data(), legacy.size(), diffs), -1);
+}
+
+TEST_F(PaletteTest, UnitChangedStates) {
+    std::vector<uint16_t> indices(4096, 1);
+    std::string a;
+    a.push_back(8);
+    a.push_back(1);
+    appendStorage(a, { "palette_test:air", "palette_test:stone" }, indices, 1, {}, 1);
+
+    // same blocks, but position 5 has a different val and a second layer with a block at position 9;
+    // the version tags differ as well, which does not count
+    std::string b;
+    b.push_back(8);
+    b.push_back(2);
+    indices[5] = 2;
+    appendStorage(b, { "palette_test:air", "palette_test:stone", "palette_test:stone" }, indices, 2, { 0, 0, 3 }, 2);
+    std::vector<uint16_t> layer2(4096, 0);
+    layer2[9] = 1;
+    appendStorage(b, { "minecraft:air", "palette_test:wool" }, layer2, 1);
+
+    std::vector<BlockIdDiff> diffs;
+    ASSERT_EQ(comparePalettedSubChunks(b.data(), b.size(), a.data(), a.size(), diffs), 0);
+    ASSERT_TRUE(diffs.empty());
+
+    BlockStateIndex index;
+    SubChunkStates statesA, statesB;
+    ASSERT_EQ(compareSubChunkStates(b.data(), b.size(), a.data(), a.size(), index, statesA, statesB, diffs), 0);
+    ASSERT_EQ(diffs.size(), 2u);
+    ASSERT_EQ(diffs[0].blockPos, 5);
+    ASSERT_EQ(diffs[0].blockId, 701);
+    ASSERT_EQ(diffs[0].otherBlockId, 701);
+    ASSERT_EQ(diffs[1].blockPos, 9);
+
+    // a second layer without blocks is the same as no second layer
+    b.resize(2);
+    b[1] = 2;
+    indices[5] = 1;
+    appendStorage(b, { "palette_test:air", "palette_test:stone" }, indices, 1);
+    appendStorage(b, { "minecraft:air" }, std::vector<uint16_t>(4096, 0), 1);
+    ASSERT_EQ(compareSubChunkStates(b.data(), b.size(), a.data(), a.size(), index, statesA, statesB, diffs), 0);
+    ASSERT_TRUE(diffs.empty());
+}
+
+TEST_F(PaletteTest, UnitPaletteBlockCache) {
+    std::vector<uint16_t> indicesA(4096, 0), indicesB(4096, 1);
+    std::string a, b;
+    appendStorage(a, { "palette_test:stone", "palette_test:wool", "palette_test:unknown" }, indicesA, 2, { 0, 14 });
+    appendStorage(b, { "palette_test:stone", "palette_test:wool", "palette_test:unknown" }, indicesB, 2, { 0, 14 });
+
+    // the palette starts after the flags byte and the packed words
+    const size_t paletteOffset = 1 + 256 * 4;
+    PaletteBlockCache cache;
+    auto blocksA = cache.resolve(a.data() + paletteOffset, a.data() + a.size());
+    ASSERT_NE(blocksA, nullptr);
+    ASSERT_EQ(blocksA->size(), 3u);
+    ASSERT_EQ((*blocksA)[0].blockId, 701);
+    ASSERT_EQ((*blocksA)[1].blockId, 703);
+    ASSERT_EQ((*blocksA)[1].blockData, 14);
+    ASSERT_EQ((*blocksA)[2].blockId, 0);
+
+    // same palette bytes, different words: resolved once
+    auto blocksB = cache.resolve(b.data() + paletteOffset, b.data() + b.size());
+    ASSERT_EQ(blocksB, blocksA);
+    ASSERT_EQ(cache.size(), 1u);
+
+    // a different palette of the same size is resolved on its own
+    std::string c;
+    appendStorage(c, { "palette_test:wool", "palette_test:stone", "palette_test:unknown" }, indicesA, 2, { 14, 0 });
+    auto blocksC = cache.resolve(c.data() + paletteOffset, c.data() + c.size());
+    ASSERT_NE(blocksC, nullptr);
+    ASSERT_NE(blocksC, blocksA);
+    ASSERT_EQ((*blocksC)[0].blockId, 703);
+    ASSERT_EQ(cache.size(), 2u);
+
+    ASSERT_EQ(cache.resolve(a.data() + paletteOffset, a.data() + a.size() - 1), nullptr);
+}
@@ -0,0 +1,46 @@
+#include "world/palette_unpack.h"
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace mcpe_viz;
+
+namespace {
+    // the index at blockPos the way PaletteStorage::getIndex reads it
+    uint16_t getIndex(const std::vector<uint32_t>& words, int32_t bitsPerBlock, int32_t blockPos) {
+        const int32_t blocksPerWord = 32 / bitsPerBlock;
+        const uint32_t word = words[blockPos / blocksPerWord];
+        return uint16_t((word >> ((blockPos % blocksPerWord) * bitsPerBlock)) & ((1u << bitsPerBlock) - 1));
+    }
+}
+
+TEST(PaletteUnpack, SameAsOneIndexAtATime)
+{
+    std::mt19937 rng(1234);
+    for (int32_t bits : { 1, 2, 3, 4, 5, 6, 8, 16 }) {
+        const int32_t blocksPerWord = 32 / bits;
+        // random words, including the padding bits of 3, 5 and 6 bits per block
+        std::vector<uint32_t> words((4096 + blocksPerWord - 1) / blocksPerWord);
+        for (auto& w : words) {
+            w = uint32_t(rng());
+        }
+        std::vector<uint16_t> fast(4096), scalar(4096);
+        ASSERT_EQ(unpackPaletteIndices((const char*)words.data(), bits, fast.data()), 0);
+        ASSERT_EQ(unpackPaletteIndicesScalar((const char*)words.data(), bits, scalar.data()), 0);
+        for (int32_t i = 0; i < 4096; i++) {
+            const uint16_t expected = getIndex(words, bits, i);
+            ASSERT_EQ(fast[i], expected) << bits << " bits, block " << i;
+            ASSERT_EQ(scalar[i], expected) << bits << " bits, block " << i;
+        }
+    }
+}
+
+TEST(PaletteUnpack, BadWidth)
+{
+    std::vector<uint32_t> words(4096, 0);
+    std::vector<uint16_t> out(4096);
+    EXPECT_EQ(unpackPaletteIndices((const char*)words.data(), 7, out.data()), -1);
+    EXPECT_EQ(unpackPaletteIndicesScalar((const char*)words.data(), 0, out.data()), -1);
+}
@@ -0,0 +1,48 @@
+#include "world/prefetch_iterator.h"
+#include "test_world.h"
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+
+using namespace mcpe_viz;
+using namespace test_world;
+
+TEST(PrefetchIterator, SameRecordsAsTheDb)
+{
+    std::map<std::string, std::string> records;
+    for (int i = 0; i < 1000; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%04d", i);
+        records[key] = std::string(size_t(i % 50), char('a' + i % 26));
+    }
+    auto db = openDb("prefetch_iterator_test_world", records);
+
+    // a small read-ahead, so the records come in many batches
+    PrefetchIterator iter(db->NewIterator(leveldb::ReadOptions()), 256);
+    std::map<std::string, std::string> seen;
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+        seen[iter.key().ToString()] = iter.value().ToString();
+    }
+    EXPECT_TRUE(iter.status().ok());
+    EXPECT_EQ(seen, records);
+
+    // a seek drops what was read ahead
+    iter.Seek("key0500");
+    ASSERT_TRUE(iter.Valid());
+    EXPECT_EQ(iter.key().ToString(), "key0500");
+    iter.Next();
+    ASSERT_TRUE(iter.Valid());
+    EXPECT_EQ(iter.key().ToString(), "key0501");
+    iter.Seek("key0010");
+    ASSERT_TRUE(iter.Valid());
+    EXPECT_EQ(iter.key().ToString(), "key0010");
+    EXPECT_EQ(iter.value().ToString(), records["key0010"]);
+    iter.Seek("zzz");
+    EXPECT_FALSE(iter.Valid());
+
+    db.reset();
+    std::filesystem::remove_all("prefetch_iterator_test_world");
+}
@@ -0,0 +1,92 @@
+#include "world/prune.h"
+#include "world/chunk_key.h"
+#include "define.h"
+#include "test_world.h"
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+
+using namespace mcpe_viz;
+using namespace test_world;
+
+namespace {
+    bool has(leveldb::DB* db, const std::string& key) {
+        std::string value;
+        return db->Get(leveldb::ReadOptions(), key, &value).ok();
+    }
+
+    std::string digpKey(int32_t chunkX, int32_t chunkZ) {
+        char keybuf[12];
+        memcpy(&keybuf[0], "digp", 4);
+        memcpy(&keybuf[4], &chunkX, sizeof(int32_t));
+        memcpy(&keybuf[8], &chunkZ, sizeof(int32_t));
+        return std::string(keybuf, 12);
+    }
+}
+
+TEST(Prune, DeletesOutsideKeepAreas)
+{
+    const std::string kept = makeChunkRecordKey(kDimIdOverworld, 0, 0, 0x2f, 0);
+    const std::string keptFar = makeChunkRecordKey(kDimIdOverworld, 100, 100, 0x2d);
+    const std::string gone = makeChunkRecordKey(kDimIdOverworld, 5, 0, 0x2f, 0);
+    const std::string goneEntities = makeChunkRecordKey(kDimIdOverworld, 5, 0, 0x32);
+    const std::string nether = makeChunkRecordKey(kDimIdNether, 5, 0, 0x2f, 0);
+    const std::string actorId("\x01\x00\x00\x00\x00\x00\x00\x00", 8);
+    const std::string actor = "actorprefix" + actorId;
+
+    auto db = openDb("prune_test_world", {
+        { kept, "x" }, { keptFar, "x" }, { gone, "x" }, { goneEntities, "x" }, { nether, "x" },
+        { digpKey(5, 0), actorId }, { actor, "x" }, { "Overworld", "x" }, { "~local_player", "x" } });
+
+    // two areas in the overworld, none in the nether
+    std::vector<KeepArea> keepAreas = { { kDimIdOverworld, 0, 1, 0, 1 }, { kDimIdOverworld, 100, 100, 100, 100 } };
+    PruneStats stats;
+    ASSERT_EQ(pruneWorld(db.get(), keepAreas, stats), 0);
+    EXPECT_EQ(stats.deletedChunks, 1u);
+    EXPECT_EQ(stats.deletedRecords, 4u);
+    EXPECT_EQ(stats.keptRecords, 2u);
+
+    EXPECT_TRUE(has(db.get(), kept));
+    EXPECT_TRUE(has(db.get(), keptFar));
+    EXPECT_FALSE(has(db.get(), gone));
+    EXPECT_FALSE(has(db.get(), goneEntities));
+    EXPECT_FALSE(has(db.get(), digpKey(5, 0)));
+    EXPECT_FALSE(has(db.get(), actor));
+    EXPECT_TRUE(has(db.get(), nether));
+    EXPECT_TRUE(has(db.get(), "Overworld"));
+    EXPECT_TRUE(has(db.get(), "~local_player"));
+
+    db.reset();
+    std::filesystem::remove_all("prune_test_world");
+}
+
+TEST(Prune, KeepsTextKeysOfChunkKeySize)
+{
+    // text keys with a chunk record type at byte 8 (and 9)
+    const std::string gone = makeChunkRecordKey(kDimIdOverworld, 5, 0, 0x2f, 0);
+    const std::string missingActorId("\x02\x00\x00\x00\x00\x00\x00\x00", 8);
+    auto db = openDb("prune_test_world", {
+        { gone, "x" }, { "map_12345", "x" }, { "abcdefgh/0", "x" }, { "abcdefgh+v", "x" }, { "player_1v", "x" },
+        { digpKey(6, 0), missingActorId } });
+
+    std::vector<KeepArea> keepAreas = { { kDimIdOverworld, 0, 1, 0, 1 } };
+    PruneStats stats;
+    ASSERT_EQ(pruneWorld(db.get(), keepAreas, stats), 0);
+    EXPECT_EQ(stats.deletedChunks, 1u);
+    // the subchunk and the digp record; the actor it lists is not there
+    EXPECT_EQ(stats.deletedRecords, 2u);
+
+    EXPECT_FALSE(has(db.get(), gone));
+    EXPECT_FALSE(has(db.get(), digpKey(6, 0)));
+    EXPECT_TRUE(has(db.get(), "map_12345"));
+    EXPECT_TRUE(has(db.get(), "abcdefgh/0"));
+    EXPECT_TRUE(has(db.get(), "abcdefgh+v"));
+    EXPECT_TRUE(has(db.get(), "player_1v"));
+
+    db.reset();
+    std::filesystem::remove_all("prune_test_world");
+}
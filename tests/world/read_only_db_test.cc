@@ -0,0 +1,100 @@
+#include "world/read_only_db.h"
+#include "test_world.h"
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace mcpe_viz;
+using namespace test_world;
+
+TEST(ReadOnlyDb, ReadsAWorldThatIsOpen)
+{
+    const std::string dir = "read_only_db_test_world";
+    std::filesystem::remove_all(dir);
+    leveldb::Options options;
+    options.create_if_missing = true;
+    leveldb::DB* db = nullptr;
+    ASSERT_TRUE(leveldb::DB::Open(options, dir, &db).ok());
+    std::unique_ptr<leveldb::DB> liveDb(db);
+
+    // some records in a table, newer versions and deletes only in the log
+    for (int i = 0; i < 100; i++) {
+        liveDb->Put(leveldb::WriteOptions(), "key" + std::to_string(i), "old");
+    }
+    liveDb->CompactRange(nullptr, nullptr);
+    liveDb->Put(leveldb::WriteOptions(), "key5", "new");
+    liveDb->Delete(leveldb::WriteOptions(), "key7");
+    liveDb->Put(leveldb::WriteOptions(), "key7", "again");
+    liveDb->Delete(leveldb::WriteOptions(), "key8");
+    liveDb->Put(leveldb::WriteOptions(), "zzz", "added");
+
+    // the live db still holds its LOCK
+    leveldb::DB* roDb = nullptr;
+    ASSERT_TRUE(openReadOnlyDb(options, dir, &roDb).ok());
+    std::unique_ptr<leveldb::DB> readOnlyDb(roDb);
+
+    EXPECT_EQ(readDb(readOnlyDb.get()), readDb(liveDb.get()));
+    std::string value;
+    EXPECT_TRUE(readOnlyDb->Get(leveldb::ReadOptions(), "key5", &value).ok());
+    EXPECT_EQ(value, "new");
+    EXPECT_TRUE(readOnlyDb->Get(leveldb::ReadOptions(), "key8", &value).IsNotFound());
+
+    std::unique_ptr<leveldb::Iterator> iter(readOnlyDb->NewIterator(leveldb::ReadOptions()));
+    iter->Seek("key8");
+    ASSERT_TRUE(iter->Valid());
+    EXPECT_EQ(iter->key().ToString(), "key80");
+    iter.reset();
+
+    EXPECT_TRUE(readOnlyDb->Put(leveldb::WriteOptions(), "key1", "x").IsNotSupportedError());
+
+    readOnlyDb.reset();
+    liveDb.reset();
+    std::filesystem::remove_all(dir);
+}
+
+TEST(ReadOnlyDb, ReadsTablesTheServerDeleted)
+{
+    const std::string dir = "read_only_db_test_compacted";
+    std::filesystem::remove_all(dir);
+    leveldb::Options options;
+    options.create_if_missing = true;
+    leveldb::DB* db = nullptr;
+    ASSERT_TRUE(leveldb::DB::Open(options, dir, &db).ok());
+    std::unique_ptr<leveldb::DB> liveDb(db);
+
+    for (int i = 0; i < 100; i++) {
+        liveDb->Put(leveldb::WriteOptions(), "key" + std::to_string(i), std::string(1000, char('a' + i % 26)));
+    }
+    liveDb->CompactRange(nullptr, nullptr);
+    const auto before = readDb(liveDb.get());
+
+    leveldb::DB* roDb = nullptr;
+    ASSERT_TRUE(openReadOnlyDb(options, dir, &roDb).ok());
+    std::unique_ptr<leveldb::DB> readOnlyDb(roDb);
+
+    // the server rewrites every record, so the tables we opened are deleted
+    std::vector<std::string> tablesBefore;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() == ".ldb") {
+            tablesBefore.push_back(entry.path().string());
+        }
+    }
+    ASSERT_FALSE(tablesBefore.empty());
+    for (int i = 0; i < 100; i++) {
+        liveDb->Put(leveldb::WriteOptions(), "key" + std::to_string(i), "new");
+    }
+    liveDb->CompactRange(nullptr, nullptr);
+    for (const auto& fn : tablesBefore) {
+        EXPECT_FALSE(std::filesystem::exists(fn)) << fn;
+    }
+
+    EXPECT_EQ(readDb(readOnlyDb.get()), before);
+
+    readOnlyDb.reset();
+    liveDb.reset();
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,169 @@
+#include "world/roi.h"
+#include "world/chunk_key.h"
+#include "world/world.h"
+#include "control.h"
+#include "test_world.h"
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace mcpe_viz;
+using namespace test_world;
+
+namespace {
+    ChunkRoi makeRoi(int32_t minChunkX, int32_t maxChunkX, int32_t minChunkZ, int32_t maxChunkZ,
+                     int32_t minSubChunk = 0, int32_t maxSubChunk = 255) {
+        ChunkRoi roi;
+        roi.minChunkX = minChunkX;
+        roi.maxChunkX = maxChunkX;
+        roi.minChunkZ = minChunkZ;
+        roi.maxChunkZ = maxChunkZ;
+        roi.minSubChunk = minSubChunk;
+        roi.maxSubChunk = maxSubChunk;
+        return roi;
+    }
+
+    // chunk records around the roi's of the tests, and records that are not chunk records
+    std::map<std::string, std::string> worldRecords() {
+        std::map<std::string, std::string> records;
+        for (int32_t x = -3; x <= 3; x++) {
+            for (int32_t z = -3; z <= 3; z++) {
+                records[makeChunkRecordKey(kDimIdOverworld, x, z, 0x2f, 0)] = "sub0";
+                records[makeChunkRecordKey(kDimIdOverworld, x, z, 0x2f, 5)] = "sub5";
+                records[makeChunkRecordKey(kDimIdOverworld, x, z, 0x76)] = "version";
+                records[makeChunkRecordKey(kDimIdNether, x, z, 0x2f, 0)] = "nether";
+            }
+        }
+        records["~local_player"] = "player";
+        records["player_1234"] = "player";
+        records["BiomeData"] = "biomes";
+        records["portals"] = "portals";
+        records["digp" + std::string(8, '\1')] = "digp";
+        return records;
+    }
+
+    // the keys the iterator visits from target on
+    std::vector<std::string> roiKeys(leveldb::DB* db, const ChunkRoi& roi, const std::string* target = nullptr) {
+        std::vector<std::string> keys;
+        RoiIterator iter(db, leveldb::ReadOptions(), roi);
+        if (target != nullptr) {
+            iter.seek(*target);
+        }
+        else {
+            iter.seekToFirst();
+        }
+        for (; iter.valid(); iter.next()) {
+            keys.push_back(iter.key().ToString());
+        }
+        EXPECT_TRUE(iter.status().ok());
+        return keys;
+    }
+
+    // a full scan, filtered by the roi; with seeks only the chunk records and the known record names are read,
+    // which leaves out the digp record of the test world
+    std::vector<std::string> filteredKeys(const std::map<std::string, std::string>& records, const ChunkRoi& roi,
+                                          bool seekMode, const std::string& target = std::string()) {
+        std::vector<std::string> keys;
+        ChunkRecordKey ck;
+        for (const auto& r : records) {
+            const std::string& key = r.first;
+            if (key < target || roi.excludesKey(key.data(), key.size())) {
+                continue;
+            }
+            if (seekMode && !parseChunkRecordKey(key.data(), key.size(), ck) && key.compare(0, 4, "digp") == 0) {
+                continue;
+            }
+            keys.push_back(key);
+        }
+        return keys;
+    }
+}
+
+TEST(ChunkRoi, ExcludesKey)
+{
+    const ChunkRoi roi = makeRoi(1, 2, -1, 0, 1, 3);
+    auto excludes = [&](const std::string& key) { return roi.excludesKey(key.data(), key.size()); };
+    EXPECT_FALSE(excludes(makeChunkRecordKey(kDimIdOverworld, 1, -1, 0x2f, 1)));
+    EXPECT_FALSE(excludes(makeChunkRecordKey(kDimIdNether, 2, 0, 0x2f, 3)));
+    EXPECT_TRUE(excludes(makeChunkRecordKey(kDimIdOverworld, 0, 0, 0x2f, 1)));
+    EXPECT_TRUE(excludes(makeChunkRecordKey(kDimIdOverworld, 1, 1, 0x2f, 1)));
+    // subchunks outside of the height, but the other records of the column are kept
+    EXPECT_TRUE(excludes(makeChunkRecordKey(kDimIdOverworld, 1, 0, 0x2f, 0)));
+    EXPECT_TRUE(excludes(makeChunkRecordKey(kDimIdOverworld, 1, 0, 0x2f, 4)));
+    EXPECT_FALSE(excludes(makeChunkRecordKey(kDimIdOverworld, 1, 0, 0x76)));
+    EXPECT_TRUE(excludes(makeChunkRecordKey(kDimIdOverworld, 5, 0, 0x76)));
+    // records that are not chunk records
+    EXPECT_FALSE(excludes("~local_player"));
+    EXPECT_FALSE(excludes("BiomeData"));
+    EXPECT_FALSE(excludes("digp" + std::string(8, '\1')));
+}
+
+TEST(RoiIterator, SameAsFilteredScan)
+{
+    const std::string dir = "roi_test_db";
+    const auto records = worldRecords();
+    auto db = openDb(dir, records);
+
+    // a small roi is read with seeks, one that is too wide to seek is a full scan
+    const ChunkRoi seekRoi = makeRoi(-1, 1, 0, 2, 0, 4);
+    const ChunkRoi scanRoi = makeRoi(-1000000, 1000000, -2, -1);
+    ASSERT_TRUE(seekRoi.useSeek());
+    ASSERT_FALSE(scanRoi.useSeek());
+
+    for (const auto& roi : { seekRoi, scanRoi }) {
+        const bool seekMode = roi.useSeek();
+        const auto expected = filteredKeys(records, roi, seekMode);
+        EXPECT_EQ(roiKeys(db.get(), roi), expected) << seekMode;
+
+        // seek to every key and to the keys in between
+        for (const auto& r : records) {
+            for (const std::string& target : { r.first, r.first + '\0', r.first.substr(0, r.first.size() - 1) }) {
+                EXPECT_EQ(roiKeys(db.get(), roi, &target), filteredKeys(records, roi, seekMode, target)) << seekMode;
+            }
+        }
+    }
+
+    // an roi where nothing is
+    EXPECT_EQ(roiKeys(db.get(), makeRoi(100, 101, 100, 101)).size(), 4u);
+
+    db.reset();
+    std::filesystem::remove_all(dir);
+}
+
+TEST(ChunkRoi, BoundsOfARoiAwayFromTheOrigin)
+{
+    const std::string dir = "roi_test_world";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const std::string subChunk = makeSubChunk({ "minecraft:air" }, std::vector<uint16_t>(4096, 0));
+    std::map<std::string, std::string> records;
+    for (int32_t x : { 0, 3125, 3130, 3200 }) {
+        records[makeChunkRecordKey(kDimIdOverworld, x, x / 500, 0x2f, 0)] = subChunk;
+    }
+    openDb(dir + "/db", records).reset();
+
+    const Control saved = control;
+    control.minX = 50000;
+    control.maxX = 50500;
+    control.threadCount = 1;
+    MinecraftWorld_LevelDB w;
+    w.dbOpen(dir);
+    ASSERT_EQ(w.dbParse(), 0);
+    w.dbClose();
+    control = saved;
+
+    // only the chunks inside of the roi count; chunk (0, 0) is not added
+    EXPECT_EQ(w.dimDataList[kDimIdOverworld]->getMinChunkX(), 3125);
+    EXPECT_EQ(w.dimDataList[kDimIdOverworld]->getMaxChunkX(), 3130);
+    EXPECT_EQ(w.dimDataList[kDimIdOverworld]->getMinChunkZ(), 6);
+    EXPECT_EQ(w.dimDataList[kDimIdOverworld]->getMaxChunkZ(), 6);
+    // a dimension without chunks is one chunk, inside of the roi
+    EXPECT_EQ(w.dimDataList[kDimIdNether]->getMinChunkX(), 3125);
+    EXPECT_EQ(w.dimDataList[kDimIdNether]->getMaxChunkX(), 3125);
+    EXPECT_EQ(w.dimDataList[kDimIdNether]->getMinChunkZ(), 0);
+
+    std::filesystem::remove_all(dir);
+}
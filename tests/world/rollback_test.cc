@@ -0,0 +1,79 @@
+#include "world/rollback.h"
+#include "world/chunk_key.h"
+#include "define.h"
+#include "test_world.h"
+
+#include <gtest/gtest.h>
+#include <climits>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+
+using namespace mcpe_viz;
+using namespace test_world;
+
+namespace {
+    std::string get(leveldb::DB* db, const std::string& key) {
+        std::string value;
+        return db->Get(leveldb::ReadOptions(), key, &value).ok() ? value : "<none>";
+    }
+}
+
+TEST(Rollback, RestoresOnlyTheBox)
+{
+    const std::string inside = makeChunkRecordKey(kDimIdOverworld, 1, -1, 0x2f, 0);
+    const std::string above = makeChunkRecordKey(kDimIdOverworld, 1, -1, 0x2f, 5);
+    const std::string entities = makeChunkRecordKey(kDimIdOverworld, 1, -1, 0x32);
+    const std::string pendingTicks = makeChunkRecordKey(kDimIdOverworld, 1, -1, 0x33);
+    const std::string outside = makeChunkRecordKey(kDimIdOverworld, 2, -1, 0x2f, 0);
+    const std::string nether = makeChunkRecordKey(kDimIdNether, 1, -1, 0x2f, 0);
+    const std::string version = makeChunkRecordKey(kDimIdOverworld, 1, -1, 0x2c);
+    // chunk (1, 0) was generated after the backup, chunk (1, 1) was deleted after the backup
+    const std::string added = makeChunkRecordKey(kDimIdOverworld, 1, 0, 0x2f, 0);
+    const std::string addedAbove = makeChunkRecordKey(kDimIdOverworld, 1, 0, 0x2f, 5);
+    const std::string addedTicks = makeChunkRecordKey(kDimIdOverworld, 1, 0, 0x33);
+    const std::string removed = makeChunkRecordKey(kDimIdOverworld, 1, 1, 0x2f, 0);
+    const std::string removedAbove = makeChunkRecordKey(kDimIdOverworld, 1, 1, 0x2f, 5);
+    const std::string removedTicks = makeChunkRecordKey(kDimIdOverworld, 1, 1, 0x33);
+
+    auto backupDb = openDb("rollback_test_backup", {
+        { inside, "old" }, { above, "old" }, { pendingTicks, "old" }, { outside, "old" }, { nether, "old" },
+        { version, "old" }, { removed, "old" }, { removedAbove, "old" }, { removedTicks, "old" } });
+    auto db = openDb("rollback_test_world", {
+        { inside, "new" }, { above, "new" }, { entities, "new" }, { pendingTicks, "new" }, { outside, "new" },
+        { nether, "new" }, { version, "new" }, { added, "new" }, { addedAbove, "new" }, { addedTicks, "new" } });
+
+    // chunks (1, -1)..(1, 1), subchunks 0..3
+    ChunkRoi roi = { 1, 1, -1, 1, 0, 3 };
+    RollbackStats stats;
+    ASSERT_EQ(rollbackRegion(db.get(), backupDb.get(), kDimIdOverworld, roi, stats), 0);
+    EXPECT_EQ(stats.restoredRecords, 5u);
+    EXPECT_EQ(stats.deletedRecords, 4u);
+    EXPECT_EQ(stats.chunks, 3u);
+
+    // a column in both worlds: the restored types inside of the box
+    EXPECT_EQ(get(db.get(), inside), "old");
+    EXPECT_EQ(get(db.get(), version), "old");
+    EXPECT_EQ(get(db.get(), entities), "<none>");
+    EXPECT_EQ(get(db.get(), above), "new");
+    EXPECT_EQ(get(db.get(), pendingTicks), "new");
+    EXPECT_EQ(get(db.get(), outside), "new");
+    EXPECT_EQ(get(db.get(), nether), "new");
+    // a column in one of the worlds: all of its records
+    EXPECT_EQ(get(db.get(), added), "<none>");
+    EXPECT_EQ(get(db.get(), addedAbove), "<none>");
+    EXPECT_EQ(get(db.get(), addedTicks), "<none>");
+    EXPECT_EQ(get(db.get(), removed), "old");
+    EXPECT_EQ(get(db.get(), removedAbove), "old");
+    EXPECT_EQ(get(db.get(), removedTicks), "old");
+
+    // an unbounded box is refused
+    ChunkRoi all = { INT32_MIN, INT32_MAX, INT32_MIN, INT32_MAX, 0, 255 };
+    EXPECT_EQ(rollbackRegion(db.get(), backupDb.get(), kDimIdOverworld, all, stats), -1);
+
+    db.reset();
+    backupDb.reset();
+    std::filesystem::remove_all("rollback_test_backup");
+    std::filesystem::remove_all("rollback_test_world");
+}
@@ -0,0 +1,132 @@
+#include "world/subchunk_index.h"
+#include "world/chunk_key.h"
+#include "test_world.h"
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <map>
+#include <string>
+
+using namespace mcpe_viz;
+using namespace test_world;
+
+namespace {
+    std::string subChunkKey(int32_t chunkX, int32_t chunkZ, int32_t subChunk) {
+        return makeChunkRecordKey(kDimIdOverworld, chunkX, chunkZ, 0x2f, subChunk);
+    }
+
+    const SubChunkIndex::ChunkNode& chunkNode(const SubChunkIndex& index, int32_t chunkX, int32_t chunkZ) {
+        const SubChunkIndex::XZ regionPos(chunkX >> SubChunkIndex::kRegionShift, chunkZ >> SubChunkIndex::kRegionShift);
+        return index.dims[kDimIdOverworld].regions.at(regionPos).chunks.at(SubChunkIndex::XZ(chunkX, chunkZ));
+    }
+
+    // a world directory with a db and (after open) an index; the db is flushed so that the index sees its tables
+    std::unique_ptr<leveldb::DB> openWorld(const std::string& dir, const std::map<std::string, std::string>& records) {
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        auto db = openDb(dir + "/db", records);
+        db->CompactRange(nullptr, nullptr);
+        return db;
+    }
+}
+
+TEST(SubChunkIndex, UpdateSameAsBuild)
+{
+    const std::string dir = "subchunk_index_test_update";
+    auto db = openWorld(dir, {
+        { subChunkKey(0, 0, 0), "a" },
+        { subChunkKey(0, 0, 1), "b" },
+        { subChunkKey(1, 0, 0), "sibling" },
+        { subChunkKey(40, 0, 0), "c" },
+        { "~local_player", "not a subchunk" },
+    });
+    leveldb::Options options;
+    {
+        SubChunkIndex index;
+        ASSERT_EQ(index.open(db.get(), options, dir), 0);
+        EXPECT_TRUE(index.changed());
+        EXPECT_EQ(index.dims[kDimIdOverworld].subChunkCount, 4u);
+    }
+
+    SubChunkIndex before;
+    ASSERT_EQ(before.load(SubChunkIndex::fileName(dir)), 0);
+    const uint64_t siblingHash = chunkNode(before, 1, 0).hash;
+
+    // add, change and remove a subchunk
+    db->Put(leveldb::WriteOptions(), subChunkKey(0, 0, 2), "d");
+    db->Put(leveldb::WriteOptions(), subChunkKey(0, 0, 1), "b2");
+    db->Delete(leveldb::WriteOptions(), subChunkKey(40, 0, 0));
+    db->CompactRange(nullptr, nullptr);
+
+    SubChunkIndex updated;
+    ASSERT_EQ(updated.open(db.get(), options, dir), 0);
+    EXPECT_TRUE(updated.changed());
+
+    SubChunkIndex built;
+    ASSERT_EQ(built.build(db.get(), options, dir + "/db"), 0);
+    EXPECT_EQ(updated.dims[kDimIdOverworld].hash, built.dims[kDimIdOverworld].hash);
+    EXPECT_EQ(updated.dims[kDimIdOverworld].subChunkCount, 4u);
+    EXPECT_EQ(updated.dims[kDimIdOverworld].regions.count(SubChunkIndex::XZ(40 >> SubChunkIndex::kRegionShift, 0)), 0u);
+
+    const auto& chunk = chunkNode(updated, 0, 0);
+    ASSERT_EQ(chunk.subChunks.size(), 3u);
+    EXPECT_EQ(chunk.subChunks.at(2)->first, subChunkKey(0, 0, 2));
+    EXPECT_NE(chunk.subChunks.at(1)->second, chunkNode(before, 0, 0).subChunks.at(1)->second);
+    EXPECT_EQ(chunk.subChunks.at(0)->second, chunkNode(before, 0, 0).subChunks.at(0)->second);
+    EXPECT_EQ(chunkNode(updated, 1, 0).hash, siblingHash);
+
+    // nothing changed since the last update
+    SubChunkIndex again;
+    ASSERT_EQ(again.open(db.get(), options, dir), 0);
+    EXPECT_FALSE(again.changed());
+    EXPECT_EQ(again.dims[kDimIdOverworld].hash, built.dims[kDimIdOverworld].hash);
+
+    db.reset();
+    std::filesystem::remove_all(dir);
+}
+
+TEST(SubChunkIndex, Diff)
+{
+    const std::string dirA = "subchunk_index_test_a";
+    const std::string dirB = "subchunk_index_test_b";
+    auto dbA = openWorld(dirA, {
+        { subChunkKey(0, 0, 0), "same" },
+        { subChunkKey(0, 0, 1), "new" },
+        { subChunkKey(0, 0, 2), "added" },
+        { subChunkKey(1, 0, 0), "same" },
+        { subChunkKey(40, 0, 0), "added region" },
+    });
+    auto dbB = openWorld(dirB, {
+        { subChunkKey(0, 0, 0), "same" },
+        { subChunkKey(0, 0, 1), "old" },
+        { subChunkKey(0, 0, 3), "removed" },
+        { subChunkKey(1, 0, 0), "same" },
+        { subChunkKey(-40, 0, 0), "removed region" },
+    });
+    leveldb::Options options;
+    SubChunkIndex indexA, indexB;
+    ASSERT_EQ(indexA.open(dbA.get(), options, dirA), 0);
+    ASSERT_EQ(indexB.open(dbB.get(), options, dirB), 0);
+
+    SubChunkIndexDiff diff;
+    diffSubChunkIndex(indexA, indexB, kDimIdOverworld, diff);
+    ASSERT_EQ(diff.changedKeys.size(), 1u);
+    EXPECT_EQ(diff.changedKeys[0], subChunkKey(0, 0, 1));
+    EXPECT_EQ(diff.addedChunks, 2u);
+    EXPECT_EQ(diff.removedChunks, 2u);
+    EXPECT_EQ(diff.sharedChunks, 3u);
+    EXPECT_EQ(diff.sameChunks, 2u);
+
+    // a world against itself
+    SubChunkIndexDiff same;
+    diffSubChunkIndex(indexA, indexA, kDimIdOverworld, same);
+    EXPECT_TRUE(same.changedKeys.empty());
+    EXPECT_EQ(same.sharedChunks, 5u);
+    EXPECT_EQ(same.sameChunks, 5u);
+    EXPECT_EQ(same.addedChunks + same.removedChunks, 0u);
+
+    dbA.reset();
+    dbB.reset();
+    std::filesystem::remove_all(dirA);
+    std::filesystem::remove_all(dirB);
+}
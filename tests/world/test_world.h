@@ -0,0 +1,70 @@
+#pragma once
+
+#include <leveldb/db.h>
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// helpers shared by the tests in this directory
+namespace test_world {
+
+    // a new leveldb in dir (anything that was there is removed) with the given records
+    inline std::unique_ptr<leveldb::DB> openDb(const std::string& dir, const std::map<std::string, std::string>& records) {
+        std::filesystem::remove_all(dir);
+        leveldb::Options options;
+        options.create_if_missing = true;
+        leveldb::DB* db = nullptr;
+        EXPECT_TRUE(leveldb::DB::Open(options, dir, &db).ok());
+        for (const auto& r : records) {
+            db->Put(leveldb::WriteOptions(), r.first, r.second);
+        }
+        return std::unique_ptr<leveldb::DB>(db);
+    }
+
+    // all records of a db
+    inline std::map<std::string, std::string> readDb(leveldb::DB* db) {
+        std::map<std::string, std::string> records;
+        std::unique_ptr<leveldb::Iterator> iter(db->NewIterator(leveldb::ReadOptions()));
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+            records[iter->key().ToString()] = iter->value().ToString();
+        }
+        EXPECT_TRUE(iter->status().ok());
+        return records;
+    }
+
+    // an nbt tag name (or string value): 16-bit length, then the bytes
+    inline void putName(std::string& s, const std::string& name) {
+        uint16_t len = uint16_t(name.size());
+        s.append((const char*)&len, 2);
+        s += name;
+    }
+
+    // a single storage v8 subchunk record, 4 bits per block
+    inline std::string makeSubChunk(const std::vector<std::string>& palette, const std::vector<uint16_t>& indices) {
+        std::string s;
+        s.push_back(8);
+        s.push_back(1);
+        s.push_back(char(4 << 1));
+        std::vector<uint32_t> words(512, 0);
+        for (int32_t i = 0; i < 4096; i++) {
+            words[i / 8] |= uint32_t(indices[i]) << ((i % 8) * 4);
+        }
+        s.append((const char*)words.data(), words.size() * 4);
+        int32_t count = int32_t(palette.size());
+        s.append((const char*)&count, 4);
+        for (const auto& name : palette) {
+            s.push_back(10);
+            putName(s, "");
+            s.push_back(8);
+            putName(s, "name");
+            putName(s, name);
+            s.push_back(0);
+        }
+        return s;
+    }
+}
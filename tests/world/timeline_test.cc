@@ -0,0 +1,77 @@
+#include "world/timeline.h"
+#include "world/chunk_key.h"
+#include "define.h"
+#include "test_world.h"
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace mcpe_viz;
+using namespace test_world;
+
+namespace {
+    std::string subChunkKey(int32_t chunkX, int32_t chunkZ, int32_t subChunk) {
+        return makeChunkRecordKey(kDimIdOverworld, chunkX, chunkZ, 0x2f, subChunk);
+    }
+}
+
+TEST(Timeline, ChangedAddedAndRemovedSubChunks)
+{
+    // chunk (0, 0) changes in the second snapshot, chunk (2, 0) is added in it and chunk (1, 0)
+    // is removed in the third one
+    auto db0 = openDb("timeline_test_0", {
+        { subChunkKey(0, 0, 0), "a" }, { subChunkKey(0, 0, 1), "b" }, { subChunkKey(1, 0, 0), "c" },
+        { "~local_player", "player" } });
+    auto db1 = openDb("timeline_test_1", {
+        { subChunkKey(0, 0, 0), "a2" }, { subChunkKey(0, 0, 1), "b" }, { subChunkKey(1, 0, 0), "c" },
+        { subChunkKey(2, 0, 0), "d" }, { "~local_player", "player moved" } });
+    auto db2 = openDb("timeline_test_2", {
+        { subChunkKey(0, 0, 0), "a2" }, { subChunkKey(0, 0, 1), "b" }, { subChunkKey(2, 0, 0), "d" } });
+
+    const std::string fn = "timeline_test.txt";
+    ASSERT_EQ(generateTimeline({ db0.get(), db1.get(), db2.get() }, { "monday", "tuesday", "wednesday" }, fn), 0);
+
+    std::ifstream in(fn);
+    std::string line;
+    std::vector<std::string> chunks, counts;
+    bool inCounts = false;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 7, "CHANGES") == 0) {
+            inCounts = true;
+        }
+        else if (line.compare(0, 9, "overworld") == 0) {
+            chunks.push_back(line);
+        }
+        else if (inCounts) {
+            counts.push_back(line);
+        }
+    }
+
+    const std::vector<std::string> expectedChunks = {
+        "overworld 0 0 x.",
+        "overworld 1 0 .-",
+        "overworld 2 0 +.",
+    };
+    EXPECT_EQ(chunks, expectedChunks);
+    // snapshot, dimension, changed, added and removed subchunks, changed chunks
+    const std::vector<std::string> expectedCounts = {
+        "1 overworld 1 1 0 2",
+        "1 nether 0 0 0 0",
+        "1 the-end 0 0 0 0",
+        "2 overworld 0 0 1 1",
+        "2 nether 0 0 0 0",
+        "2 the-end 0 0 0 0",
+    };
+    EXPECT_EQ(counts, expectedCounts);
+
+    db0.reset();
+    db1.reset();
+    db2.reset();
+    for (const char* dir : { "timeline_test_0", "timeline_test_1", "timeline_test_2" }) {
+        std::filesystem::remove_all(dir);
+    }
+    std::remove(fn.c_str());
+}
@@ -0,0 +1,96 @@
+#include "world/world_patch.h"
+#include "test_world.h"
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+
+using namespace mcpe_viz;
+using namespace test_world;
+
+namespace {
+    // bytes that do not compress, so a small change is written as a delta
+    std::string noise(size_t size) {
+        std::string s(size, 0);
+        uint32_t v = 12345;
+        for (auto& c : s) {
+            v = v * 1103515245 + 12345;
+            c = char(v >> 16);
+        }
+        return s;
+    }
+}
+
+TEST(WorldPatch, RoundTrip)
+{
+    const std::string big = noise(1000);
+    const std::map<std::string, std::string> oldRecords = {
+        { "same", "value" }, { "changed", big }, { "shrunk", big + "tail" }, { "removed", "x" }
+    };
+    std::map<std::string, std::string> newRecords = {
+        { "same", "value" }, { "changed", big }, { "shrunk", big }, { "added", "y" }
+    };
+    newRecords["changed"][500] = 'b';
+
+    const std::string fn = "world_patch_test.bvpt";
+    {
+        auto oldDb = openDb("world_patch_test_old", oldRecords);
+        auto newDb = openDb("world_patch_test_new", newRecords);
+        ASSERT_EQ(writeWorldPatch(newDb.get(), oldDb.get(), fn), 0);
+        // "changed" and "shrunk" are written as deltas
+        std::ifstream in(fn, std::ios::binary | std::ios::ate);
+        EXPECT_LT(size_t(in.tellg()), 2 * big.size());
+        // a world that is not the base of the patch is left alone
+        auto otherDb = openDb("world_patch_test_other", { { "changed", "z" } });
+        EXPECT_EQ(applyWorldPatch(otherDb.get(), fn), -1);
+        EXPECT_EQ(readDb(otherDb.get()).at("changed"), "z");
+    }
+    {
+        auto db = openDb("world_patch_test_old", oldRecords);
+        ASSERT_EQ(applyWorldPatch(db.get(), fn), 0);
+        EXPECT_EQ(readDb(db.get()), newRecords);
+    }
+    for (const char* dir : { "world_patch_test_old", "world_patch_test_new", "world_patch_test_other" }) {
+        std::filesystem::remove_all(dir);
+    }
+    std::remove(fn.c_str());
+}
+
+TEST(WorldPatch, DamagedPutWritesNothing)
+{
+    // more than one write batch of records before the damaged one
+    const std::map<std::string, std::string> oldRecords = { { "keep", "old" } };
+    const std::map<std::string, std::string> newRecords = {
+        { "aaa", noise(5 * 1024 * 1024) }, { "keep", "new" }, { "zzz", "the last put record" }
+    };
+
+    const std::string fn = "world_patch_test.bvpt";
+    {
+        auto oldDb = openDb("world_patch_test_old", oldRecords);
+        auto newDb = openDb("world_patch_test_new", newRecords);
+        ASSERT_EQ(writeWorldPatch(newDb.get(), oldDb.get(), fn), 0);
+    }
+    {
+        // a byte in the compressed value of "zzz" (the footer is the last 9 bytes)
+        std::fstream f(fn, std::ios::binary | std::ios::in | std::ios::out | std::ios::ate);
+        const std::streamoff pos = std::streamoff(f.tellg()) - 9 - 3;
+        f.seekg(pos);
+        char c = 0;
+        f.read(&c, 1);
+        c = char(c ^ 0x5a);
+        f.seekp(pos);
+        f.write(&c, 1);
+    }
+    {
+        auto db = openDb("world_patch_test_old", oldRecords);
+        EXPECT_EQ(applyWorldPatch(db.get(), fn), -1);
+        EXPECT_EQ(readDb(db.get()), oldRecords);
+    }
+    for (const char* dir : { "world_patch_test_old", "world_patch_test_new" }) {
+        std::filesystem::remove_all(dir);
+    }
+    std::remove(fn.c_str());
+}